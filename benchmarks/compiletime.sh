@@ -0,0 +1,55 @@
+#!/bin/bash
+#  Copyright 2021 Google LLC.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Compare compile times of the clang backend and the in-process LLVM C API
+# backend on the bootstrap compiler sources, and how much of the llvmapi time
+# goes to printing the IR as text and parsing it back, which is what building
+# the module with the C API's IR builder would save.  Rune must be built with
+# LLVM_CONFIG set for -llvmapi to work.  Run from the rune directory:
+#
+#   benchmarks/compiletime.sh [extra rune flags, such as -O]
+
+RUNE=$(pwd)/rune
+flags="$@"
+
+# Print the elapsed seconds of running the command.
+elapsed() {
+  local start=$(date +%s.%N)
+  "$@" > /dev/null || echo "Failed: $@" >&2
+  local end=$(date +%s.%N)
+  echo "$end - $start" | bc
+}
+
+# Print the seconds -timellvmapi reported for the phase named $1.
+phase() {
+  sed -n "s/.*LLVM $1 \([0-9.]*\)s.*/\1/p" "$timings"
+}
+
+timings=$(mktemp)
+printf "%-24s %10s %10s %10s %10s %10s\n" file "IR only" clang llvmapi "IR text" parse
+for test in bootstrap/rune.rn bootstrap/database/*.rn; do
+  dir=$(dirname "$test")
+  file=$(basename "$test")
+  cd "$dir"
+  irOnly=$(elapsed "$RUNE" $flags -n "$file")
+  clang=$(elapsed "$RUNE" $flags "$file")
+  llvmapi=$(elapsed "$RUNE" $flags -llvmapi "$file")
+  "$RUNE" $flags -llvmapi -timellvmapi "$file" > "$timings"
+  printf "%-24s %10.2f %10.2f %10.2f %10.2f %10.2f\n" "$test" "$irOnly" "$clang" \
+      "$llvmapi" "$(phase "IR text")" "$(phase parse)"
+  rm -f "${file%.rn}" "${file%.rn}.ll"
+  cd - > /dev/null
+done
+rm -f "$timings"
@@ -0,0 +1,62 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// C++ version of mandelbrot.rn, for comparing floating point code.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  uint32_t N = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+  uint32_t width = N;
+  uint32_t height = N;
+  uint32_t maxX = (width + 7) / 8;
+  uint32_t maxIterations = 50;
+  double limit = 2.0;
+  double limitSq = limit * limit;
+  printf("P4\n%u %u\n\n", width, height);
+  double cr0[8], cr[8], ci[8];
+  for (uint32_t y = 0; y < height; y++) {
+    double ci0 = 2.0 * (double)y / (double)height - 1.0;
+    for (uint32_t x = 0; x < maxX; x++) {
+      for (uint32_t k = 0; k < 8; k++) {
+        cr0[k] = 2.0 * (double)(8 * x + k) / (double)width - 1.5;
+      }
+      for (uint32_t i = 0; i < 8; i++) {
+        cr[i] = cr0[i];
+        ci[i] = ci0;
+      }
+      uint8_t bits = 0;
+      for (uint32_t i = 0; i < maxIterations && bits != 0xff; i++) {
+        for (uint32_t k = 0; k < 8; k++) {
+          uint8_t mask = 1 << (7 - k);
+          if ((bits & mask) == 0) {
+            double crk = cr[k];
+            double cik = ci[k];
+            double cr2k = crk * crk;
+            double ci2k = cik * cik;
+            cr[k] = cr2k - ci2k + cr0[k];
+            ci[k] = 2.0 * crk * cik + ci0;
+            if (cr2k + ci2k > limitSq) {
+              bits |= mask;
+            }
+          }
+        }
+      }
+      putchar((uint8_t)~bits);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,397 @@
+//  Copyright 2024 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks for the bigint and smallnum runtime APIs.  Each operation is
+// run at widths from 64 to 8192 bits, on both secret and public operands, and
+// the results are written to stdout as JSON, one record per operation, width,
+// and secrecy.  Public operands use the functions the code generator selects
+// for non-secret values, e.g. runtime_bigintMulVartime, and secret multiplies
+// use the Karatsuba or Toom-3 entry points at the widths where the code
+// generator does.  The bigintMulCttk, bigintMulKaratsuba and bigintMulToom3
+// records time each algorithm at every width, for tuning RN_KARATSUBA_MIN_WIDTH,
+// and the secret bigintMulKaratsuba and bigintMulToom3 records continue up to
+// 32768 bits, for tuning RN_TOOM3_MIN_WIDTH.
+//
+// Allocations are counted by wrapping malloc, calloc, and realloc at link time
+// with -Wl,--wrap, so the runtime itself is not instrumented.
+//
+// Usage: runtime_bench [minMillisecondsPerBenchmark]
+#include "runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Each benchmark runs at least this long, unless overridden on the command line.
+#define RN_BENCH_DEFAULT_MIN_MILLIS 200
+
+static const uint32_t benchWidths[] = {64, 128, 256, 512, 1024, 2048, 4096, 8192};
+#define RN_BENCH_NUM_WIDTHS (sizeof(benchWidths) / sizeof(benchWidths[0]))
+// Widths around RN_TOOM3_MIN_WIDTH, where only the wide multiplies are timed.
+static const uint32_t benchToom3Widths[] = {16384, 18432, 20480, 24576, 32768};
+#define RN_BENCH_NUM_TOOM3_WIDTHS (sizeof(benchToom3Widths) / sizeof(benchToom3Widths[0]))
+
+static uint64_t benchNumAllocs;
+static uint64_t benchMinNanos;
+static bool benchFirstRecord = true;
+// Results are accumulated here so the compiler cannot drop smallnum calls.
+static volatile uint64_t benchSink;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t numElements, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+// Count calls to malloc.  Linked with -Wl,--wrap=malloc.
+void *__wrap_malloc(size_t size) {
+  benchNumAllocs++;
+  return __real_malloc(size);
+}
+
+// Count calls to calloc.  Linked with -Wl,--wrap=calloc.
+void *__wrap_calloc(size_t numElements, size_t size) {
+  benchNumAllocs++;
+  return __real_calloc(numElements, size);
+}
+
+// Count calls to realloc.  Linked with -Wl,--wrap=realloc.
+void *__wrap_realloc(void *ptr, size_t size) {
+  benchNumAllocs++;
+  return __real_realloc(ptr, size);
+}
+
+// Operands shared by all bigint benchmarks at a given width.  Values are sized
+// so that no operation overflows the width: |small| has half the bits so
+// products fit, and |base| is reduced below |modulus|.
+typedef struct {
+  runtime_array a;
+  runtime_array b;
+  runtime_array small;
+  runtime_array modulus;
+  runtime_array base;
+  runtime_array exponent;
+  runtime_array dest;
+  runtime_array string;
+  uint32_t width;
+  bool secret;
+} benchOperands;
+
+typedef void (*benchBigintFunc)(benchOperands *ops);
+typedef uint64_t (*benchSmallnumFunc)(uint64_t a, uint64_t b, uint64_t modulus, bool secret);
+
+// Return the monotonic clock in nanoseconds.
+static uint64_t nowNanos(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Set |dest| to a random value of |valueWidth| bits, stored in a bigint of
+// |width| bits.
+static void randomBigint(runtime_array *dest, uint32_t valueWidth, uint32_t width,
+    bool secret) {
+  runtime_array value = runtime_makeEmptyArray();
+  runtime_generateTrueRandomBigint(&value, valueWidth);
+  runtime_bigintCast(dest, &value, width, false, secret, false);
+  runtime_freeArray(&value);
+}
+
+// Create the operands for one width.
+static void initOperands(benchOperands *ops, uint32_t width, bool secret) {
+  memset(ops, 0, sizeof(benchOperands));
+  ops->width = width;
+  ops->secret = secret;
+  randomBigint(&ops->a, width - 2, width, secret);
+  randomBigint(&ops->b, width - 2, width, secret);
+  randomBigint(&ops->small, width / 2 - 1, width, secret);
+  // Make the modulus odd and full width, so every modular path is exercised.
+  runtime_array one = runtime_makeEmptyArray();
+  runtime_array top = runtime_makeEmptyArray();
+  randomBigint(&ops->modulus, width, width, false);
+  runtime_integerToBigint(&one, 1, width, false, false);
+  runtime_bigintShl(&top, &one, width - 1);
+  runtime_bigintBitwiseOr(&ops->modulus, &ops->modulus, &top);
+  runtime_bigintBitwiseOr(&ops->modulus, &ops->modulus, &one);
+  runtime_freeArray(&one);
+  runtime_freeArray(&top);
+  randomBigint(&ops->base, width - 1, width, secret);
+  randomBigint(&ops->exponent, width, width, secret);
+  ops->dest = runtime_makeEmptyArray();
+  ops->string = runtime_makeEmptyArray();
+}
+
+// Free the operands for one width.
+static void freeOperands(benchOperands *ops) {
+  runtime_freeArray(&ops->a);
+  runtime_freeArray(&ops->b);
+  runtime_freeArray(&ops->small);
+  runtime_freeArray(&ops->modulus);
+  runtime_freeArray(&ops->base);
+  runtime_freeArray(&ops->exponent);
+  runtime_freeArray(&ops->dest);
+  runtime_freeArray(&ops->string);
+}
+
+static void benchAdd(benchOperands *ops) {
+  runtime_bigintAdd(&ops->dest, &ops->a, &ops->b);
+}
+
+static void benchSub(benchOperands *ops) {
+  runtime_bigintSub(&ops->dest, &ops->a, &ops->b);
+}
+
+// Secret multiplies use the function the code generator selects for the
+// width, as in findWideMulFunction.
+static void benchMul(benchOperands *ops) {
+  if (!ops->secret) {
+    runtime_bigintMulVartime(&ops->dest, &ops->small, &ops->small);
+  } else if (ops->width >= RN_TOOM3_MIN_WIDTH) {
+    runtime_bigintMulToom3(&ops->dest, &ops->small, &ops->small);
+  } else if (ops->width >= RN_KARATSUBA_MIN_WIDTH) {
+    runtime_bigintMulKaratsuba(&ops->dest, &ops->small, &ops->small);
+  } else {
+    runtime_bigintMul(&ops->dest, &ops->small, &ops->small);
+  }
+}
+
+static void benchMulTrunc(benchOperands *ops) {
+  if (!ops->secret) {
+    runtime_bigintMulTruncVartime(&ops->dest, &ops->a, &ops->b);
+  } else if (ops->width >= RN_TOOM3_MIN_WIDTH) {
+    runtime_bigintMulTruncToom3(&ops->dest, &ops->a, &ops->b);
+  } else if (ops->width >= RN_KARATSUBA_MIN_WIDTH) {
+    runtime_bigintMulTruncKaratsuba(&ops->dest, &ops->a, &ops->b);
+  } else {
+    runtime_bigintMulTrunc(&ops->dest, &ops->a, &ops->b);
+  }
+}
+
+// Each multiply algorithm at every width, to find the crossover points.  These
+// are constant time, so they ignore whether the operands are secret.
+static void benchMulCttk(benchOperands *ops) {
+  runtime_bigintMul(&ops->dest, &ops->small, &ops->small);
+}
+
+static void benchMulKaratsuba(benchOperands *ops) {
+  runtime_bigintMulKaratsuba(&ops->dest, &ops->small, &ops->small);
+}
+
+static void benchMulToom3(benchOperands *ops) {
+  runtime_bigintMulToom3(&ops->dest, &ops->small, &ops->small);
+}
+
+static void benchDiv(benchOperands *ops) {
+  if (ops->secret) {
+    runtime_bigintDiv(&ops->dest, &ops->a, &ops->small);
+  } else {
+    runtime_bigintDivVartime(&ops->dest, &ops->a, &ops->small);
+  }
+}
+
+static void benchMod(benchOperands *ops) {
+  if (ops->secret) {
+    runtime_bigintMod(&ops->dest, &ops->a, &ops->small);
+  } else {
+    runtime_bigintModVartime(&ops->dest, &ops->a, &ops->small);
+  }
+}
+
+static void benchShl(benchOperands *ops) {
+  runtime_bigintShl(&ops->dest, &ops->small, ops->width / 3);
+}
+
+static void benchModularMul(benchOperands *ops) {
+  if (ops->secret) {
+    runtime_bigintModularMul(&ops->dest, &ops->base, &ops->base, &ops->modulus);
+  } else {
+    runtime_bigintModularMulVartime(&ops->dest, &ops->base, &ops->base, &ops->modulus);
+  }
+}
+
+static void benchModularExp(benchOperands *ops) {
+  if (ops->secret) {
+    runtime_bigintModularExp(&ops->dest, &ops->base, &ops->exponent, &ops->modulus);
+  } else {
+    runtime_bigintModularExpVartime(&ops->dest, &ops->base, &ops->exponent, &ops->modulus);
+  }
+}
+
+static void benchToString(benchOperands *ops) {
+  runtime_bigintToString(&ops->string, &ops->a, 10);
+}
+
+typedef struct {
+  const char *name;
+  benchBigintFunc func;
+} benchBigintOp;
+
+static const benchBigintOp benchBigintOps[] = {
+  {"bigintAdd", benchAdd},
+  {"bigintSub", benchSub},
+  {"bigintMul", benchMul},
+  {"bigintMulTrunc", benchMulTrunc},
+  {"bigintMulCttk", benchMulCttk},
+  {"bigintMulKaratsuba", benchMulKaratsuba},
+  {"bigintMulToom3", benchMulToom3},
+  {"bigintDiv", benchDiv},
+  {"bigintMod", benchMod},
+  {"bigintShl", benchShl},
+  {"bigintModularMul", benchModularMul},
+  {"bigintModularExp", benchModularExp},
+  {"bigintToString", benchToString},
+};
+#define RN_BENCH_NUM_BIGINT_OPS (sizeof(benchBigintOps) / sizeof(benchBigintOps[0]))
+
+static const benchBigintOp benchToom3Ops[] = {
+  {"bigintMulKaratsuba", benchMulKaratsuba},
+  {"bigintMulToom3", benchMulToom3},
+};
+#define RN_BENCH_NUM_TOOM3_OPS (sizeof(benchToom3Ops) / sizeof(benchToom3Ops[0]))
+
+static uint64_t smallMul(uint64_t a, uint64_t b, uint64_t modulus, bool secret) {
+  return runtime_smallnumMul(a & 0xffffffff, b & 0xffffffff, false, secret);
+}
+
+static uint64_t smallDiv(uint64_t a, uint64_t b, uint64_t modulus, bool secret) {
+  return runtime_smallnumDiv(a, b | 1, false, secret);
+}
+
+static uint64_t smallMod(uint64_t a, uint64_t b, uint64_t modulus, bool secret) {
+  return runtime_smallnumMod(a, b | 1, false, secret);
+}
+
+static uint64_t smallExp(uint64_t a, uint64_t b, uint64_t modulus, bool secret) {
+  return runtime_smallnumExp(a & 0xff, 7, false, secret);
+}
+
+static uint64_t smallModularMul(uint64_t a, uint64_t b, uint64_t modulus, bool secret) {
+  return runtime_smallnumModularMul(a % modulus, b % modulus, modulus, secret);
+}
+
+static uint64_t smallModularExp(uint64_t a, uint64_t b, uint64_t modulus, bool secret) {
+  return runtime_smallnumModularExp(a % modulus, b, modulus, secret);
+}
+
+typedef struct {
+  const char *name;
+  benchSmallnumFunc func;
+} benchSmallnumOp;
+
+static const benchSmallnumOp benchSmallnumOps[] = {
+  {"smallnumMul", smallMul},
+  {"smallnumDiv", smallDiv},
+  {"smallnumMod", smallMod},
+  {"smallnumExp", smallExp},
+  {"smallnumModularMul", smallModularMul},
+  {"smallnumModularExp", smallModularExp},
+};
+#define RN_BENCH_NUM_SMALLNUM_OPS (sizeof(benchSmallnumOps) / sizeof(benchSmallnumOps[0]))
+
+// Print one JSON result record.
+static void reportResult(const char *name, uint32_t width, bool secret,
+    uint64_t iterations, uint64_t nanos, uint64_t allocs) {
+  printf("%s\n    {\"name\": \"%s\", \"width\": %u, \"secret\": %s, \"iterations\": %lu, "
+      "\"ns_per_op\": %.1f, \"allocs_per_op\": %.2f}",
+      benchFirstRecord? "" : ",", name, width, secret? "true" : "false",
+      (unsigned long)iterations, (double)nanos / iterations, (double)allocs / iterations);
+  benchFirstRecord = false;
+  fflush(stdout);
+}
+
+// Run a bigint benchmark, doubling the iteration count until it runs for at
+// least benchMinNanos.  One untimed call first sizes the destination, so
+// allocations reflect the steady state of a reused temporary.
+static void runBigintBench(const benchBigintOp *op, benchOperands *ops) {
+  op->func(ops);
+  uint64_t iterations = 1;
+  for (;;) {
+    uint64_t allocsBefore = benchNumAllocs;
+    uint64_t start = nowNanos();
+    for (uint64_t i = 0; i < iterations; i++) {
+      op->func(ops);
+    }
+    uint64_t nanos = nowNanos() - start;
+    if (nanos >= benchMinNanos) {
+      reportResult(op->name, ops->width, ops->secret, iterations, nanos,
+          benchNumAllocs - allocsBefore);
+      return;
+    }
+    iterations <<= 1;
+  }
+}
+
+// Run a smallnum benchmark on pseudo-random 64-bit operands.
+static void runSmallnumBench(const benchSmallnumOp *op, bool secret) {
+  uint64_t modulus = 0xffffffffffffffc5ull;  // The largest 64-bit prime.
+  uint64_t iterations = 1024;
+  for (;;) {
+    uint64_t x = 0x9e3779b97f4a7c15ull;
+    uint64_t sum = 0;
+    uint64_t allocsBefore = benchNumAllocs;
+    uint64_t start = nowNanos();
+    for (uint64_t i = 0; i < iterations; i++) {
+      // xorshift64, so operands vary without a table lookup.
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      sum += op->func(x, x >> 11, modulus, secret);
+    }
+    uint64_t nanos = nowNanos() - start;
+    benchSink += sum;
+    if (nanos >= benchMinNanos) {
+      reportResult(op->name, 64, secret, iterations, nanos, benchNumAllocs - allocsBefore);
+      return;
+    }
+    iterations <<= 1;
+  }
+}
+
+int main(int argc, char **argv) {
+  uint64_t minMillis = RN_BENCH_DEFAULT_MIN_MILLIS;
+  if (argc > 2) {
+    fprintf(stderr, "Usage: %s [minMillisecondsPerBenchmark]\n", argv[0]);
+    return 1;
+  }
+  if (argc == 2) {
+    minMillis = strtoull(argv[1], NULL, 10);
+  }
+  benchMinNanos = minMillis * 1000000ull;
+  runtime_arrayStart();
+  printf("{\n  \"min_ms\": %lu,\n  \"results\": [", (unsigned long)minMillis);
+  for (uint32_t w = 0; w < RN_BENCH_NUM_WIDTHS; w++) {
+    for (uint32_t secret = 0; secret <= 1; secret++) {
+      benchOperands ops;
+      initOperands(&ops, benchWidths[w], secret);
+      for (uint32_t i = 0; i < RN_BENCH_NUM_BIGINT_OPS; i++) {
+        runBigintBench(benchBigintOps + i, &ops);
+      }
+      freeOperands(&ops);
+    }
+  }
+  for (uint32_t w = 0; w < RN_BENCH_NUM_TOOM3_WIDTHS; w++) {
+    benchOperands ops;
+    initOperands(&ops, benchToom3Widths[w], true);
+    for (uint32_t i = 0; i < RN_BENCH_NUM_TOOM3_OPS; i++) {
+      runBigintBench(benchToom3Ops + i, &ops);
+    }
+    freeOperands(&ops);
+  }
+  for (uint32_t secret = 0; secret <= 1; secret++) {
+    for (uint32_t i = 0; i < RN_BENCH_NUM_SMALLNUM_OPS; i++) {
+      runSmallnumBench(benchSmallnumOps + i, secret);
+    }
+  }
+  printf("\n  ]\n}\n");
+  runtime_arrayStop();
+  return 0;
+}
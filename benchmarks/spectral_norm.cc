@@ -0,0 +1,68 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// C++ version of spectral_norm.rn, for comparing floating point code.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+static double evalA(uint64_t i, uint64_t j) {
+  return (double)((i + j) * (i + j + 1) / 2 + i + 1);
+}
+
+static void Times(std::vector<double> &v, const std::vector<double> &u) {
+  for (size_t i = 0; i < v.size(); i++) {
+    v[i] = 0.0;
+    for (size_t j = 0; j < u.size(); j++) {
+      v[i] += u[j] / evalA(i, j);
+    }
+  }
+}
+
+static void TimesTransp(std::vector<double> &v, const std::vector<double> &u) {
+  for (size_t i = 0; i < v.size(); i++) {
+    v[i] = 0.0;
+    for (size_t j = 0; j < u.size(); j++) {
+      v[i] += u[j] / evalA(j, i);
+    }
+  }
+}
+
+static void ATimesTransp(std::vector<double> &v, const std::vector<double> &u) {
+  std::vector<double> x(u.size());
+  Times(x, u);
+  TimesTransp(v, x);
+}
+
+int main(int argc, char **argv) {
+  uint64_t N = argc > 1 ? strtoull(argv[1], NULL, 10) : 10;
+  std::vector<double> u(N, 1.0);
+  std::vector<double> v(N);
+  for (uint64_t i = 0; i < N; i++) {
+    ATimesTransp(v, u);
+    ATimesTransp(u, v);
+  }
+  double vBv = 0.0;
+  double vv = 0.0;
+  for (uint64_t i = 0; i < N; i++) {
+    vBv += u[i] * v[i];
+    vv += v[i] * v[i];
+  }
+  printf("%f\n", sqrt(vBv / vv));
+  return 0;
+}
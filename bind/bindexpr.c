@@ -628,6 +628,7 @@ static void bindNullExpression(deBlock scopeBlock, deExpression expression) {
     case DE_TYPE_INT:
     case DE_TYPE_FLOAT:
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_TUPLE:
     case DE_TYPE_STRUCT:
     case DE_TYPE_ENUMCLASS:
@@ -689,7 +690,30 @@ static void bindArrayofExpression(deBlock scopeBlock, deExpression expression) {
   if (deDatatypeGetType(datatype) == DE_TYPE_TEMPLATE) {
     deExprError(expression, "Cannot have array of template classes");
   }
-  deExpressionSetDatatype(expression, deArrayDatatypeCreate(datatype));
+  deExpression countExpr = deExpressionGetNextExpression(deExpressionGetFirstExpression(expression));
+  if (countExpr == deExpressionNull) {
+    deExpressionSetDatatype(expression, deArrayDatatypeCreate(datatype));
+    return;
+  }
+  // arrayof(T, n) is a fixed-size array of n elements, stored inline.  Only
+  // elements copied with plain loads and stores are allowed.
+  if (deExpressionGetType(countExpr) != DE_EXPR_INTEGER) {
+    deExprError(countExpr, "Fixed-size array lengths must be integer constants");
+  }
+  deDatatypeType type = deDatatypeGetType(datatype);
+  if (!deDatatypeIsNumber(datatype) && type != DE_TYPE_BOOL && type != DE_TYPE_ENUM) {
+    deExprError(expression, "Fixed-size arrays of %s are not supported",
+        deDatatypeGetTypeString(datatype));
+  }
+  if (deDatatypeContainsArray(datatype)) {
+    deExprError(expression, "Fixed-size arrays of big integers are not supported");
+  }
+  uint32 numElements = deBigintGetUint32(deExpressionGetBigint(countExpr),
+      deExpressionGetLine(countExpr));
+  if (numElements == 0) {
+    deExprError(countExpr, "Fixed-size arrays must have at least one element");
+  }
+  deExpressionSetDatatype(expression, deFixedArrayDatatypeCreate(datatype, numElements));
 }
 
 // Bind a typeof expression.
@@ -1327,9 +1351,16 @@ static void bindIndexExpression(deBlock scopeBlock, deExpression expression) {
   }
   deDatatypeType type = deDatatypeGetType(leftType);
   if (type != DE_TYPE_ARRAY && type != DE_TYPE_STRING && type != DE_TYPE_TUPLE &&
-      type != DE_TYPE_STRUCT) {
+      type != DE_TYPE_STRUCT && type != DE_TYPE_FIXEDARRAY) {
     deExprError(expression, "Index into non-array/non-string/non-tuple type");
   }
+  if (type == DE_TYPE_FIXEDARRAY && deExpressionGetType(right) == DE_EXPR_INTEGER) {
+    // Constant indexes are checked here, so no bounds check is generated.
+    uint32 index = deBigintGetUint32(deExpressionGetBigint(right), deExpressionGetLine(expression));
+    if (index >= deDatatypeGetWidth(leftType)) {
+      deExprError(expression, "Fixed-size array index out of bounds");
+    }
+  }
   if (type == DE_TYPE_TUPLE || type == DE_TYPE_STRUCT) {
     if (deExpressionGetType(right) != DE_EXPR_INTEGER) {
       deExprError(expression,
@@ -1361,6 +1392,7 @@ static deBlock findExpressionSubScope(deExpression expression) {
     case DE_TYPE_MODINT:
     case DE_TYPE_FLOAT:
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_ENUM:
     case DE_TYPE_FUNCPTR:
     case DE_TYPE_EXPR:
@@ -1586,6 +1618,9 @@ static bool bindDotExpression(deBlock scopeBlock, deExpression expression) {
   } else {
     // Some builtin types have method calls.
     deTemplate templ = deFindDatatypeTemplate(datatype);
+    if (templ == deTemplateNull) {
+      deExprError(expression, "Cannot use '.' on datatype %s", deDatatypeGetTypeString(datatype));
+    }
     classBlock = deFunctionGetSubBlock(deTemplateGetFunction(templ));
   }
   utAssert(deExpressionGetType(identExpr) == DE_EXPR_IDENT);
@@ -16,6 +16,26 @@
 
 #include <ctype.h>
 
+// Determine if a fixed-size array is nested inside the datatype.  Printed
+// fixed-size arrays are copied to a dynamic array first, which only works at
+// the top level.
+static bool hasNestedFixedArray(deDatatype datatype) {
+  deDatatypeType type = deDatatypeGetType(datatype);
+  if (type == DE_TYPE_ARRAY) {
+    deDatatype elementType = deDatatypeGetElementType(datatype);
+    return deDatatypeGetType(elementType) == DE_TYPE_FIXEDARRAY || hasNestedFixedArray(elementType);
+  }
+  if (type == DE_TYPE_TUPLE || type == DE_TYPE_STRUCT) {
+    deDatatype elementType;
+    deForeachDatatypeTypeList(datatype, elementType) {
+      if (deDatatypeGetType(elementType) == DE_TYPE_FIXEDARRAY || hasNestedFixedArray(elementType)) {
+        return true;
+      }
+    } deEndDatatypeTypeList;
+  }
+  return false;
+}
+
 // Verify the expression can be printed.  Return false if we modify the
 // expression to make it printable.
 static void checkExpressionIsPrintable(deExpression expression) {
@@ -37,6 +57,7 @@ static void checkExpressionIsPrintable(deExpression expression) {
   case DE_TYPE_ENUMCLASS:
   case DE_TYPE_ENUM:
   case DE_TYPE_ARRAY:
+  case DE_TYPE_FIXEDARRAY:
   case DE_TYPE_TEMPLATE:
   case DE_TYPE_CLASS:
     break;
@@ -48,6 +69,9 @@ static void checkExpressionIsPrintable(deExpression expression) {
     deExprError(expression, "Cannot print function pointers");
     break;
   }
+  if (hasNestedFixedArray(datatype)) {
+    deExprError(expression, "Cannot print fixed-size arrays nested in other types");
+  }
 }
 
 // Read a uint16 from the string.  Update the string pointer to point to first
@@ -116,7 +140,7 @@ static char* verifyFormatSpecifier(char* p, char *end, deDatatype datatype,
       deExprError(expression, "Expected bool argument");
     }
   } else if (c == '[') {
-    if (type != DE_TYPE_ARRAY) {
+    if (type != DE_TYPE_ARRAY && type != DE_TYPE_FIXEDARRAY) {
       deExprError(expression, "Expected array argument");
     }
     deDatatype elementType = deDatatypeGetElementType(datatype);
@@ -69,6 +69,8 @@ void deRefineAccessExpressionDatatype(deBlock scopeBlock, deExpression target,
         uint32 index = deBigintGetUint32(deExpressionGetBigint(indexExpr), line);
         deDatatypeArraySetiDatatype(types, index, valueType);
         nextValueType = deTupleDatatypeCreate(types);
+      } else if (deDatatypeGetType(nextTargetType) == DE_TYPE_FIXEDARRAY) {
+        nextValueType = deFixedArrayDatatypeCreate(valueType, deDatatypeGetWidth(nextTargetType));
       } else {
         utAssert(deDatatypeGetType(nextTargetType) == DE_TYPE_ARRAY);
         nextValueType = deArrayDatatypeCreate(valueType);
@@ -59,6 +59,7 @@ deTemplate deFindTypeTemplate(deDatatypeType type) {
       return deEnumTemplate;
     case DE_TYPE_CLASS:
       return deClassTemplate;
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_TEMPLATE:
     case DE_TYPE_NONE:
     case DE_TYPE_EXPR:
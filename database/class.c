@@ -221,7 +221,10 @@ deClass deClassCreate(deTemplate templ, deSignature signature) {
 
 // Make a copy of the template in |destBlock|.
 deTemplate deCopyTemplate(deTemplate templ, deFunction destConstructor) {
-  return deTemplateCreate(destConstructor, deTemplateGetRefWidth(templ), deTemplateGetLine(templ));
+  deTemplate newTempl = deTemplateCreate(destConstructor, deTemplateGetRefWidth(templ),
+      deTemplateGetLine(templ));
+  deTemplateSetArrayOfStructs(newTempl, deTemplateArrayOfStructs(templ));
+  return newTempl;
 }
 
 // Build a tuple expression for the class members.  Bind types as we go.
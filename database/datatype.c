@@ -56,6 +56,8 @@ char *deDatatypeTypeGetName(deDatatypeType type) {
     return "float";
   case DE_TYPE_ARRAY:
     return "array";
+  case DE_TYPE_FIXEDARRAY:
+    return "fixedarray";
   case DE_TYPE_TEMPLATE:
     return "templ";
   case DE_TYPE_CLASS:
@@ -113,7 +115,7 @@ deDatatype copyDatatype(deDatatype datatype) {
   deDatatypeSetNullable(copy, deDatatypeNullable(datatype));
   deDatatypeSetContainsArray(copy, deDatatypeContainsArray(datatype));
   switch (deDatatypeGetType(datatype)) {
-    case DE_TYPE_ARRAY: case DE_TYPE_STRING:
+    case DE_TYPE_ARRAY: case DE_TYPE_STRING: case DE_TYPE_FIXEDARRAY:
       deDatatypeSetElementType(copy, deDatatypeGetElementType(datatype));
       break;
     case DE_TYPE_FUNCPTR:
@@ -148,6 +150,7 @@ static uint32 hashDatatype(deDatatype datatype) {
   hash = utHashValues(hash, deDatatypeGetWidth(datatype));
   switch (deDatatypeGetType(datatype)) {
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
       hash = utHashValues(hash, deDatatype2Index(deDatatypeGetElementType(datatype)));
       break;
     case DE_TYPE_FUNCPTR:
@@ -188,6 +191,7 @@ static bool datatypesAreIdentical(deDatatype datatype1, deDatatype datatype2) {
   }
   switch (deDatatypeGetType(datatype1)) {
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
       if (deDatatypeGetElementType(datatype1) != deDatatypeGetElementType(datatype2)) {
         return false;
       }
@@ -372,6 +376,16 @@ deDatatype deArrayDatatypeCreate(deDatatype elementType) {
   return addToHashTable(datatype);
 }
 
+// Create a fixed-size array datatype.  The width is the number of elements,
+// which are stored inline, like the fields of a tuple.  If it already exists,
+// return the old one.
+deDatatype deFixedArrayDatatypeCreate(deDatatype elementType, uint32 numElements) {
+  deDatatype datatype = datatypeCreate(DE_TYPE_FIXEDARRAY, numElements,
+      deDatatypeConcrete(elementType));
+  deDatatypeSetElementType(datatype, elementType);
+  return addToHashTable(datatype);
+}
+
 // Create a template datatype.  If it already exists, return the old one.
 deDatatype deTemplateDatatypeCreate(deTemplate templ) {
   deDatatype datatype = datatypeCreate(DE_TYPE_TEMPLATE, deTemplateGetRefWidth(templ), false);
@@ -687,6 +701,9 @@ char *deDatatypeGetDefaultValueString(deDatatype datatype) {
       return utSprintf("0.0f%u", deDatatypeGetWidth(datatype));
     case DE_TYPE_ARRAY:
       return utSprintf("[%s]", deDatatypeGetDefaultValueString(deDatatypeGetElementType(datatype)));
+    case DE_TYPE_FIXEDARRAY:
+      return utSprintf("arrayof(%s, %u)", deDatatypeGetTypeString(deDatatypeGetElementType(datatype)),
+          deDatatypeGetWidth(datatype));
     case DE_TYPE_CLASS: {
       deTemplate templ = deClassGetTemplate(deDatatypeGetClass(datatype));
       return utSprintf("<%s%s>0u%u", deDatatypeGetTypeString(datatype),
@@ -795,6 +812,9 @@ char *deDatatypeGetTypeString(deDatatype datatype) {
       return utSprintf("f%u", deDatatypeGetWidth(datatype));
     case DE_TYPE_ARRAY:
       return utSprintf("[%s]", deDatatypeGetTypeString(deDatatypeGetElementType(datatype)));
+    case DE_TYPE_FIXEDARRAY:
+      return utSprintf("[%s; %u]", deDatatypeGetTypeString(deDatatypeGetElementType(datatype)),
+          deDatatypeGetWidth(datatype));
     case DE_TYPE_CLASS:
       return getClassTypeString(datatype);
     case DE_TYPE_FUNCPTR:
@@ -919,6 +939,17 @@ bool deDatatypeMatchesTypeExpression(deBlock scopeBlock, deDatatype datatype,
       return deDatatypeMatchesTypeExpression(
           scopeBlock, deDatatypeGetElementType(datatype),
           deExpressionGetFirstExpression(typeExpression));
+    case DE_EXPR_ARRAYOF: {
+      // A fixed-size array constraint, e.g. [u8; 32].
+      deExpression elementExpr = deExpressionGetFirstExpression(typeExpression);
+      deExpression countExpr = deExpressionGetNextExpression(elementExpr);
+      if (deDatatypeGetType(datatype) != DE_TYPE_FIXEDARRAY ||
+          deDatatypeGetWidth(datatype) != deBigintGetUint32(deExpressionGetBigint(countExpr), line)) {
+        return false;
+      }
+      return deDatatypeMatchesTypeExpression(
+          scopeBlock, deDatatypeGetElementType(datatype), elementExpr);
+    }
     case DE_EXPR_TUPLE: {
       if (deDatatypeGetType(datatype) != DE_TYPE_TUPLE) {
         return false;
@@ -1108,6 +1139,7 @@ deSecretType deFindDatatypeSectype(deDatatype datatype) {
     case DE_TYPE_ENUM:
       return deDatatypeSecret(datatype)? DE_SECTYPE_ALL_SECRET : DE_SECTYPE_ALL_PUBLIC;
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
       return deFindDatatypeSectype(deDatatypeGetElementType(datatype));
     case DE_TYPE_TUPLE:
     case DE_TYPE_STRUCT: {
@@ -256,6 +256,12 @@ static void dumpBuiltinExpr(deString string, deExpression expression, char* name
   deExpression left = deExpressionGetFirstExpression(expression);
   deStringSprintf(string, "%s(", name);
   deDumpExpressionStr(string, left);
+  deExpression right = deExpressionGetNextExpression(left);
+  if (right != deExpressionNull) {
+    // Only arrayof(T, n) has a second parameter.
+    deStringPuts(string, ", ");
+    deDumpExpressionStr(string, right);
+  }
   deStringPuts(string, ")");
 }
 
@@ -790,6 +796,7 @@ static void setExpressionToValue(deExpression expression, deValue value) {
     case DE_TYPE_NONE :
     case DE_TYPE_MODINT:
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_TUPLE:
     case DE_TYPE_STRUCT:
     case DE_TYPE_ENUM:
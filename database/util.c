@@ -182,12 +182,45 @@ char *deGetBlockPath(deBlock block, bool as_label) {
   return utSprintf("%s.%s", path, name);
 }
 
+// Hash the signature's parameter types.  Unlike the signature number, this
+// does not change when unrelated calls are added or reordered.
+static uint32 hashSignatureParamTypes(deSignature signature) {
+  uint32 hash = 0;
+  deParamspec paramspec;
+  deForeachSignatureParamspec(signature, paramspec) {
+    char *typeString = deDatatypeGetTypeString(deParamspecGetDatatype(paramspec));
+    hash = utHashValues(hash, utHashData(typeString, strlen(typeString)));
+  } deEndSignatureParamspec;
+  return hash;
+}
+
+// Find a suffix for the signature that is stable across builds, for profile
+// guided optimization, which matches profiles to functions by name.  If two
+// signatures of the function have the same hash, the later one also gets its
+// number.
+static char *findStableSignatureSuffix(deSignature signature) {
+  uint32 hash = hashSignatureParamTypes(signature);
+  uint32 number = deSignatureGetNumber(signature);
+  deSignature otherSignature;
+  deForeachFunctionSignature(deSignatureGetFunction(signature), otherSignature) {
+    if (deSignatureGetNumber(otherSignature) < number &&
+        hashSignatureParamTypes(otherSignature) == hash) {
+      return utSprintf("_%08x_%u", hash, number);
+    }
+  } deEndFunctionSignature;
+  return utSprintf("_%08x", hash);
+}
+
 // Create a label for a signature.  This will be the entry point of its function.
 char* deGetSignaturePath(deSignature signature) {
   deBlock subBlock;
   deFunction function = deSignatureGetFunction(signature);
   subBlock = deFunctionGetSubBlock(function);
   char* path = deGetBlockPath(subBlock, true);
+  if (deStableSignatureNames && !deFunctionExported(function) &&
+      deSignatureGetUniquifiedFunction(signature) != deFunctionNull) {
+    return utSprintf("%s%s", path, findStableSignatureSuffix(signature));
+  }
   uint32 number = deSignatureGetNumber(signature);
   if (number == 0) {
     return path;
@@ -504,6 +537,8 @@ char *deAppendFormatSpec(char *format, uint32 *len, uint32 *pos, deDatatype data
       break;
     }
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
+      // Fixed-size arrays are copied to a dynamic array before printing.
       format = appendArrayFormatSpec(format, len, pos, datatype);
       break;
     case DE_TYPE_TUPLE:
@@ -32,6 +32,7 @@ extern deRoot deTheRoot;
 void deStart(char *fileName);
 void deStop(void);
 deValue deEvaluateExpression(deBlock scopeBlock, deExpression expression, deBigint modulus);
+void deFindFieldGroups(void);
 void deAddMemoryManagement(void);
 void deCallFinalInDestructors(void);
 void deParseBuiltinFunctions(void);
@@ -57,6 +58,8 @@ void deBindRPCs(void);
 void deBind(void);
 void deReportEvents(void);
 void deInlineIterators(void);
+void deFindLastUses(void);
+void deFindBorrowedVariables(void);
 void deBindAllSignatures(void);
 void deBindStatement(deBinding binding);
 void deQueueSignature(deSignature signature);
@@ -341,6 +344,7 @@ deDatatype deIntDatatypeCreate(uint32 width);
 deDatatype deModintDatatypeCreate(deExpression modulus);
 deDatatype deFloatDatatypeCreate(uint32 width);
 deDatatype deArrayDatatypeCreate(deDatatype elementType);
+deDatatype deFixedArrayDatatypeCreate(deDatatype elementType, uint32 numElements);
 deDatatype deTemplateDatatypeCreate(deTemplate templ);
 deDatatype deClassDatatypeCreate(deClass theClass);
 deDatatype deClassDatatypeCreateFromParams(deClass theClass,
@@ -557,6 +561,16 @@ extern bool deLogTokens;
 extern bool deInvertReturnCode;
 extern char *deLLVMFileName;
 extern bool deTestMode;
+// Name signatures by their parameter types rather than their creation order.
+extern bool deStableSignatureNames;
+// Store class fields as arrays of structures rather than structures of arrays.
+extern bool deArrayOfStructs;
+// Group fields accessed together into tuples.
+extern bool deGroupFields;
+// Print the field layout chosen for each class.
+extern bool deShowFieldGroups;
+// Skip reference counting for borrowed locals, and inline ref and unref.
+extern bool deElideRefCounting;
 extern uint32 deStackPos;
 extern char *deStringVal;
 extern uint32 deStringAllocated;
@@ -16,5 +16,31 @@
 #define EXPERIMENTAL_WAYWARDGEEK_RUNE_INCLUDE_LLEXPORT_H_
 
 void llGenerateLLVMAssemblyCode(char* fileName, bool debugMode);
+char *llGenerateLLVMAssemblyText(char* fileName, bool debugMode, size_t *length);
+bool llCompileWithLLVMAPI(char *text, size_t length, char *moduleName,
+    char *objectFileName, char *passes, bool optimized, char *runtimeBitcode);
+bool llPartitionLLVMAssembly(char *text, size_t length, uint32 numPartitions, char **fileNames);
+
+// Bigints up to this width are lowered to native LLVM integers where possible.
+extern uint32 llNativeBigintWidth;
+// Fast-math flags for floating point instructions, each preceded by a space.
+extern char *llFastMathFlags;
+// Values of the "target-cpu" and "target-features" function attributes, or NULL.
+extern char *llTargetCpu;
+extern char *llTargetFeatures;
+// If true, functions whose LLVM IR is identical to an earlier function's
+// become thunks which tail-call the earlier one.
+extern bool llShareIdenticalFunctions;
+// If true, print the path of each function replaced with a thunk.
+extern bool llShowSharedFunctions;
+// If false, no TBAA metadata is emitted, so LLVM assumes field arrays and
+// array headers may alias.
+extern bool llEmitTBAA;
+// If true, print the bounds and null checks left in each function, and how
+// many were eliminated in total.
+extern bool llShowBoundsChecks;
+// If true, -llvmapi prints the time spent printing and parsing IR, linking the
+// runtime, running passes, and writing the object file.
+extern bool llTimeLLVMAPI;
 
 #endif  // EXPERIMENTAL_WAYWARDGEEK_RUNE_INCLUDE_LLEXPORT_H_
@@ -0,0 +1,638 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Find bounds and null checks that are provably redundant.  There are two
+// sources of proofs.  For-loops that count up from a non-negative value to a
+// bound make indexing arrays of that length safe with the loop variable, for
+// the whole loop body.  Checks already done in the current basic block make
+// repeating the same check safe, until one of the variables is written.
+#include "ll.h"
+
+// Loops index at most this many arrays that we range check before the loop.
+#define LL_MAX_HOISTED_ARRAYS 4
+// Versioning generates the loop twice, so only loops with at most this many
+// statements in their body, counting nested blocks, are versioned.  Loops
+// inside a versioned loop are not versioned again, so code grows by at most
+// this much per versioned loop.
+#define LL_MAX_VERSIONED_LOOP_STATEMENTS 64
+
+// Indexing |array| with |index| is known to be in bounds.  If |array| is
+// null, |index| is an object known to be non-null.
+typedef struct {
+  deVariable array;
+  deVariable index;
+} llSafeIndex;
+
+// Indexes safe for the whole body of the enclosing for-loops.
+static llSafeIndex *llLoopIndexes;
+static uint32 llNumLoopIndexes;
+static uint32 llLoopIndexesAllocated;
+// Indexes checked earlier in the current basic block.
+static llSafeIndex *llCheckedIndexes;
+static uint32 llNumCheckedIndexes;
+static uint32 llCheckedIndexesAllocated;
+// Arrays found by the last call to llFindHoistedBoundsChecks.
+static deVariable llHoistedArrays[LL_MAX_HOISTED_ARRAYS];
+static uint32 llNumHoistedArrays;
+// Counters reported with -showboundschecks.
+static uint32 llNumChecks;
+static uint32 llNumEliminatedChecks;
+// The counters when the current function was started.
+static uint32 llFunctionStartChecks;
+static uint32 llFunctionStartEliminatedChecks;
+// False while generating the second copy of a versioned loop.
+static bool llCountChecks;
+
+// Initialize the bounds check module.
+void llStartBoundsChecks(void) {
+  llLoopIndexesAllocated = 16;
+  llNumLoopIndexes = 0;
+  llLoopIndexes = utNewA(llSafeIndex, llLoopIndexesAllocated);
+  llCheckedIndexesAllocated = 16;
+  llNumCheckedIndexes = 0;
+  llCheckedIndexes = utNewA(llSafeIndex, llCheckedIndexesAllocated);
+  llNumHoistedArrays = 0;
+  llNumChecks = 0;
+  llNumEliminatedChecks = 0;
+  llFunctionStartChecks = 0;
+  llFunctionStartEliminatedChecks = 0;
+  llCountChecks = true;
+}
+
+// Free memory used by the bounds check module.
+void llStopBoundsChecks(void) {
+  utFree(llLoopIndexes);
+  utFree(llCheckedIndexes);
+}
+
+// Append a safe index to the list.
+static llSafeIndex *appendSafeIndex(llSafeIndex *list, uint32 *num, uint32 *allocated,
+    deVariable array, deVariable index) {
+  if (*num == *allocated) {
+    *allocated <<= 1;
+    utResizeArray(list, *allocated);
+  }
+  list[*num].array = array;
+  list[*num].index = index;
+  (*num)++;
+  return list;
+}
+
+// Find the safe index in the list.
+static bool findSafeIndex(llSafeIndex *list, uint32 num, deVariable array, deVariable index) {
+  for (uint32 i = 0; i < num; i++) {
+    if (list[i].array == array && list[i].index == index) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Add an index that is safe for the rest of the current loop body.
+static void addLoopIndex(deVariable array, deVariable index) {
+  if (index != deVariableNull &&
+      !findSafeIndex(llLoopIndexes, llNumLoopIndexes, array, index)) {
+    llLoopIndexes = appendSafeIndex(llLoopIndexes, &llNumLoopIndexes,
+        &llLoopIndexesAllocated, array, index);
+  }
+}
+
+// Return the variable the expression names, if it is an identifier bound to
+// a variable.
+static deVariable findExpressionVariable(deExpression expression) {
+  if (deExpressionGetType(expression) != DE_EXPR_IDENT) {
+    return deVariableNull;
+  }
+  deIdent ident = deExpressionGetIdent(expression);
+  if (ident == deIdentNull || deIdentGetType(ident) != DE_IDENT_VARIABLE) {
+    return deVariableNull;
+  }
+  return deIdentGetVariable(ident);
+}
+
+// Determine if the variable is local to a function.  Only code in its own
+// function can write these.  Parameters are excluded, since var parameters
+// may refer to globals, and variables of modules are globals.
+static bool isFunctionLocal(deVariable variable) {
+  if (variable == deVariableNull || deVariableGetType(variable) != DE_VAR_LOCAL) {
+    return false;
+  }
+  deFunction function = deBlockGetOwningFunction(deVariableGetBlock(variable));
+  deFunctionType type = deFunctionGetType(function);
+  return type != DE_FUNC_MODULE && type != DE_FUNC_PACKAGE;
+}
+
+// Determine if the variable is a function local array or string.
+static bool isLocalArray(deVariable variable) {
+  if (!isFunctionLocal(variable)) {
+    return false;
+  }
+  deDatatypeType type = deDatatypeGetType(deVariableGetDatatype(variable));
+  return type == DE_TYPE_ARRAY || type == DE_TYPE_STRING;
+}
+
+// Determine if the variable is a function local integer that fits in an
+// array index.
+static bool isLocalIndex(deVariable variable) {
+  if (!isFunctionLocal(variable)) {
+    return false;
+  }
+  deDatatype datatype = deVariableGetDatatype(variable);
+  deDatatypeType type = deDatatypeGetType(datatype);
+  return (type == DE_TYPE_UINT || type == DE_TYPE_INT) &&
+      deDatatypeGetWidth(datatype) <= llSizeWidth;
+}
+
+// If this is a call to array.length() or string.length(), return the array.
+static deVariable findLengthCallArray(deExpression expression) {
+  if (deExpressionGetType(expression) != DE_EXPR_CALL) {
+    return deVariableNull;
+  }
+  deExpression access = deExpressionGetFirstExpression(expression);
+  deDatatype callType = deExpressionGetDatatype(access);
+  if (deExpressionGetType(access) != DE_EXPR_DOT ||
+      deDatatypeGetType(callType) != DE_TYPE_FUNCTION) {
+    return deVariableNull;
+  }
+  deFunction function = deDatatypeGetFunction(callType);
+  if (!deFunctionBuiltin(function)) {
+    return deVariableNull;
+  }
+  deBuiltinFuncType type = deFunctionGetBuiltinType(function);
+  if (type != DE_BUILTINFUNC_ARRAYLENGTH && type != DE_BUILTINFUNC_STRINGLENGTH) {
+    return deVariableNull;
+  }
+  return findExpressionVariable(deExpressionGetFirstExpression(access));
+}
+
+// Determine if the expression is a call to a builtin method, which cannot
+// run user code.
+static bool isBuiltinCall(deExpression expression) {
+  deDatatype callType = deExpressionGetDatatype(deExpressionGetFirstExpression(expression));
+  return deDatatypeGetType(callType) == DE_TYPE_FUNCTION &&
+      deFunctionBuiltin(deDatatypeGetFunction(callType));
+}
+
+// Determine if the expression type is an assignment, such as a = b or a += b.
+static bool isAssignment(deExpressionType type) {
+  return type == DE_EXPR_EQUALS ||
+      (type >= DE_EXPR_ADD_EQUALS && type <= DE_EXPR_MULTRUNC_EQUALS);
+}
+
+// Determine if the expression only reads the variable.  The variable must
+// not be assigned, or passed to a user function, which could take it as a
+// var parameter.
+static bool expressionOnlyReads(deExpression expression, deVariable variable) {
+  deExpressionType type = deExpressionGetType(expression);
+  if (isAssignment(type) &&
+      findExpressionVariable(deExpressionGetFirstExpression(expression)) == variable) {
+    return false;
+  }
+  if (type == DE_EXPR_CALL && !isBuiltinCall(expression)) {
+    deExpression access = deExpressionGetFirstExpression(expression);
+    deExpression parameters = deExpressionGetNextExpression(access);
+    deExpression parameter;
+    deForeachExpressionExpression(parameters, parameter) {
+      deExpression value = parameter;
+      if (deExpressionGetType(parameter) == DE_EXPR_NAMEDPARAM) {
+        value = deExpressionGetLastExpression(parameter);
+      }
+      if (findExpressionVariable(value) == variable) {
+        return false;
+      }
+    } deEndExpressionExpression;
+  }
+  deExpression child;
+  deForeachExpressionExpression(expression, child) {
+    if (!expressionOnlyReads(child, variable)) {
+      return false;
+    }
+  } deEndExpressionExpression;
+  return true;
+}
+
+// Determine if the expression only indexes the array, or reads its length.
+// Any other use, such as assigning it, passing it to a function, or calling
+// a method like append, could change its length.
+static bool expressionOnlyIndexes(deExpression expression, deVariable array) {
+  deExpressionType type = deExpressionGetType(expression);
+  if (findExpressionVariable(expression) == array) {
+    return false;
+  }
+  if (findLengthCallArray(expression) == array) {
+    return true;
+  }
+  deExpression child = deExpressionGetFirstExpression(expression);
+  if (type == DE_EXPR_INDEX && findExpressionVariable(child) == array) {
+    child = deExpressionGetNextExpression(child);
+  }
+  for (; child != deExpressionNull; child = deExpressionGetNextExpression(child)) {
+    if (!expressionOnlyIndexes(child, array)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Determine if the statements from |statement| to the end of its block, and
+// their sub-blocks, only read |variable|.  If |isArray|, they may also index
+// it, but not change its length.
+static bool statementsPreserve(deStatement statement, deVariable variable, bool isArray) {
+  for (; statement != deStatementNull; statement = deStatementGetNextBlockStatement(statement)) {
+    deExpression expression = deStatementGetExpression(statement);
+    if (expression != deExpressionNull) {
+      bool preserved = isArray? expressionOnlyIndexes(expression, variable) :
+          expressionOnlyReads(expression, variable);
+      if (!preserved) {
+        return false;
+      }
+    }
+    deBlock subBlock = deStatementGetSubBlock(statement);
+    if (subBlock != deBlockNull &&
+        !statementsPreserve(deBlockGetFirstStatement(subBlock), variable, isArray)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Determine if the loop body preserves the variable.
+static bool bodyPreserves(deBlock body, deVariable variable, bool isArray) {
+  return statementsPreserve(deBlockGetFirstStatement(body), variable, isArray);
+}
+
+// Determine if the expression is a non-negative integer constant, possibly
+// cast, as in <first>0.
+static bool isNonNegativeConstant(deExpression expression) {
+  deExpressionType type = deExpressionGetType(expression);
+  if (type == DE_EXPR_CAST || type == DE_EXPR_CASTTRUNC) {
+    return isNonNegativeConstant(deExpressionGetLastExpression(expression));
+  }
+  return type == DE_EXPR_INTEGER && !deBigintNegative(deExpressionGetBigint(expression));
+}
+
+// Find the induction variable of a for-loop of the form:
+//
+//   for i = <non-negative>, i < bound, i += <non-negative> {
+//
+// Unsigned loop variables may be initialized and updated with anything.
+// Neither the loop variable nor a bound variable may be written in the body,
+// so i < bound holds throughout the body.  Return deVariableNull if the loop
+// does not have this form.
+static deVariable findInductionVariable(deStatement statement, deExpression *bound) {
+  deExpression expression = deStatementGetExpression(statement);
+  deExpression init = deExpressionGetFirstExpression(expression);
+  deExpression test = deExpressionGetNextExpression(init);
+  deExpression update = deExpressionGetNextExpression(test);
+  deBlock body = deStatementGetSubBlock(statement);
+  if (deExpressionGetType(init) != DE_EXPR_EQUALS || deExpressionGetType(test) != DE_EXPR_LT) {
+    return deVariableNull;
+  }
+  deVariable index = findExpressionVariable(deExpressionGetFirstExpression(init));
+  if (!isLocalIndex(index) ||
+      findExpressionVariable(deExpressionGetFirstExpression(test)) != index ||
+      findExpressionVariable(deExpressionGetFirstExpression(update)) != index) {
+    return deVariableNull;
+  }
+  if (deDatatypeGetType(deVariableGetDatatype(index)) != DE_TYPE_UINT &&
+      (!isNonNegativeConstant(deExpressionGetLastExpression(init)) ||
+       deExpressionGetType(update) != DE_EXPR_ADD_EQUALS ||
+       !isNonNegativeConstant(deExpressionGetLastExpression(update)))) {
+    return deVariableNull;
+  }
+  if (!bodyPreserves(body, index, false)) {
+    return deVariableNull;
+  }
+  // The bound must be the same for each iteration.
+  *bound = deExpressionGetLastExpression(test);
+  deVariable boundVar = findExpressionVariable(*bound);
+  deVariable lengthArray = findLengthCallArray(*bound);
+  if (boundVar != deVariableNull) {
+    if (!isLocalIndex(boundVar) || !bodyPreserves(body, boundVar, false)) {
+      return deVariableNull;
+    }
+  } else if (lengthArray != deVariableNull) {
+    if (!isLocalArray(lengthArray) || !bodyPreserves(body, lengthArray, true)) {
+      return deVariableNull;
+    }
+  } else if (!isNonNegativeConstant(*bound)) {
+    return deVariableNull;
+  }
+  return index;
+}
+
+// Inlined iterators assign the loop variable to the user's variable in the
+// first statement of the body, as in:
+//
+//   for i = 0, i < first, i += 1 {
+//     x = i
+//
+// Return x if it is not written in the rest of the body.
+static deVariable findIndexCopy(deBlock body, deVariable index) {
+  deStatement first = deBlockGetFirstStatement(body);
+  if (first == deStatementNull || deStatementGetType(first) != DE_STATEMENT_ASSIGN) {
+    return deVariableNull;
+  }
+  deExpression assignment = deStatementGetExpression(first);
+  if (deExpressionGetType(assignment) != DE_EXPR_EQUALS ||
+      findExpressionVariable(deExpressionGetLastExpression(assignment)) != index) {
+    return deVariableNull;
+  }
+  deVariable copy = findExpressionVariable(deExpressionGetFirstExpression(assignment));
+  if (!isLocalIndex(copy) ||
+      !statementsPreserve(deStatementGetNextBlockStatement(first), copy, false)) {
+    return deVariableNull;
+  }
+  return copy;
+}
+
+// Find the array whose length the bound is.  The bound may be a call to
+// length(), or a variable assigned one just before the loop, as iterators
+// like range(a.length()) do.  The statements between must be simple
+// assignments that mention neither.
+static deVariable findBoundArray(deStatement statement, deExpression bound) {
+  deVariable array = findLengthCallArray(bound);
+  if (array != deVariableNull) {
+    return array;
+  }
+  deVariable boundVar = findExpressionVariable(bound);
+  if (boundVar == deVariableNull) {
+    return deVariableNull;
+  }
+  deStatement prev = deStatementGetPrevBlockStatement(statement);
+  while (prev != deStatementNull && deStatementGetType(prev) == DE_STATEMENT_ASSIGN) {
+    deExpression assignment = deStatementGetExpression(prev);
+    if (deExpressionGetType(assignment) != DE_EXPR_EQUALS) {
+      return deVariableNull;
+    }
+    if (findExpressionVariable(deExpressionGetFirstExpression(assignment)) == boundVar) {
+      return findLengthCallArray(deExpressionGetLastExpression(assignment));
+    }
+    if (!expressionOnlyReads(assignment, boundVar)) {
+      return deVariableNull;
+    }
+    prev = deStatementGetPrevBlockStatement(prev);
+  }
+  return deVariableNull;
+}
+
+// Check that nothing between the bound assignment found by findBoundArray
+// and the loop changes the array's length.
+static bool arrayPreservedBeforeLoop(deStatement statement, deExpression bound, deVariable array) {
+  deVariable boundVar = findExpressionVariable(bound);
+  if (boundVar == deVariableNull) {
+    return true;  // The bound is array.length() itself.
+  }
+  deStatement prev = deStatementGetPrevBlockStatement(statement);
+  deExpression assignment = deStatementGetExpression(prev);
+  while (findExpressionVariable(deExpressionGetFirstExpression(assignment)) != boundVar) {
+    if (!expressionOnlyIndexes(assignment, array)) {
+      return false;
+    }
+    prev = deStatementGetPrevBlockStatement(prev);
+    assignment = deStatementGetExpression(prev);
+  }
+  return true;
+}
+
+// Return the number of saved loop indexes, to pass to llRestoreLoopIndexes.
+uint32 llSaveLoopIndexes(void) {
+  return llNumLoopIndexes;
+}
+
+// Forget loop indexes added since llSaveLoopIndexes returned |savedNumLoopIndexes|.
+void llRestoreLoopIndexes(uint32 savedNumLoopIndexes) {
+  llNumLoopIndexes = savedNumLoopIndexes;
+}
+
+// If the for-loop counts up to the length of a local array that the body
+// does not resize, indexing the array with the loop variable is safe in the
+// body.  Add these indexes for the body, which the caller must remove with
+// llRestoreLoopIndexes when done with the body.
+void llAddLoopIndexes(deStatement statement) {
+  deExpression bound;
+  deVariable index = findInductionVariable(statement, &bound);
+  if (index == deVariableNull) {
+    return;
+  }
+  deVariable array = findBoundArray(statement, bound);
+  deBlock body = deStatementGetSubBlock(statement);
+  if (!isLocalArray(array) || !bodyPreserves(body, array, true) ||
+      !arrayPreservedBeforeLoop(statement, bound, array)) {
+    return;
+  }
+  addLoopIndex(array, index);
+  addLoopIndex(array, findIndexCopy(body, index));
+}
+
+// Add the arrays indexed by the variables in the expression to the hoisted arrays.
+static void findIndexedArrays(deExpression expression, deVariable index, deVariable copy) {
+  if (deExpressionGetType(expression) == DE_EXPR_INDEX) {
+    deVariable array = findExpressionVariable(deExpressionGetFirstExpression(expression));
+    deVariable indexVar = findExpressionVariable(deExpressionGetLastExpression(expression));
+    if (isLocalArray(array) && (indexVar == index || indexVar == copy) &&
+        !findSafeIndex(llLoopIndexes, llNumLoopIndexes, array, indexVar)) {
+      bool found = false;
+      for (uint32 i = 0; i < llNumHoistedArrays; i++) {
+        found |= llHoistedArrays[i] == array;
+      }
+      if (!found && llNumHoistedArrays < LL_MAX_HOISTED_ARRAYS) {
+        llHoistedArrays[llNumHoistedArrays++] = array;
+      }
+    }
+  }
+  deExpression child;
+  deForeachExpressionExpression(expression, child) {
+    findIndexedArrays(child, index, copy);
+  } deEndExpressionExpression;
+}
+
+// Add the arrays indexed by the loop variables in the block.
+static void findBlockIndexedArrays(deBlock block, deVariable index, deVariable copy) {
+  deStatement statement;
+  deForeachBlockStatement(block, statement) {
+    deExpression expression = deStatementGetExpression(statement);
+    if (expression != deExpressionNull) {
+      findIndexedArrays(expression, index, copy);
+    }
+    deBlock subBlock = deStatementGetSubBlock(statement);
+    if (subBlock != deBlockNull) {
+      findBlockIndexedArrays(subBlock, index, copy);
+    }
+  } deEndBlockStatement;
+}
+
+// Return the number of statements in the block, including nested blocks, up
+// to |limit| + 1.
+static uint32 countBlockStatements(deBlock block, uint32 limit) {
+  uint32 numStatements = 0;
+  deStatement statement;
+  deForeachBlockStatement(block, statement) {
+    if (++numStatements > limit) {
+      return numStatements;
+    }
+    deBlock subBlock = deStatementGetSubBlock(statement);
+    if (subBlock != deBlockNull) {
+      numStatements += countBlockStatements(subBlock, limit - numStatements);
+      if (numStatements > limit) {
+        return numStatements;
+      }
+    }
+  } deEndBlockStatement;
+  return numStatements;
+}
+
+// Find local arrays the for-loop body indexes with the loop variable, which
+// are not resized in the body, and are not already known to be safe.  If
+// bound <= array.length() for each of them, which the caller checks once
+// before the loop, all these indexes are in bounds.  Return the number of
+// arrays, and set |bound|.  Call llGetHoistedArray to get the arrays.  Bodies
+// longer than LL_MAX_VERSIONED_LOOP_STATEMENTS are not worth duplicating.
+uint32 llFindHoistedBoundsChecks(deStatement statement, deExpression *bound) {
+  llNumHoistedArrays = 0;
+  deVariable index = findInductionVariable(statement, bound);
+  if (index == deVariableNull) {
+    return 0;
+  }
+  deBlock body = deStatementGetSubBlock(statement);
+  if (countBlockStatements(body, LL_MAX_VERSIONED_LOOP_STATEMENTS) >
+      LL_MAX_VERSIONED_LOOP_STATEMENTS) {
+    return 0;
+  }
+  deVariable copy = findIndexCopy(body, index);
+  findBlockIndexedArrays(body, index, copy);
+  uint32 numArrays = 0;
+  for (uint32 i = 0; i < llNumHoistedArrays; i++) {
+    deVariable array = llHoistedArrays[i];
+    if (bodyPreserves(body, array, true)) {
+      llHoistedArrays[numArrays++] = array;
+    }
+  }
+  llNumHoistedArrays = numArrays;
+  return numArrays;
+}
+
+// Return a hoisted array found by llFindHoistedBoundsChecks.
+deVariable llGetHoistedArray(uint32 index) {
+  utAssert(index < llNumHoistedArrays);
+  return llHoistedArrays[index];
+}
+
+// Add the hoisted arrays found by llFindHoistedBoundsChecks as safe to index
+// with the loop variables.  Only call this after checking the bound.
+void llAddHoistedLoopIndexes(deStatement statement) {
+  deExpression bound;
+  deVariable index = findInductionVariable(statement, &bound);
+  deVariable copy = findIndexCopy(deStatementGetSubBlock(statement), index);
+  for (uint32 i = 0; i < llNumHoistedArrays; i++) {
+    addLoopIndex(llHoistedArrays[i], index);
+    addLoopIndex(llHoistedArrays[i], copy);
+  }
+}
+
+// Determine if the index or null check is redundant, and count it.
+static bool checkIsRedundant(deVariable array, deVariable index) {
+  llNumChecks += llCountChecks;
+  if (index == deVariableNull) {
+    return false;
+  }
+  if (findSafeIndex(llLoopIndexes, llNumLoopIndexes, array, index) ||
+      findSafeIndex(llCheckedIndexes, llNumCheckedIndexes, array, index)) {
+    llNumEliminatedChecks += llCountChecks;
+    return true;
+  }
+  return false;
+}
+
+// Determine if the index expression, array[index], needs a bounds check.
+bool llIndexNeedsBoundsCheck(deExpression expression) {
+  deExpression left = deExpressionGetFirstExpression(expression);
+  deVariable array = findExpressionVariable(left);
+  deVariable index = findExpressionVariable(deExpressionGetNextExpression(left));
+  if (array == deVariableNull) {
+    llNumChecks += llCountChecks;
+    return true;
+  }
+  return !checkIsRedundant(array, index);
+}
+
+// Determine if the object expression needs a null check.
+bool llObjectNeedsNullCheck(deExpression expression) {
+  return !checkIsRedundant(deVariableNull, findExpressionVariable(expression));
+}
+
+// Remember that the index expression was bounds checked, until the end of
+// the basic block, or until the array or index is written.
+void llRecordBoundsCheck(deExpression expression) {
+  deExpression left = deExpressionGetFirstExpression(expression);
+  deVariable array = findExpressionVariable(left);
+  deVariable index = findExpressionVariable(deExpressionGetNextExpression(left));
+  if (array != deVariableNull && index != deVariableNull) {
+    llCheckedIndexes = appendSafeIndex(llCheckedIndexes, &llNumCheckedIndexes,
+        &llCheckedIndexesAllocated, array, index);
+  }
+}
+
+// Remember that the object expression was null checked.
+void llRecordNullCheck(deExpression expression) {
+  deVariable object = findExpressionVariable(expression);
+  if (object != deVariableNull) {
+    llCheckedIndexes = appendSafeIndex(llCheckedIndexes, &llNumCheckedIndexes,
+        &llCheckedIndexesAllocated, deVariableNull, object);
+  }
+}
+
+// Forget all checks done in the current basic block.  Call this at labels,
+// and wherever user code could run.
+void llForgetBoundsChecks(void) {
+  llNumCheckedIndexes = 0;
+}
+
+// Forget checks done on the variable, when it is written.
+void llForgetVariableBoundsChecks(deVariable variable) {
+  uint32 j = 0;
+  for (uint32 i = 0; i < llNumCheckedIndexes; i++) {
+    llSafeIndex safeIndex = llCheckedIndexes[i];
+    if (safeIndex.array != variable && safeIndex.index != variable) {
+      llCheckedIndexes[j++] = safeIndex;
+    }
+  }
+  llNumCheckedIndexes = j;
+}
+
+// Count checks only if |count| is true.  Versioned loops are generated twice,
+// and their checks are counted once.
+void llCountBoundsChecks(bool count) {
+  llCountChecks = count;
+}
+
+// Start counting the checks of a new function.
+void llStartFunctionBoundsChecks(void) {
+  llFunctionStartChecks = llNumChecks;
+  llFunctionStartEliminatedChecks = llNumEliminatedChecks;
+}
+
+// Report how many checks are left in the function named |name|, if it had any.
+void llReportFunctionBoundsChecks(char *name) {
+  uint32 numChecks = llNumChecks - llFunctionStartChecks;
+  uint32 numEliminated = llNumEliminatedChecks - llFunctionStartEliminatedChecks;
+  if (numChecks != 0) {
+    printf("%s: %u bounds and null checks left\n", name, numChecks - numEliminated);
+  }
+}
+
+// Report how many checks were eliminated.
+void llReportBoundsChecks(void) {
+  printf("Eliminated %u of %u bounds and null checks\n", llNumEliminatedChecks, llNumChecks);
+}
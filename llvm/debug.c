@@ -204,6 +204,8 @@ static uint32 findDatatypeSize(deDatatype datatype) {
     case DE_TYPE_TUPLE:
     case DE_TYPE_STRUCT:
       return findTupleSize(datatype);
+    case DE_TYPE_FIXEDARRAY:
+      return deDatatypeGetWidth(datatype) * findDatatypeSize(deDatatypeGetElementType(datatype));
     default:
       utExit("Unexpected datatype");
   }
@@ -251,6 +253,21 @@ static llTag createTupleOrStructTag(deDatatype datatype) {
   return createTag(text);
 }
 
+// Create a tag for a fixed-size array.  E.g.:
+//   !5 = !DICompositeType(tag: DW_TAG_array_type, baseType: !6, size: 256,
+//        elements: !7)
+//   !7 = !{!8}
+//   !8 = !DISubrange(count: 32)
+static llTag createFixedArrayTypeTag(deDatatype datatype) {
+  llTag elementTag = createDatatypeTag(deDatatypeGetElementType(datatype));
+  uint32 numElements = deDatatypeGetWidth(datatype);
+  llTag rangeTag = createTag(utSprintf("!DISubrange(count: %u)", numElements));
+  llTag elementsTag = createTag(utSprintf("!{!%u}", llTagGetNum(rangeTag)));
+  return createTag(utSprintf(
+      "!DICompositeType(tag: DW_TAG_array_type, baseType: !%u, size: %u, elements: !%u)",
+      llTagGetNum(elementTag), findDatatypeSize(datatype), llTagGetNum(elementsTag)));
+}
+
 // Create an enumerated type tag.  E.g.:
 //   !3 = !DICompositeType(tag: DW_TAG_enumeration_type, file: !1, line: 1,
 //        baseType: !4, size: 32, elements: !5)
@@ -394,6 +411,8 @@ static llTag createDatatypeTag(deDatatype datatype) {
     case DE_TYPE_TUPLE:
     case DE_TYPE_STRUCT:
       return createTupleOrStructTag(datatype);
+    case DE_TYPE_FIXEDARRAY:
+      return createFixedArrayTypeTag(datatype);
     case DE_TYPE_ENUMCLASS:
     case DE_TYPE_ENUM:
       return createEnumTag(datatype);
@@ -531,15 +550,27 @@ static void writeTagsHeader(void) {
   writeGlobalsTag(LL_NUM_HEADER_TAGS);
 }
 
-// Write debug tags to the output file.
-void llWriteDebugTags(void) {
-  writeTagsHeader();
+// Write all metadata nodes, debug tags included, to the output file.
+void llWriteMetadataNodes(void) {
   llTag tag;
   llForeachRootTag(deTheRoot, tag) {
     llPrintf("!%u = %s\n", llTagGetNum(tag), llTagGetText(tag));
   } llEndRootTag;
 }
 
+// Write debug tags to the output file.
+void llWriteDebugTags(void) {
+  writeTagsHeader();
+  llWriteMetadataNodes();
+}
+
+// Create a metadata node that is not debug info, such as a TBAA type
+// descriptor, and return its number.  These share numbering with debug tags,
+// and are written even when not in debug mode.
+uint32 llCreateMetadataNode(char *text) {
+  return llTagGetNum(createTag(text));
+}
+
 // Create a new location tag.
 llTag llCreateLocationTag(llTag scopeTag, deLine line) {
   char *text = utSprintf("!DILocation(line: %u, scope: !%u)",
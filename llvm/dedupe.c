@@ -0,0 +1,129 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Find functions whose generated LLVM IR is identical to a function generated
+// earlier.  Rune instantiates a signature for each combination of parameter
+// types, and many of them compile to the same code.  For example, references
+// to objects of different classes with the same reference width are all LLVM
+// integers of that width.  Comparing the generated IR rather than the bound
+// Rune code means types which lower to the same LLVM type compare equal, and
+// anything which lowers differently, such as accesses to different classes'
+// field arrays, does not.  The code generator replaces each duplicate with a
+// thunk which tail-calls the first copy.
+
+#include "ll.h"
+
+#include <ctype.h>
+
+// Number of hash table buckets.  Must be a power of 2.
+#define LL_NUM_FUNCTION_BUCKETS 4096
+
+// A function body seen so far.
+typedef struct {
+  char *text;  // Normalized text of the function.
+  char *name;  // Escaped name of the function.
+  uint32 hash;
+  int32 next;  // Next body in the same bucket, or -1.
+} llFunctionBody;
+
+static llFunctionBody *llBodies;
+static uint32 llNumBodies;
+static uint32 llBodiesAllocated;
+static int32 *llBodyBuckets;
+
+// Initialize the table of function bodies.
+void llStartFunctionSharing(void) {
+  llNumBodies = 0;
+  llBodiesAllocated = 256;
+  llBodies = utNewA(llFunctionBody, llBodiesAllocated);
+  llBodyBuckets = utNewA(int32, LL_NUM_FUNCTION_BUCKETS);
+  for (uint32 i = 0; i < LL_NUM_FUNCTION_BUCKETS; i++) {
+    llBodyBuckets[i] = -1;
+  }
+}
+
+// Free the table of function bodies.
+void llStopFunctionSharing(void) {
+  for (uint32 i = 0; i < llNumBodies; i++) {
+    utFree(llBodies[i].text);
+    utFree(llBodies[i].name);
+  }
+  utFree(llBodies);
+  utFree(llBodyBuckets);
+  llNumBodies = 0;
+  llBodiesAllocated = 0;
+}
+
+// Hash the text with FNV-1a.
+static uint32 hashText(char *text) {
+  uint32 hash = 2166136261u;
+  for (char *p = text; *p != '\0'; p++) {
+    hash = (hash ^ (uint8)*p) * 16777619u;
+  }
+  return hash;
+}
+
+// Determine if the character can be part of an LLVM identifier.
+static bool isIdentChar(char c) {
+  return isalnum((uint8)c) || c == '_' || c == '.' || c == '$' || c == '-';
+}
+
+// Return a copy of the function text without its linkage, and with references
+// to its own name replaced by @.self, so recursive functions can match.  The
+// text starts with "\ndefine <linkage> ".  The caller frees the result.
+static char *normalizeFunction(char *text, char *name) {
+  char *p = strstr(text, "define ") + sizeof("define ") - 1;
+  p = strchr(p, ' ') + 1;
+  size_t nameLen = strlen(name);
+  char *result = utNewA(char, strlen(p) + 1);
+  char *q = result;
+  while (*p != '\0') {
+    if (*p == '@' && !strncmp(p + 1, name, nameLen) && !isIdentChar(p[nameLen + 1])) {
+      strcpy(q, "@.self");
+      q += sizeof("@.self") - 1;
+      p += nameLen + 1;
+    } else {
+      *q++ = *p++;
+    }
+  }
+  *q = '\0';
+  return result;
+}
+
+// If a function identical to |text| has been seen, return its name.
+// Otherwise, remember this function under |name| and return NULL.  |text| is
+// the whole definition, and |name| is the function's escaped name.
+char *llFindIdenticalFunction(char *name, char *text) {
+  char *normalized = normalizeFunction(text, name);
+  uint32 hash = hashText(normalized);
+  uint32 bucket = hash & (LL_NUM_FUNCTION_BUCKETS - 1);
+  for (int32 i = llBodyBuckets[bucket]; i >= 0; i = llBodies[i].next) {
+    if (llBodies[i].hash == hash && !strcmp(llBodies[i].text, normalized)) {
+      utFree(normalized);
+      return llBodies[i].name;
+    }
+  }
+  if (llNumBodies == llBodiesAllocated) {
+    llBodiesAllocated <<= 1;
+    utResizeArray(llBodies, llBodiesAllocated);
+  }
+  llFunctionBody *body = llBodies + llNumBodies;
+  body->text = normalized;
+  body->name = utAllocString(name);
+  body->hash = hash;
+  body->next = llBodyBuckets[bucket];
+  llBodyBuckets[bucket] = llNumBodies;
+  llNumBodies++;
+  return NULL;
+}
@@ -0,0 +1,197 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// In-process LLVM backend.  Rather than writing a .ll file and running clang
+// on it, we hand the generated IR to LLVM through its C API, run a pass
+// pipeline, and write the object file directly.  Clang is then only used as a
+// linker driver.  This is compiled in only when RN_LLVM_C_API is defined; see
+// LLVM_CONFIG in the Makefile.
+
+#include "ll.h"
+#include "llexport.h"
+
+#include <time.h>
+
+// If true, llCompileWithLLVMAPI prints the time spent in each phase.
+bool llTimeLLVMAPI;
+
+#ifdef RN_LLVM_C_API
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/IRReader.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+// Report an LLVM error message, and free it.
+static void reportLLVMError(char *what, char *message) {
+  printf("%s: %s\n", what, message);
+  LLVMDisposeMessage(message);
+}
+
+// Create a target machine for the module's target triple.
+static LLVMTargetMachineRef createTargetMachine(LLVMModuleRef module, bool optimized) {
+  const char *triple = LLVMGetTarget(module);
+  char *defaultTriple = NULL;
+  if (*triple == '\0') {
+    defaultTriple = LLVMGetDefaultTargetTriple();
+    triple = defaultTriple;
+  }
+  LLVMTargetRef target;
+  char *message;
+  LLVMTargetMachineRef machine = NULL;
+  if (LLVMGetTargetFromTriple(triple, &target, &message)) {
+    reportLLVMError("Unable to find LLVM target", message);
+  } else {
+    LLVMCodeGenOptLevel level = optimized? LLVMCodeGenLevelAggressive : LLVMCodeGenLevelNone;
+    machine = LLVMCreateTargetMachine(target, triple, "generic", "", level,
+        LLVMRelocPIC, LLVMCodeModelDefault);
+  }
+  if (defaultTriple != NULL) {
+    LLVMDisposeMessage(defaultTriple);
+  }
+  return machine;
+}
+
+// Make every definition but main internal.  Once the runtime is linked in,
+// nothing else is referenced from outside the module, so LLVM may inline,
+// specialize, or drop any of it.
+static void internalizeModule(LLVMModuleRef module) {
+  LLVMValueRef function;
+  for (function = LLVMGetFirstFunction(module); function != NULL;
+       function = LLVMGetNextFunction(function)) {
+    size_t length;
+    const char *name = LLVMGetValueName2(function, &length);
+    if (!LLVMIsDeclaration(function) && strcmp(name, "main")) {
+      LLVMSetLinkage(function, LLVMInternalLinkage);
+      LLVMSetVisibility(function, LLVMDefaultVisibility);
+    }
+  }
+  LLVMValueRef global;
+  for (global = LLVMGetFirstGlobal(module); global != NULL; global = LLVMGetNextGlobal(global)) {
+    size_t length;
+    const char *name = LLVMGetValueName2(global, &length);
+    // Leave special globals like llvm.used and llvm.global_ctors alone.
+    if (!LLVMIsDeclaration(global) && strncmp(name, "llvm.", 5)) {
+      LLVMSetLinkage(global, LLVMInternalLinkage);
+      LLVMSetVisibility(global, LLVMDefaultVisibility);
+    }
+  }
+}
+
+// Link the runtime bitcode in |runtimeBitcode| into |module|, and internalize
+// the result.  Return false on failure, after printing the reason.
+static bool linkRuntimeBitcode(LLVMContextRef context, LLVMModuleRef module,
+    char *runtimeBitcode) {
+  LLVMMemoryBufferRef buffer;
+  char *message;
+  if (LLVMCreateMemoryBufferWithContentsOfFile(runtimeBitcode, &buffer, &message)) {
+    reportLLVMError("Unable to read runtime bitcode", message);
+    return false;
+  }
+  LLVMModuleRef runtime;
+  bool failed = LLVMParseBitcodeInContext2(context, buffer, &runtime);
+  LLVMDisposeMemoryBuffer(buffer);
+  if (failed) {
+    printf("Unable to parse runtime bitcode %s\n", runtimeBitcode);
+    return false;
+  }
+  // This destroys the runtime module.
+  if (LLVMLinkModules2(module, runtime)) {
+    printf("Unable to link runtime bitcode %s\n", runtimeBitcode);
+    return false;
+  }
+  internalizeModule(module);
+  return true;
+}
+
+// Return the CPU seconds since |start|.
+static double secondsSince(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Compile the LLVM IR in |text| to |objectFileName|, running the |passes|
+// pipeline, in the syntax of opt -passes.  |text| must be '\0' terminated.
+// If |runtimeBitcode| is not NULL, link it in before running passes, so the
+// runtime is optimized together with the program.  Return false on failure,
+// after printing the reason.
+bool llCompileWithLLVMAPI(char *text, size_t length, char *moduleName,
+    char *objectFileName, char *passes, bool optimized, char *runtimeBitcode) {
+  LLVMInitializeNativeTarget();
+  LLVMInitializeNativeAsmPrinter();
+  LLVMContextRef context = LLVMContextCreate();
+  LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(
+      text, length, moduleName, true);
+  LLVMModuleRef module;
+  char *message;
+  bool passed = false;
+  double parseTime, linkTime, passTime, emitTime;
+  clock_t start = clock();
+  // LLVMParseIRInContext takes ownership of the buffer.
+  if (LLVMParseIRInContext(context, buffer, &module, &message)) {
+    reportLLVMError("Unable to parse generated LLVM IR", message);
+    LLVMContextDispose(context);
+    return false;
+  }
+  parseTime = secondsSince(start);
+  start = clock();
+  LLVMTargetMachineRef machine = NULL;
+  if (runtimeBitcode == NULL || linkRuntimeBitcode(context, module, runtimeBitcode)) {
+    machine = createTargetMachine(module, optimized);
+  }
+  linkTime = secondsSince(start);
+  if (machine != NULL) {
+    LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+    LLVMPassBuilderOptionsSetVerifyEach(options, deDebugMode);
+    start = clock();
+    LLVMErrorRef error = LLVMRunPasses(module, passes, machine, options);
+    passTime = secondsSince(start);
+    LLVMDisposePassBuilderOptions(options);
+    start = clock();
+    if (error != NULL) {
+      char *errorMessage = LLVMGetErrorMessage(error);
+      printf("Unable to run LLVM passes: %s\n", errorMessage);
+      LLVMDisposeErrorMessage(errorMessage);
+    } else if (LLVMTargetMachineEmitToFile(machine, module, objectFileName,
+        LLVMObjectFile, &message)) {
+      reportLLVMError("Unable to write object file", message);
+    } else {
+      passed = true;
+    }
+    emitTime = secondsSince(start);
+    LLVMDisposeTargetMachine(machine);
+    if (passed && llTimeLLVMAPI) {
+      printf("LLVM parse %.3fs, link %.3fs, passes %.3fs, emit %.3fs\n",
+          parseTime, linkTime, passTime, emitTime);
+    }
+  }
+  LLVMDisposeModule(module);
+  LLVMContextDispose(context);
+  return passed;
+}
+
+#else  // RN_LLVM_C_API
+
+// Rune was built without the LLVM C API.
+bool llCompileWithLLVMAPI(char *text, size_t length, char *moduleName,
+    char *objectFileName, char *passes, bool optimized, char *runtimeBitcode) {
+  printf("This rune was built without the LLVM C API.  Rebuild with LLVM_CONFIG set.\n");
+  return false;
+}
+
+#endif  // RN_LLVM_C_API
@@ -13,13 +13,22 @@
 // limitations under the License.
 
 // Generate LLVM IR assembly code.
+
+// This is required to access open_memstream.  It must come before including
+// ll.h, which includes stdio.h.
+#define _DEFAULT_SOURCE
 #include "ll.h"
 #include "runtime.h"
 #include <ctype.h>
 #include <math.h>
-#include <setjmp.h>
 
 #define LL_TMPVARS_STRING ".tmpvars."
+// By default, bigints up to 256 bits are added, subtracted, compared and
+// shifted as native LLVM integers.
+#define LL_DEFAULT_NATIVE_BIGINT_WIDTH 256
+// Case ranges with more values than this are not expanded into LLVM switch
+// cases.  Switches containing them use a chain of comparisons instead.
+#define LL_MAX_SWITCH_CASE_RANGE 256
 
 // The LLVM IR output file.
 FILE* llAsmFile;
@@ -32,6 +41,26 @@ char *llSize;
 deDatatype llSizeType;
 // Width of uint64.
 uint32 llSizeWidth;
+// Bigints up to this width use native LLVM integer operations where possible.
+// Wider bigints always call the runtime.  Set to 0 to disable.
+uint32 llNativeBigintWidth = LL_DEFAULT_NATIVE_BIGINT_WIDTH;
+// Fast-math flags for floating point instructions in every function, each
+// preceded by a space, like " contract reassoc".  Empty for strict IEEE math.
+char *llFastMathFlags = "";
+// The "target-cpu" and "target-features" function attributes, or NULL to let
+// clang choose.
+char *llTargetCpu = NULL;
+char *llTargetFeatures = NULL;
+// Replace functions identical to an earlier function with thunks.
+bool llShareIdenticalFunctions = true;
+// Report each function replaced with a thunk.
+bool llShowSharedFunctions = false;
+// Attach TBAA metadata to field and array header accesses.
+bool llEmitTBAA = true;
+// Report the bounds and null checks left in each function, and in total.
+bool llShowBoundsChecks = false;
+// Fast-math flags for the function being generated.
+static char *llCurrentFastMathFlags = "";
 // The top level rune file.
 char *llModuleName;
 // Path of the current function being generated.
@@ -57,8 +86,41 @@ static deLine llCurrentLine;
 static utSym llLimitCheckFailedLabel;
 static utSym llBoundsCheckFailedLabel;
 static utSym llPrevLabel;  // Most recently printed label: used in phi instructions.
-// This is the number of setjmp buffers that need to be popped before a return.
-static uint32 llSetjmpDepth;
+// Set while generating a loop we emitted twice, with and without bounds
+// checks.  Loops inside it are not versioned again.
+static bool llInVersionedLoop;
+// Position in the function text just after the parameter list, where we add a
+// personality once the function has a try statement.
+static uint32 llPersonalityPos;
+static bool llHasLandingPads;
+// Nesting depth of try statements being generated.  Calls in a try block
+// become invokes, so they cannot be tail calls.
+static uint32 llTryDepth;
+// The LLVM prototype of the function being generated, such as "i64(i64, i32*)",
+// or NULL for main.  Tail calls to functions with the same prototype are
+// generated as musttail calls.
+static char *llPrototype;
+// Set while generating a call which is followed directly by a return.
+static bool llInTailPosition;
+// Set when a tail call was generated.  It freed the locals, so the return
+// following it must not.
+static bool llGeneratedTailCall;
+// Set while generating a coroutine iterator.  The coroutine's token and
+// handle are values numbered llCoroId and llCoroHandle.
+static bool llInCoroutine;
+static uint32 llCoroId;
+static uint32 llCoroHandle;
+// Handles of the coroutines called by the foreach loops being generated,
+// innermost last.  Returns destroy them before leaving their loops.
+static uint32 *llCoroutineHandles;
+static uint32 llNumCoroutineHandles;
+static uint32 llCoroutineHandlesAllocated;
+// Temps holding the handles of coroutines called by foreach loops in try
+// blocks, or null when no coroutine is active.  A handle need not dominate a
+// try's landing pad, so the landing pad loads it from here to destroy it.
+static uint32 *llTryCoroutineSlots;
+static uint32 llNumTryCoroutineSlots;
+static uint32 llTryCoroutineSlotsAllocated;
 
 typedef struct {
   deDatatype datatype;
@@ -68,6 +130,7 @@ typedef struct {
   bool isDelegate;  // The next element on the stack is the instance expression.
   bool isNull;  // The next element on the stack is the instance expression.
   bool isConst;  // To indicate a copy is needed for resize or other mutation.
+  uint32 tbaaTag;  // The TBAA access tag for loads and stores through this ref, or 0.
 } llElement;
 
 // Stack of elements.
@@ -107,6 +170,53 @@ static inline bool isRefCounted(deDatatype datatype) {
       deTemplateRefCounted(deClassGetTemplate(deDatatypeGetClass(datatype)));
 }
 
+// Return the TBAA access tag for the memory |region|.  Each region is a scalar
+// type directly under the Rune root, so LLVM knows accesses to different
+// regions do not alias.  Return 0, meaning no tag, with -notbaa.
+static uint32 findTBAATag(char *region) {
+  if (!llEmitTBAA) {
+    return 0;
+  }
+  uint32 root = llCreateMetadataNode("!{!\"Rune TBAA\"}");
+  uint32 type = llCreateMetadataNode(utSprintf("!{!\"%s\", !%u, i64 0}",
+      llEscapeText(region), root));
+  return llCreateMetadataNode(utSprintf("!{!%u, !%u, i64 0}", type, type));
+}
+
+// Return the TBAA attachment for loads and stores through |element|.
+static char *tbaaInfo(llElement element) {
+  if (element.tbaaTag == 0) {
+    return "";
+  }
+  return utSprintf(", !tbaa !%u", element.tbaaTag);
+}
+
+// Return the TBAA attachment for loads of runtime_array headers.
+static char *arrayHeaderTBAAInfo(void) {
+  if (!llEmitTBAA) {
+    return "";
+  }
+  return utSprintf(", !tbaa !%u", findTBAATag("runtime_array"));
+}
+
+// Return the metadata for loads of an array's length.  Lengths are always
+// below 2^(llSizeWidth - 1), since the data must fit in the address space.
+static char *arrayLengthInfo(void) {
+  uint32 range = llCreateMetadataNode(utSprintf("!{i%s 0, i%s -%llu}",
+      llSize, llSize, 1ULL << (llSizeWidth - 1)));
+  return utSprintf("%s, !range !%u", arrayHeaderTBAAInfo(), range);
+}
+
+// Return the branch weights for a conditional branch that almost always goes
+// to its true target if |trueIsLikely|, and otherwise its false target.  We
+// mark branches to raise and panic calls unlikely, so LLVM lays them out of
+// line, away from hot loops.
+static char *branchWeightInfo(bool trueIsLikely) {
+  uint32 weights = llCreateMetadataNode(trueIsLikely?
+      "!{!\"branch_weights\", i32 2000, i32 1}" : "!{!\"branch_weights\", i32 1, i32 2000}");
+  return utSprintf(", !prof !%u", weights);
+}
+
 // Generate a location tag if in debug mode.
 static char *locationInfo(void) {
   if (!llDebugMode) {
@@ -174,6 +284,8 @@ static void unrefObject(llElement element) {
     return;
   }
   deBlock classBlock = deClassGetSubBlock(theClass);
+  // The destructor can run user code.
+  llForgetBoundsChecks();
   char *location = locationInfo();
   char* path = utSprintf("%s_unref", deGetBlockPath(classBlock, true));
   llPrintf("  call void @%s(%s %s)%s\n", llEscapeIdentifier(path),
@@ -191,6 +303,7 @@ static inline llElement createElement(deDatatype datatype, char *name, bool isRe
   element.needsFree = false;
   element.isNull = false;
   element.isConst = false;
+  element.tbaaTag = 0;
   return element;
 }
 
@@ -346,7 +459,8 @@ static llElement derefAnyElement(llElement *element) {
   deDatatype datatype = llElementGetDatatype(*element);
   char *typeString = llGetTypeString(datatype, true);
   uint32 value = printNewValue();
-  llPrintf("load %s, %s* %s\n", typeString, typeString, llElementGetName(*element));
+  llPrintf("load %s, %s* %s%s\n", typeString, typeString, llElementGetName(*element),
+      tbaaInfo(*element));
   char *name = utSprintf("%%%u", value);
   element->name = utSymCreate(name);
   element->isRef = false;
@@ -381,6 +495,7 @@ static void unrefArrayElements(llElement element, deDatatype baseType) {
 
 // Call runtime_freeArray on the variable.
 static void callFree(llElement element) {
+  llForgetBoundsChecks();
   deDatatype datatype = llElementGetDatatype(element);
   deDatatypeType type = deDatatypeGetType(datatype);
   if (type == DE_TYPE_CLASS) {
@@ -629,6 +744,7 @@ static char *getDefaultValue(deDatatype datatype) {
       return "0";
     case DE_TYPE_STRING:
     case DE_TYPE_ARRAY:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_TUPLE:
     case DE_TYPE_STRUCT:
     case DE_TYPE_MODINT:
@@ -654,7 +770,8 @@ static void initializeLocalVariable(deVariable variable) {
   if (deDatatypeContainsArray(datatype)) {
     llElement element = createElement(datatype, varName, true);
     addNeedsFreeElement(element);
-  } else if (!deVariableGenerated(variable) && isRefCounted(datatype)) {
+  } else if (!deVariableGenerated(variable) && !deVariableBorrowed(variable) &&
+      isRefCounted(datatype)) {
     llElement element = createElement(datatype, varName, true);
     addNeedsFreeElement(element);
   }
@@ -704,23 +821,43 @@ static char *findBlockVisibility(deBlock block) {
   return exported? "dso_local" : "internal";
 }
 
-// Write the function header.
+// Append |text| to llPrototype.  Types after the first get a comma.
+static void appendToPrototype(char *text) {
+  char *separator = "";
+  if (llPrototype[strlen(llPrototype) - 1] != '(' && *text != ')') {
+    separator = ", ";
+  }
+  char *prototype = utAllocString(utSprintf("%s%s%s", llPrototype, separator, text));
+  utFree(llPrototype);
+  llPrototype = prototype;
+}
+
+// Write the function header.  Coroutine iterators return their handle, and
+// write each value they yield through their first parameter.
 static void printFunctionHeader(deBlock block, deSignature signature) {
   bool first = true;
+  llInCoroutine = false;
   if (signature != deSignatureNull) {
     deDatatype returnType = deSignatureGetReturnType(signature);
     deDatatype retType = returnType;
-    bool returnsValuePassedByReference = llDatatypePassedByReference(returnType);
+    llInCoroutine = deFunctionCoroutine(deSignatureGetFunction(signature));
+    bool returnsValuePassedByReference = llInCoroutine || llDatatypePassedByReference(returnType);
     if (returnsValuePassedByReference) {
       // The first parameter will be a pointer to the returned value.
       retType = deNoneDatatypeCreate();
     }
+    char *retTypeString = llGetTypeString(retType, false);
+    if (llInCoroutine) {
+      retTypeString = "i8*";
+    }
     char *visibility = findBlockVisibility(block);
-    llPrintf("\ndefine %s %s @%s(", visibility, llGetTypeString(retType, false),
-        llEscapeIdentifier(llPath));
+    llPrintf("\ndefine %s %s @%s(", visibility, retTypeString, llEscapeIdentifier(llPath));
+    llPrototype = utAllocString(utSprintf("%s(", retTypeString));
     if (returnsValuePassedByReference) {
       first = false;
-      llPrintf("%s* %%.retVal", llGetTypeString(returnType, true));
+      llPrintf("%s* %s", llGetTypeString(returnType, true),
+          llInCoroutine? "%.yieldVal" : "%.retVal");
+      appendToPrototype(utSprintf("%s*", llGetTypeString(returnType, true)));
     }
   } else {
     llPrintf("\ndefine dso_local i32 @main(i32, i8**");
@@ -751,6 +888,9 @@ static void printFunctionHeader(deBlock block, deSignature signature) {
       }
       llPrintf("%s%s %s", llGetTypeString(datatype, true), suffix,
           llGetVariableName(variable));
+      if (llPrototype != NULL) {
+        appendToPrototype(utSprintf("%s%s", llGetTypeString(datatype, true), suffix));
+      }
       llVariableSetInitialized(variable, true);
       numParams++;
     }
@@ -758,8 +898,31 @@ static void printFunctionHeader(deBlock block, deSignature signature) {
   }
   llVarNum = 0;
   llTmpVarNum = 0;
-  llSetjmpDepth = 0;
   llPuts(")");
+  if (llPrototype != NULL) {
+    appendToPrototype(")");
+  }
+  if (llInCoroutine) {
+    // CoroSplit only splits functions marked as not yet split.
+    llPuts(" \"coroutine.presplit\"=\"0\"");
+  }
+  if (signature != deSignatureNull && deFunctionAlwaysInline(deSignatureGetFunction(signature))) {
+    // Ref and unref are a few instructions, run on most object copies.
+    llPuts(" alwaysinline");
+  }
+  if (llTargetCpu != NULL) {
+    llPrintf(" \"target-cpu\"=\"%s\"", llTargetCpu);
+  }
+  if (llTargetFeatures != NULL) {
+    llPrintf(" \"target-features\"=\"%s\"", llTargetFeatures);
+  }
+  llCurrentFastMathFlags = llFastMathFlags;
+  if (signature != deSignatureNull && deFunctionFastMath(deSignatureGetFunction(signature))) {
+    llCurrentFastMathFlags = " fast";
+  }
+  llPersonalityPos = deStringPos;
+  llHasLandingPads = false;
+  llGeneratedTailCall = false;
   llPrevLabel = utSymCreate("0");
   if (llDebugMode) {
     llTag tag = llBlockGetTag(block);
@@ -862,15 +1025,34 @@ static deDatatype getElementType(deDatatype arrayDatatype) {
   return deDatatypeGetElementType(arrayDatatype);
 }
 
-// Load the array.data pointer, and cast it to a |datatype| pointer.
-static llElement loadArrayDataPointer(llElement array) {
+// Load the array's length, and return its value number.
+static uint32 loadArrayLength(llElement array) {
+  uint32 lenPtr = printNewValue();
+  llPrintf("getelementptr inbounds %%struct.runtime_array, %%struct.runtime_array* %s, i32 0, i32 1\n",
+      llElementGetName(array));
+  uint32 lenValue = printNewValue();
+  llPrintf("load i%s, i%s* %%%u%s%s\n", llSize, llSize, lenPtr, arrayLengthInfo(), locationInfo());
+  return lenValue;
+}
+
+// Load the array.data pointer, and cast it to a |datatype| pointer.  If
+// |nonEmpty|, the caller knows the array has an element, so the pointer is
+// non-null and at least one word behind it is dereferenceable.
+static llElement loadArrayDataPointer(llElement array, bool nonEmpty) {
   deDatatype elementDatatype = getElementType(llElementGetDatatype(array));
   uint32 dataPtrAddress = printNewValue();
   llPrintf(
       "getelementptr inbounds %%struct.runtime_array, %%struct.runtime_array* %s, i32 0, i32 0\n",
       llElementGetName(array));
+  char *pointerInfo = "";
+  if (nonEmpty) {
+    uint32 nonnull = llCreateMetadataNode("!{}");
+    uint32 dereferenceable = llCreateMetadataNode(utSprintf("!{i64 %u}", llSizeWidth / 8));
+    pointerInfo = utSprintf(", !nonnull !%u, !dereferenceable !%u", nonnull, dereferenceable);
+  }
   uint32 dataPtr = printNewValue();
-  llPrintf("load i%s*, i%s** %%%u%s\n", llSize, llSize, dataPtrAddress, locationInfo());
+  llPrintf("load i%s*, i%s** %%%u%s%s%s\n", llSize, llSize, dataPtrAddress,
+      arrayHeaderTBAAInfo(), pointerInfo, locationInfo());
   char *type = llGetTypeString(elementDatatype, true);
   uint32 castDataPtr = printNewValue();
   llPrintf("bitcast i%s* %%%u to %s*\n", llSize, dataPtr, type);
@@ -905,12 +1087,14 @@ static char *findSmallnumModularFunctionName(deExpression expression) {
   return NULL; // Dummy return.
 }
 
-// Return the function name for emulating the bigint modular operation.
+// Return the function name for emulating the bigint modular operation.  Use the
+// faster variable time functions when the result is not secret.
 static char *findBigintModularFunctionName(deExpression expression) {
+  bool secret = deDatatypeSecret(deExpressionGetDatatype(expression));
   switch (deExpressionGetType(expression)) {
     case DE_EXPR_ADD: return "runtime_bigintModularAdd";
     case DE_EXPR_SUB: return "runtime_bigintModularSub";
-    case DE_EXPR_MUL: return "runtime_bigintModularMul";
+    case DE_EXPR_MUL: return secret? "runtime_bigintModularMul" : "runtime_bigintModularMulVartime";
     case DE_EXPR_DIV: return "runtime_bigintModularDiv";
     case DE_EXPR_EXP: return "runtime_bigintModularExp";
     case DE_EXPR_NEGATE: return "runtime_bigintModularNegate";
@@ -920,6 +1104,35 @@ static char *findBigintModularFunctionName(deExpression expression) {
   return NULL; // Dummy return.
 }
 
+// Return the variable time runtime function for a non-secret bigint expression,
+// or NULL if there is none, in which case the constant time function is used.
+static char *findVartimeBigintFunction(deExpression expression) {
+  switch (deExpressionGetType(expression)) {
+    case DE_EXPR_MUL: return "runtime_bigintMulVartime";
+    case DE_EXPR_MULTRUNC: return deUnsafeMode? "runtime_bigintMulVartime" : "runtime_bigintMulTruncVartime";
+    case DE_EXPR_DIV: return "runtime_bigintDivVartime";
+    case DE_EXPR_MOD: return "runtime_bigintModVartime";
+    case DE_EXPR_EXP: return "runtime_bigintExpVartime";
+    default:
+      return NULL;
+  }
+}
+
+// Return the subquadratic constant time multiply function for wide secret
+// bigints, or NULL if the width is below the Karatsuba threshold.  The width is
+// a static type, so we choose the algorithm here rather than at runtime.
+static char *findWideMulFunction(deExpression expression) {
+  uint32 width = deDatatypeGetWidth(deExpressionGetDatatype(expression));
+  bool truncate = deExpressionGetType(expression) == DE_EXPR_MULTRUNC && !deUnsafeMode;
+  if (width >= RN_TOOM3_MIN_WIDTH) {
+    return truncate? "runtime_bigintMulTruncToom3" : "runtime_bigintMulToom3";
+  }
+  if (width >= RN_KARATSUBA_MIN_WIDTH) {
+    return truncate? "runtime_bigintMulTruncKaratsuba" : "runtime_bigintMulKaratsuba";
+  }
+  return NULL;
+}
+
 // Return the runtime function name that can execute this expression.
 static char *findExpressionFunction(deExpression expression) {
   deDatatype datatype = deExpressionGetDatatype(expression);
@@ -932,6 +1145,18 @@ static char *findExpressionFunction(deExpression expression) {
   if (!llDatatypeIsBigint(datatype)) {
     return findSmallnumFunction(expression);
   }
+  if (!deDatatypeSecret(datatype)) {
+    char *funcName = findVartimeBigintFunction(expression);
+    if (funcName != NULL) {
+      return funcName;
+    }
+  } else if (deExpressionGetType(expression) == DE_EXPR_MUL ||
+      deExpressionGetType(expression) == DE_EXPR_MULTRUNC) {
+    char *funcName = findWideMulFunction(expression);
+    if (funcName != NULL) {
+      return funcName;
+    }
+  }
   switch (deExpressionGetType(expression)) {
     case DE_EXPR_ADD: return "runtime_bigintAdd";
     case DE_EXPR_ADDTRUNC: return deUnsafeMode? "runtime_bigintAdd" : "runtime_bigintAddTrunc";
@@ -989,8 +1214,123 @@ static runtime_comparisonType findBigintComparisonType(deExpression expression)
   return RN_LT;  // Dummy return;
 }
 
+// Return true if operations on bigints of this type can be lowered to native
+// LLVM integers rather than calls into the runtime.  Modular integers always
+// call the runtime.
+static bool isNativeBigint(deDatatype datatype) {
+  return llDatatypeIsBigint(datatype) && deDatatypeGetType(datatype) != DE_TYPE_MODINT &&
+      deDatatypeGetWidth(datatype) <= llNativeBigintWidth;
+}
+
+// Return the number of 31-bit CTTK limbs in a bigint of this type.
+static uint32 findBigintNumLimbs(deDatatype datatype) {
+  bool isSigned = deDatatypeGetType(datatype) == DE_TYPE_INT;
+  return llBigintBitsToWords(deDatatypeGetWidth(datatype), isSigned) - 2;
+}
+
+// Load a CTTK bigint into a native LLVM integer of the bigint's width, and
+// return its value number.  Limbs hold 31 bits each, and the top limb is sign
+// extended, so we assemble an integer of 31*numLimbs bits and truncate it.
+static uint32 loadNativeBigint(llElement bigint) {
+  deDatatype datatype = llElementGetDatatype(bigint);
+  uint32 width = deDatatypeGetWidth(datatype);
+  uint32 numLimbs = findBigintNumLimbs(datatype);
+  uint32 limbsWidth = 31 * numLimbs;
+  llElement data = loadArrayDataPointer(bigint, true);
+  uint32 accum = 0;
+  for (uint32 i = 0; i < numLimbs; i++) {
+    uint32 limbPtr = printNewValue();
+    llPrintf("getelementptr inbounds i32, i32* %s, i32 %u\n", llElementGetName(data), i + 2);
+    uint32 limb = printNewValue();
+    llPrintf("load i32, i32* %%%u\n", limbPtr);
+    uint32 extLimb = printNewValue();
+    llPrintf("zext i32 %%%u to i%u\n", limb, limbsWidth);
+    uint32 shiftedLimb = printNewValue();
+    llPrintf("shl i%u %%%u, %u\n", limbsWidth, extLimb, 31 * i);
+    if (i != 0) {
+      uint32 sum = printNewValue();
+      llPrintf("or i%u %%%u, %%%u\n", limbsWidth, accum, shiftedLimb);
+      accum = sum;
+    } else {
+      accum = shiftedLimb;
+    }
+  }
+  if (limbsWidth == width) {
+    return accum;
+  }
+  uint32 value = printNewValue();
+  llPrintf("trunc i%u %%%u to i%u\n", limbsWidth, accum, width);
+  return value;
+}
+
+// Store a native LLVM integer into a new temporary bigint of type |datatype|,
+// and leave the temporary on the stack.  The CTTK header encodes a bit length
+// n as n + n/31, where unsigned values have one hidden extra bit.
+static void storeNativeBigint(deDatatype datatype, uint32 value) {
+  uint32 width = deDatatypeGetWidth(datatype);
+  bool isSigned = deDatatypeGetType(datatype) == DE_TYPE_INT;
+  uint32 numLimbs = findBigintNumLimbs(datatype);
+  uint32 limbsWidth = 31 * numLimbs;
+  llElement dest = allocateTempValue(datatype);
+  llDeclareRuntimeFunction("runtime_allocArray");
+  llPrintf("  call void @runtime_allocArray(%%struct.runtime_array* %s, i%s %u, i%s 4, "
+      "i1 zeroext false)%s\n", llElementGetName(dest), llSize, numLimbs + 2, llSize,
+      locationInfo());
+  llElement data = loadArrayDataPointer(dest, true);
+  uint32 flags = (isSigned? RN_SIGNED_BIT : 0) | (deDatatypeSecret(datatype)? RN_SECRET_BIT : 0);
+  uint32 cttkWidth = isSigned? width : width + 1;
+  llPrintf("  store i32 %u, i32* %s\n", flags, llElementGetName(data));
+  uint32 headerPtr = printNewValue();
+  llPrintf("getelementptr inbounds i32, i32* %s, i32 1\n", llElementGetName(data));
+  llPrintf("  store i32 %u, i32* %%%u\n", cttkWidth + cttkWidth / 31, headerPtr);
+  if (limbsWidth != width) {
+    uint32 extValue = printNewValue();
+    llPrintf("%s i%u %%%u to i%u\n", isSigned? "sext" : "zext", width, value, limbsWidth);
+    value = extValue;
+  }
+  for (uint32 i = 0; i < numLimbs; i++) {
+    uint32 shiftedValue = printNewValue();
+    llPrintf("lshr i%u %%%u, %u\n", limbsWidth, value, 31 * i);
+    uint32 truncValue = printNewValue();
+    llPrintf("trunc i%u %%%u to i32\n", limbsWidth, shiftedValue);
+    uint32 limb = printNewValue();
+    llPrintf("and i32 %%%u, 2147483647\n", truncValue);
+    uint32 limbPtr = printNewValue();
+    llPrintf("getelementptr inbounds i32, i32* %s, i32 %u\n", llElementGetName(data), i + 2);
+    llPrintf("  store i32 %%%u, i32* %%%u\n", limb, limbPtr);
+  }
+}
+
+// Return true if this bigint expression can be computed on native LLVM
+// integers.  Native add, subtract, and bitwise operations have no data
+// dependent branches, so they remain constant time for secrets.
+static bool isNativeBigintExpression(deExpression expression) {
+  if (!isNativeBigint(deExpressionGetDatatype(expression))) {
+    return false;
+  }
+  switch (deExpressionGetType(expression)) {
+    case DE_EXPR_ADD:
+    case DE_EXPR_ADDTRUNC:
+    case DE_EXPR_SUB:
+    case DE_EXPR_SUBTRUNC:
+    case DE_EXPR_BITAND:
+    case DE_EXPR_BITOR:
+    case DE_EXPR_BITXOR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Forward reference, since this uses the overflow checking code below.
+static void generateNativeBigintBinaryExpression(deExpression expression);
+
 // Generate code for a binary expression.
 static void generateBigintBinaryExpression(deExpression expression) {
+  if (isNativeBigintExpression(expression)) {
+    generateNativeBigintBinaryExpression(expression);
+    return;
+  }
   char *funcName = findExpressionFunction(expression);
   deExpression left = deExpressionGetFirstExpression(expression);
   deExpression right = deExpressionGetNextExpression(left);
@@ -1073,6 +1413,7 @@ static llElement findDatatypeSize(deDatatype datatype) {
       return findDatatypeSize(deUintDatatypeCreate(deDatatypeGetWidth(elementType)));
     }
     case DE_TYPE_TUPLE:
+    case DE_TYPE_FIXEDARRAY:
       return findTupleSize(datatype);
     case DE_TYPE_STRUCT:
       return findTupleSize(deGetStructTupleDatatype(datatype));
@@ -1283,6 +1624,7 @@ static void evaluateIndirectCallParameters(deExpression parameters) {
 
 // Generate a call to an overloaded operator function.
 static void generateOperatorOverloadCall(deExpression expression, deSignature signature) {
+  llForgetBoundsChecks();
   deDatatype returnType = deExpressionGetDatatype(expression);
   llElement returnElement;
   uint32 savedStackPos = llStackPos;
@@ -1323,8 +1665,9 @@ static void generateOperatorOverloadCall(deExpression expression, deSignature si
 static void generateBasicBinaryOp(char *op, llElement leftElement, llElement rightElement) {
   deDatatype datatype = llElementGetDatatype(leftElement);
   char *type = llGetTypeString(datatype, false);
+  char *flags = deDatatypeIsFloat(datatype)? llCurrentFastMathFlags : "";
   uint32 value = printNewValue();
-  llPrintf("%s %s %s, %s%s\n", op, type,
+  llPrintf("%s%s %s %s, %s%s\n", op, flags, type,
       llElementGetName(leftElement), llElementGetName(rightElement),
       locationInfo());
   pushValue(datatype, value, false);
@@ -1384,10 +1727,76 @@ static void printLabel(utSym label) {
   if (label != utSymNull) {
     llPrintf("%s:\n", utSymGetName(label));
     llPrevLabel = label;
+    llForgetBoundsChecks();
   }
   freeElements(false);
 }
 
+// Generate a bigint add, subtract, or bitwise operation on native LLVM
+// integers.  Checked add and subtract raise an overflow exception, like the
+// smallnum code, and the truncating versions wrap.
+static void generateNativeBigintBinaryExpression(deExpression expression) {
+  deDatatype datatype = deExpressionGetDatatype(expression);
+  uint32 width = deDatatypeGetWidth(datatype);
+  deExpression left = deExpressionGetFirstExpression(expression);
+  deExpression right = deExpressionGetNextExpression(left);
+  generateExpression(left);
+  llElement leftElement = popElement(true);
+  generateExpression(right);
+  llElement rightElement = popElement(true);
+  uint32 leftValue = loadNativeBigint(leftElement);
+  uint32 rightValue = loadNativeBigint(rightElement);
+  deExpressionType type = deExpressionGetType(expression);
+  if (deUnsafeMode || (type != DE_EXPR_ADD && type != DE_EXPR_SUB)) {
+    char *op = NULL;
+    switch (type) {
+      case DE_EXPR_ADD:
+      case DE_EXPR_ADDTRUNC:
+        op = "add";
+        break;
+      case DE_EXPR_SUB:
+      case DE_EXPR_SUBTRUNC:
+        op = "sub";
+        break;
+      case DE_EXPR_BITAND:
+        op = "and";
+        break;
+      case DE_EXPR_BITOR:
+        op = "or";
+        break;
+      case DE_EXPR_BITXOR:
+        op = "xor";
+        break;
+      default:
+        utExit("Unexpected native bigint expression type");
+    }
+    uint32 value = printNewValue();
+    llPrintf("%s i%u %%%u, %%%u%s\n", op, width, leftValue, rightValue, locationInfo());
+    storeNativeBigint(datatype, value);
+    return;
+  }
+  char *opType = findTruncatingOpName(expression);
+  llDeclareOverloadedFunction(utSprintf(
+      "declare {i%u, i1} @llvm.%s.with.overflow.i%u(i%u, i%u)\n",
+      width, opType, width, width, width));
+  uint32 structValue = printNewValue();
+  llPrintf("call {i%u, i1} @llvm.%s.with.overflow.i%u(i%u %%%u, i%u %%%u)%s\n",
+      width, opType, width, width, leftValue, width, rightValue, locationInfo());
+  uint32 resValue = printNewValue();
+  llPrintf("extractvalue {i%u, i1} %%%u, 0\n", width, structValue);
+  uint32 overflowValue = printNewValue();
+  llPrintf("extractvalue {i%u, i1} %%%u, 1\n", width, structValue);
+  utSym passed = newLabel("overflowCheckPassed");
+  utSym failed = newLabel("overflowCheckFailed");
+  llPrintf("  br i1 %%%u, label %%%s, label %%%s%s\n",
+      overflowValue, utSymGetName(failed), utSymGetName(passed), branchWeightInfo(false));
+  printLabel(failed);
+  llDeclareRuntimeFunction("runtime_raiseOverflow");
+  llPrintf("  call void @runtime_raiseOverflow()\n  unreachable\n");
+  printLabel(passed);
+  storeNativeBigint(datatype, resValue);
+}
+
 // Generate code for a binary expression which can raise an overflow exception.
 static void generateBinaryExpressionWithOverflow(deExpression expression) {
   deSignature signature = deExpressionGetSignature(expression);
@@ -1423,8 +1832,8 @@ static void generateBinaryExpressionWithOverflow(deExpression expression) {
   llPrintf("extractvalue {i%u, i1} %%%u, 1\n", width, structValue);
   utSym passed = newLabel("overflowCheckPassed");
   utSym failed = newLabel("overflowCheckFailed");
-  llPrintf("  br i1 %%%u, label %%%s, label %%%s\n",
-      overflowValue, utSymGetName(failed), utSymGetName(passed));
+  llPrintf("  br i1 %%%u, label %%%s, label %%%s%s\n",
+      overflowValue, utSymGetName(failed), utSymGetName(passed), branchWeightInfo(false));
   printLabel(failed);
   llDeclareRuntimeFunction("runtime_raiseOverflow");
   llPrintf("  call void @runtime_raiseOverflow()\n  unreachable\n");
@@ -1484,11 +1893,33 @@ static void generateBigintComparison(llElement left, llElement right,
   pushValue(deBoolDatatypeCreate(), value, false);
 }
 
+// Forward reference for finding the comparison instruction.
+static char *findBasicComparisonInstruction(deDatatype datatype, runtime_comparisonType type);
+
+// Generate a bigint comparison on native LLVM integers.  LLVM lowers wide
+// integer comparisons to branch-free borrow chains, so this remains constant
+// time for secrets.
+static void generateNativeBigintComparison(llElement left, llElement right,
+    runtime_comparisonType compareType) {
+  deDatatype datatype = llElementGetDatatype(left);
+  uint32 width = deDatatypeGetWidth(datatype);
+  uint32 leftValue = loadNativeBigint(left);
+  uint32 rightValue = loadNativeBigint(right);
+  char *instruction = findBasicComparisonInstruction(datatype, compareType);
+  uint32 value = printNewValue();
+  llPrintf("%s i%u %%%u, %%%u%s\n", instruction, width, leftValue, rightValue, locationInfo());
+  pushValue(deBoolDatatypeCreate(), value, false);
+}
+
 // Generate code to compare two arrays.
 static void generateArrayComparison(llElement left, llElement right, runtime_comparisonType compareType) {
   deDatatype datatype = llElementGetDatatype(left);
   if (deDatatypeIsInteger(datatype)) {
-    generateBigintComparison(left, right, compareType);
+    if (isNativeBigint(datatype)) {
+      generateNativeBigintComparison(left, right, compareType);
+    } else {
+      generateBigintComparison(left, right, compareType);
+    }
     return;
   }
   deDatatype primDatatype = findPrimitiveDatatype(datatype);
@@ -1617,8 +2048,11 @@ static void generateBasicComparison(llElement left, llElement right, runtime_com
   char *typeString = llGetTypeString(datatype, false);
   uint32 value = printNewValue();
   char *instruction = findBasicComparisonInstruction(datatype, type);
-  llPrintf("%s %s %s, %s%s\n", instruction, typeString,
-      llElementGetName(left), llElementGetName(right), locationInfo());
+  char *flags = deDatatypeIsFloat(datatype)? llCurrentFastMathFlags : "";
+  // Fast-math flags go between the opcode and the predicate, as in "fcmp fast olt".
+  char *predicate = strchr(instruction, ' ') + 1;
+  llPrintf("%.*s%s %s %s %s, %s%s\n", (int)(predicate - instruction - 1), instruction, flags,
+      predicate, typeString, llElementGetName(left), llElementGetName(right), locationInfo());
   pushValue(retDatatype, value, false);
 }
 
@@ -1686,8 +2120,8 @@ static void checkTruncation(llElement element, llElement result,
   llElement condition = popElement(true);
   utSym passedLabel = newLabel("truncCheckPassed");
   utSym failedLabel = newLabel("truncCheckFailed");
-  llPrintf("  br i1 %s, label %%%s, label %%%s\n",
-      llElementGetName(condition), utSymGetName(passedLabel), utSymGetName(failedLabel));
+  llPrintf("  br i1 %s, label %%%s, label %%%s%s\n", llElementGetName(condition),
+      utSymGetName(passedLabel), utSymGetName(failedLabel), branchWeightInfo(true));
   printLabel(failedLabel);
   llDeclareRuntimeFunction("runtime_raiseOverflow");
   llPuts("  call void @runtime_raiseOverflow()\n  unreachable\n");
@@ -1808,6 +2242,23 @@ static llElement generateString(deString text) {
   return element;
 }
 
+// Replace the fixed-size array on top of the stack with a temporary dynamic
+// array holding a copy of its elements, so the runtime can print it.
+static void convertFixedArrayToArray(void) {
+  llElement fixedArray = popElement(false);
+  deDatatype datatype = llElementGetDatatype(fixedArray);
+  deDatatype elementType = deDatatypeGetElementType(datatype);
+  llElement elementSize = findDatatypeSize(elementType);
+  uint32 data = printNewValue();
+  llPrintf("bitcast %s* %s to i8*\n", llGetTypeString(datatype, true),
+      llElementGetName(fixedArray));
+  llElement array = allocateTempArray(deArrayDatatypeCreate(elementType));
+  llDeclareRuntimeFunction("runtime_initArrayFromData");
+  llPrintf("  call void @runtime_initArrayFromData(%%struct.runtime_array* %s, i8* %%%u, "
+      "i%s %u, i%s %s)%s\n", llElementGetName(array), data, llSize,
+      deDatatypeGetWidth(datatype), llSize, llElementGetName(elementSize), locationInfo());
+}
+
 // Push the variable arguments for the format onto he element stack.  Return the number of
 // elements pushed.
 static uint32 evalFormatParams(llElement format, deExpression argument, bool skipStrings) {
@@ -1823,6 +2274,9 @@ static uint32 evalFormatParams(llElement format, deExpression argument, bool ski
     if (!skipStrings || deExpressionGetType(argument) != DE_EXPR_STRING) {
       if (!deExpressionIsType(argument)) {
         generateExpression(argument);
+        if (deDatatypeGetType(datatype) == DE_TYPE_FIXEDARRAY) {
+          convertFixedArrayToArray();
+        }
         llElement *elementPtr = topOfStack();
         derefElement(elementPtr);
         if (deDatatypeIsInteger(datatype) && deDatatypeGetWidth(datatype) < llSizeWidth) {
@@ -1894,11 +2348,133 @@ static void generateSelect(llElement selectElement, llElement data1Element, llEl
   pushValue(datatype, value, false);
 }
 
-// Generate a select expression.
-// TODO: This does not protect the privacy of the select bit!  Write code to
-// generate a secure select when select is secret.
+// Return the width of the native LLVM type if values of the type can be
+// selected with a mask: integers and floats of up to 64 bits.  Otherwise,
+// return 0.
+static uint32 findMaskableWidth(char *type) {
+  if (!strcmp(type, "float")) {
+    return 32;
+  }
+  if (!strcmp(type, "double")) {
+    return 64;
+  }
+  if (type[0] != 'i' || strchr(type, '*') != NULL) {
+    return 0;
+  }
+  uint32 width = atoi(type + 1);
+  return width <= 64? width : 0;
+}
+
+// Convert the native scalar value to an integer of |maskWidth| bits.  Return
+// the name of the integer.
+static char *widenForMask(llElement element, char *type, uint32 width, uint32 maskWidth) {
+  char *name = llElementGetName(element);
+  if (type[0] != 'i') {
+    uint32 value = printNewValue();
+    llPrintf("bitcast %s %s to i%u\n", type, name, width);
+    name = utSprintf("%%%u", value);
+  }
+  if (width < maskWidth) {
+    uint32 value = printNewValue();
+    llPrintf("zext i%u %s to i%u\n", width, name, maskWidth);
+    name = utSprintf("%%%u", value);
+  }
+  return utAllocString(name);
+}
+
+// Generate a constant-time select for a secret select bit.  Compute
+// data0 ^ (mask & (data1 ^ data0)) where mask is all ones if the select bit is
+// set.  The mask passes through an empty inline asm statement, so LLVM cannot
+// see it came from a bool and turn the select back into a branch.  Values
+// which are not native scalars, like arrays and tuples, are selected by
+// pointer.
+static void generateMaskedSelect(llElement selectElement, llElement data1Element,
+    llElement data0Element) {
+  deDatatype datatype = llElementGetDatatype(data1Element);
+  char *type = llGetTypeString(datatype, false);
+  uint32 width = findMaskableWidth(type);
+  if (width == 0) {
+    generateSelect(selectElement, data1Element, data0Element);
+    return;
+  }
+  uint32 maskWidth = width <= 32? 32 : 64;
+  char *data1 = widenForMask(data1Element, type, width, maskWidth);
+  char *data0 = widenForMask(data0Element, type, width, maskWidth);
+  uint32 mask = printNewValue();
+  llPrintf("sext i1 %s to i%u\n", llElementGetName(selectElement), maskWidth);
+  uint32 hiddenMask = printNewValue();
+  llPrintf("call i%u asm \"\", \"=r,0\"(i%u %%%u)\n", maskWidth, maskWidth, mask);
+  uint32 diff = printNewValue();
+  llPrintf("xor i%u %s, %s\n", maskWidth, data1, data0);
+  uint32 masked = printNewValue();
+  llPrintf("and i%u %%%u, %%%u\n", maskWidth, diff, hiddenMask);
+  uint32 value = printNewValue();
+  llPrintf("xor i%u %%%u, %s\n", maskWidth, masked, data0);
+  utFree(data1);
+  utFree(data0);
+  if (width < maskWidth) {
+    uint32 truncValue = printNewValue();
+    llPrintf("trunc i%u %%%u to i%u\n", maskWidth, value, width);
+    value = truncValue;
+  }
+  if (type[0] != 'i') {
+    uint32 castValue = printNewValue();
+    llPrintf("bitcast i%u %%%u to %s\n", width, value, type);
+    value = castValue;
+  }
+  pushValue(datatype, value, false);
+}
+
+// Generate a select expression with a public select bit.  Like C's ?:
+// operator, only the selected data expression is evaluated, and a phi
+// instruction merges the results.  Temporary values created in either branch
+// are freed at the end of the statement, as usual.  Temporaries are zero
+// initialized, so freeing those of the branch not taken does nothing.
+static void generateBranchingSelect(deExpression expression) {
+  deExpression select = deExpressionGetFirstExpression(expression);
+  deExpression data1 = deExpressionGetNextExpression(select);
+  deExpression data0 = deExpressionGetNextExpression(data1);
+  generateExpression(select);
+  llElement selectElement = popElement(true);
+  utSym data1Label = newLabel("selectData1");
+  utSym data0Label = newLabel("selectData0");
+  utSym doneLabel = newLabel("selectDone");
+  llPrintf("  br i1 %s, label %%%s, label %%%s%s\n", llElementGetName(selectElement),
+      utSymGetName(data1Label), utSymGetName(data0Label), locationInfo());
+  llPrintf("%s:\n", utSymGetName(data1Label));
+  llPrevLabel = data1Label;
+  generateExpression(data1);
+  llElement data1Element = popElement(true);
+  utSym data1EndLabel = llPrevLabel;
+  llPrintf("  br label %%%s\n", utSymGetName(doneLabel));
+  // Bounds checks done only when data1 was selected do not hold here.
+  llPrintf("%s:\n", utSymGetName(data0Label));
+  llPrevLabel = data0Label;
+  llForgetBoundsChecks();
+  generateExpression(data0);
+  llElement data0Element = popElement(true);
+  utSym data0EndLabel = llPrevLabel;
+  llPrintf("  br label %%%s\n", utSymGetName(doneLabel));
+  llPrintf("%s:\n", utSymGetName(doneLabel));
+  llForgetBoundsChecks();
+  deDatatype datatype = llElementGetDatatype(data1Element);
+  uint32 value = printNewValue();
+  llPrintf("phi %s [%s, %%%s], [%s, %%%s]\n", llGetTypeString(datatype, false),
+      llElementGetName(data1Element), utSymGetName(data1EndLabel),
+      llElementGetName(data0Element), utSymGetName(data0EndLabel));
+  pushValue(datatype, value, false);
+  llPrevLabel = doneLabel;
+}
+
+// Generate a select expression.  If the select bit is secret, evaluate both
+// data expressions and select between them in constant time.  Otherwise,
+// evaluate only the selected one.
 static void generateSelectExpression(deExpression expression) {
   deExpression select = deExpressionGetFirstExpression(expression);
+  if (!deDatatypeSecret(deExpressionGetDatatype(select))) {
+    generateBranchingSelect(expression);
+    return;
+  }
   deExpression data1 = deExpressionGetNextExpression(select);
   deExpression data0 = deExpressionGetNextExpression(data1);
   generateExpression(select);
@@ -1907,15 +2483,87 @@ static void generateSelectExpression(deExpression expression) {
   llElement data0Element = popElement(true);
   llElement data1Element = popElement(true);
   llElement selectElement = popElement(true);
-  generateSelect(selectElement, data1Element, data0Element);
+  generateMaskedSelect(selectElement, data1Element, data0Element);
+}
+
+// Return true if the string or array computed by |expression| is only read by
+// its parent, so it never escapes the statement.  This is the case for
+// operands of concatenation and comparison, and for print and format
+// arguments.  Anything passed to a function, assigned, or stored in a tuple
+// escapes.
+static bool tempDoesNotEscape(deExpression expression) {
+  deExpression parent = deExpressionGetExpression(expression);
+  if (parent == deExpressionNull || deExpressionGetSignature(parent) != deSignatureNull) {
+    return false;
+  }
+  deDatatypeType parentType = deDatatypeGetType(deExpressionGetDatatype(parent));
+  switch (deExpressionGetType(parent)) {
+    case DE_EXPR_ADD:
+      return parentType == DE_TYPE_STRING || parentType == DE_TYPE_ARRAY;
+    case DE_EXPR_LT:
+    case DE_EXPR_LE:
+    case DE_EXPR_GT:
+    case DE_EXPR_GE:
+    case DE_EXPR_EQUAL:
+    case DE_EXPR_NOTEQUAL:
+      return true;
+    case DE_EXPR_MOD:
+      return parentType == DE_TYPE_STRING;
+    case DE_EXPR_TUPLE: {
+      // The tuple of arguments of a format expression is never built.
+      deExpression format = deExpressionGetExpression(parent);
+      return format != deExpressionNull && deExpressionGetType(format) == DE_EXPR_MOD &&
+          deExpressionGetSignature(format) == deSignatureNull &&
+          deDatatypeGetType(deExpressionGetDatatype(format)) == DE_TYPE_STRING;
+    }
+    case DE_EXPR_LIST: {
+      deStatement statement = deExpressionGetStatement(parent);
+      return statement != deStatementNull && deStatementGetType(statement) == DE_STATEMENT_PRINT;
+    }
+    default:
+      return false;
+  }
+}
+
+// Allocate a temporary string of at most |maxLength| bytes, leaving it on the
+// stack, and a stack buffer to hold it.  The buffer has room for the largest
+// array header the runtime uses.  The string is not freed at the end of the
+// statement.  Set |bufferWords| to the size of the buffer, and |bufferPtr| to
+// the value pointing to it.
+static llElement allocateStackString(uint32 maxLength, uint32 *bufferWords, uint32 *bufferPtr) {
+  uint32 wordBytes = llSizeWidth / 8;
+  *bufferWords = 4 + (maxLength + wordBytes - 1) / wordBytes;
+  uint32 buffer = printNewTmpValue();
+  llTmpPrintf("alloca [%u x i%s]\n", *bufferWords, llSize);
+  *bufferPtr = printNewValue();
+  llPrintf("getelementptr inbounds [%u x i%s], [%u x i%s]* %%.tmp%u, i32 0, i32 0\n",
+      *bufferWords, llSize, *bufferWords, llSize, buffer);
+  llElement result = allocateTempValue(deStringDatatypeCreate());
+  llElementSetNeedsFree(topOfStack(), false);
+  return result;
 }
 
 // Generate a call to runtime_nativeIntToString or runtime_bigintToString, depending
-// on the representation of the integer.
-static void generateIntegerToString(llElement value, llElement base) {
+// on the representation of the integer.  If the string does not escape, a
+// native integer is converted into a stack buffer instead of the heap.
+static void generateIntegerToString(llElement value, llElement base, bool onStack) {
   deDatatype datatype = llElementGetDatatype(value);
   uint32 width = deDatatypeGetWidth(datatype);
   utAssert(llElementGetDatatype(base) == deUintDatatypeCreate(32));
+  if (width <= llSizeWidth && onStack) {
+    bool isSigned = deDatatypeGetType(datatype) == DE_TYPE_INT;
+    value = resizeSmallInteger(value, llSizeWidth, isSigned, false);
+    // The longest string is a negative 64-bit value in base 2.
+    uint32 bufferWords, bufferPtr;
+    llElement result = allocateStackString(65, &bufferWords, &bufferPtr);
+    llDeclareRuntimeFunction("runtime_nativeIntToStackString");
+    llPrintf("  call void @runtime_nativeIntToStackString(%%struct.runtime_array* %s, "
+        "i%s* %%%u, i%s %u, i%s %s, i32 %s, i1 zeroext %s)%s\n",
+        llElementGetName(result), llSize, bufferPtr, llSize, bufferWords,
+        llSize, llElementGetName(value), llElementGetName(base), boolVal(isSigned),
+        locationInfo());
+    return;
+  }
   llElement result = allocateTempValue(deStringDatatypeCreate());
   if (width <= llSizeWidth) {
     bool isSigned = deDatatypeGetType(datatype) == DE_TYPE_INT;
@@ -1972,12 +2620,7 @@ static void generateBuiltinMethod(deExpression expression) {
   switch (type) {
     case DE_BUILTINFUNC_ARRAYLENGTH:
     case DE_BUILTINFUNC_STRINGLENGTH: {
-      uint32 lenPtr = printNewValue();
-      llPrintf("getelementptr inbounds %%struct.runtime_array, %%struct.runtime_array* %s, i32 0, i32 1\n",
-          llElementGetName(access));
-      uint32 lenValue = printNewValue();
-      char *location = locationInfo();
-      llPrintf("load i%s, i%s* %%%u%s\n", llSize, llSize, lenPtr, location);
+      uint32 lenValue = loadArrayLength(access);
       pushValue(llSizeType, lenValue, false);
       break;
     }
@@ -2015,8 +2658,20 @@ static void generateBuiltinMethod(deExpression expression) {
       if (!llElementIsRef(element)) {
         element = storeElementAndReturnRef(element);
       }
-      llDeclareRuntimeFunction("runtime_appendArrayElement");
       deDatatype elementDatatype = llElementGetDatatype(element);
+      if (llDatatypeIsArray(elementDatatype) &&
+          (llElementNeedsFree(element) || deExpressionLastUse(elementExpression))) {
+        // Nothing reads the element again, so move it rather than copy it.
+        if (llElementNeedsFree(element)) {
+          removeNeedsFreeElement(element);
+        }
+        llDeclareRuntimeFunction("runtime_appendMovedArray");
+        llPrintf("  call void @runtime_appendMovedArray(%%struct.runtime_array* %s, "
+            "%%struct.runtime_array* %s)%s\n", llElementGetName(access),
+            llElementGetName(element), locationInfo());
+        break;
+      }
+      llDeclareRuntimeFunction("runtime_appendArrayElement");
       uint32 uint8Ptr = getUintPointer(element, 8);
       llElement sizeValue = findDatatypeSize(elementDatatype);
       char *location = locationInfo();
@@ -2160,7 +2815,7 @@ static void generateBuiltinMethod(deExpression expression) {
       } else {
         base = createElement(deUintDatatypeCreate(32), "10", false);
       }
-      generateIntegerToString(access, base);
+      generateIntegerToString(access, base, tempDoesNotEscape(expression));
       break;
     }
   case DE_BUILTINFUNC_ARRAYTOSTRING:
@@ -2249,8 +2904,8 @@ static void moveTupleOrObject(llElement dest, llElement source) {
       deDatatypeNullable(destType));
   char *type = llGetTypeString(datatype, true);
   char *location = locationInfo();
-  llPrintf("  store %s %s, %s* %s%s\n", type, llElementGetName(source), type,
-      llElementGetName(dest), location);
+  llPrintf("  store %s %s, %s* %s%s%s\n", type, llElementGetName(source), type,
+      llElementGetName(dest), tbaaInfo(dest), location);
   if (deDatatypeContainsArray(datatype)) {
     updateTupleArrayBackpointers(dest);
   }
@@ -2288,8 +2943,8 @@ static void moveElement(llElement dest, llElement source, bool freeDest) {
 void storeBasicType(llElement dest, llElement source) {
   utAssert(llElementIsRef(dest));
   char *type = llGetTypeString(llElementGetDatatype(source), true);
-  llPrintf("  store %s %s, %s* %s%s\n", type, llElementGetName(source), type,
-           llElementGetName(dest), locationInfo());
+  llPrintf("  store %s %s, %s* %s%s%s\n", type, llElementGetName(source), type,
+           llElementGetName(dest), tbaaInfo(dest), locationInfo());
 }
 
 // Forward reference for recursion.
@@ -2316,6 +2971,9 @@ static void copyElement(llElement access, llElement element, bool freeDest) {
     copyArray(access, element, freeDest);
   } else if (type == DE_TYPE_TUPLE || type == DE_TYPE_STRUCT) {
     copyTuple(access, element, freeDest);
+  } else if (type == DE_TYPE_FIXEDARRAY) {
+    // Fixed-size arrays only hold plain values, so a copy is a move.
+    moveTupleOrObject(access, element);
   } else if (type == DE_TYPE_CLASS) {
     derefElement(&element);
     refObject(element);
@@ -2351,10 +3009,21 @@ static bool isUnusedVariable(deExpression accessExpression) {
   return !deVariableInstantiated(var);
 }
 
+// Determine if the access expression accesses a local variable which borrows
+// its object reference, so assigning it does not ref or unref.
+static bool isBorrowedVariable(deExpression accessExpression) {
+  if (deExpressionGetType(accessExpression) != DE_EXPR_IDENT) {
+    return false;
+  }
+  deIdent ident = deExpressionGetIdent(accessExpression);
+  return deIdentGetType(ident) == DE_IDENT_VARIABLE && deVariableBorrowed(deIdentGetVariable(ident));
+}
+
 // Generate write expression.  The top level operator of the access expression
 // needs to be evaluated differently, since it needs to give us the address to
-// write to rather than the value contained there.
-static void generateWriteExpression(deExpression accessExpression) {
+// write to rather than the value contained there.  If |lastUse|, the value is
+// a local array that is not read again, and is moved rather than copied.
+static void generateWriteExpression(deExpression accessExpression, bool lastUse) {
   llElement value = popElement(true);
   if (isUnusedVariable(accessExpression)) {
     return;
@@ -2362,15 +3031,31 @@ static void generateWriteExpression(deExpression accessExpression) {
   generateExpression(accessExpression);
   llElement access = popElement(false);
   deDatatype datatype = llElementGetDatatype(access);
-  if (deDatatypeContainsArray(datatype) || isRefCounted(datatype) ||
+  bool refCounted = isRefCounted(datatype) && !isBorrowedVariable(accessExpression);
+  if (deDatatypeContainsArray(datatype) || refCounted ||
       deDatatypeGetType(datatype) == DE_TYPE_TUPLE ||
-      deDatatypeGetType(datatype) == DE_TYPE_STRUCT) {
-    copyOrMoveElement(access, value, !deStatementIsFirstAssignment(llCurrentStatement));
+      deDatatypeGetType(datatype) == DE_TYPE_STRUCT ||
+      deDatatypeGetType(datatype) == DE_TYPE_FIXEDARRAY) {
+    bool freeDest = !deStatementIsFirstAssignment(llCurrentStatement);
+    if (lastUse && llDatatypeIsArray(llElementGetDatatype(value))) {
+      moveElement(access, value, freeDest);
+    } else {
+      copyOrMoveElement(access, value, freeDest);
+    }
   } else {
     utAssert(llElementIsRef(access));
     char *type = llGetTypeString(llElementGetDatatype(value), true);
-    llPrintf("  store %s %s, %s* %s%s\n", type, llElementGetName(value), type,
-             llElementGetName(access), locationInfo());
+    llPrintf("  store %s %s, %s* %s%s%s\n", type, llElementGetName(value), type,
+             llElementGetName(access), tbaaInfo(access), locationInfo());
+  }
+  deDatatypeType type = deDatatypeGetType(datatype);
+  if (deDatatypeIsInteger(datatype) || type == DE_TYPE_BOOL || type == DE_TYPE_FLOAT) {
+    if (deExpressionGetType(accessExpression) == DE_EXPR_IDENT) {
+      llForgetVariableBoundsChecks(deIdentGetVariable(deExpressionGetIdent(accessExpression)));
+    }
+  } else {
+    // Moving arrays and objects can resize arrays, or run destructors.
+    llForgetBoundsChecks();
   }
 }
 
@@ -2379,7 +3064,7 @@ static void generateAssignmentExpression(deExpression expression) {
   deExpression accessExpression = deExpressionGetFirstExpression(expression);
   deExpression valueExpression = deExpressionGetNextExpression(accessExpression);
   generateExpression(valueExpression);
-  generateWriteExpression(accessExpression);
+  generateWriteExpression(accessExpression, deExpressionLastUse(valueExpression));
 }
 
 // Write a tuple field.
@@ -2427,36 +3112,72 @@ static void generateStructConstructor(deExpression expression) {
   }
 }
 
-// Generate a function call.  The return value is reserved on the stack first,
-// then the arguments in reverse order of how they are listed.
-static void generateCallExpression(deExpression expression) {
-  if (isBuiltinCall(expression)) {
-    generateBuiltinMethod(expression);
-    return;
+// Determine if |datatype| is a reference counted class, even in generated
+// statements.
+static bool isRefCountedClass(deDatatype datatype) {
+  return deDatatypeGetType(datatype) == DE_TYPE_CLASS &&
+      deTemplateRefCounted(deClassGetTemplate(deDatatypeGetClass(datatype)));
+}
+
+// Determine if |element| can be passed to a tail call.  A tail call reuses the
+// caller's stack frame, so it cannot be passed pointers to the caller's locals
+// or temporaries.  Pointers to globals, and pointer parameters passed through,
+// point outside the frame.  If |freesLocals|, locals are freed before the call,
+// so reference counted objects cannot be passed, since a local may hold the
+// last reference.
+static bool isTailCallArgument(llElement element, bool freesLocals) {
+  deDatatype datatype = llElementGetDatatype(element);
+  if (llElementNeedsFree(element) || (freesLocals && isRefCountedClass(datatype))) {
+    return false;
   }
-  deExpression accessExpression = deExpressionGetFirstExpression(expression);
-  deDatatype callType = deExpressionGetDatatype(accessExpression);
-  if (deDatatypeGetType(callType) == DE_TYPE_FUNCTION) {
-    deFunction function = deDatatypeGetFunction(callType);
-    if (deFunctionGetType(function) == DE_FUNC_STRUCT) {
-      generateStructConstructor(expression);
-      return;
+  char *type = getElementTypeString(element);
+  char *name = llElementGetName(element);
+  if (type[strlen(type) - 1] != '*' || *name == '@') {
+    return true;
+  }
+  deBlock block = deFunctionGetSubBlock(deBlockGetOwningFunction(llCurrentScopeBlock));
+  deVariable variable;
+  deForeachBlockVariable(block, variable) {
+    if (deVariableGetType(variable) == DE_VAR_PARAMETER &&
+        !strcmp(llGetVariableName(variable), name)) {
+      return true;
+    }
+  } deEndBlockVariable;
+  return false;
+}
+
+// Return "musttail " or "tail " if the call in tail position, whose arguments
+// are on the stack above |stackPos|, can be a tail call, and otherwise "".
+// Nothing may run between a tail call and the return, so this frees the locals
+// before the call.  Calls to functions with the caller's prototype are musttail
+// calls, which LLVM always turns into jumps, even without optimization.
+static char *findTailCallMarker(uint32 stackPos, deDatatype returnType) {
+  bool freesLocals = llNeedsFreePos > 0;
+  for (uint32 i = stackPos; i < llStackPos; i++) {
+    if (!isTailCallArgument(llStack[i], freesLocals)) {
+      return "";
     }
   }
-  deExpression parameters = deExpressionGetNextExpression(accessExpression);
-  deSignature signature = deExpressionGetSignature(expression);
-  deDatatype returnType = deExpressionGetDatatype(expression);
-  uint32 savedStackPos = llStackPos;
-  bool isMethodCall = deExpressionIsMethodCall(accessExpression);
-  if (signature != deSignatureNull) {
-    evaluateParameters(signature, deDatatypeNull, parameters, isMethodCall);
-  } else {
-    evaluateIndirectCallParameters(parameters);
+  freeElements(true);
+  llGeneratedTailCall = true;
+  // Arguments are printed from the top of the stack down.
+  char *prototype = utAllocString(utSprintf("%s(", llGetTypeString(returnType, false)));
+  for (int32 i = (int32)llStackPos - 1; i >= (int32)stackPos; i--) {
+    char *newPrototype = utAllocString(utSprintf("%s%s%s", prototype,
+        i == (int32)llStackPos - 1? "" : ", ", getElementTypeString(llStack[i])));
+    utFree(prototype);
+    prototype = newPrototype;
   }
+  bool samePrototype = !strcmp(utSprintf("%s)", prototype), llPrototype);
+  utFree(prototype);
+  return samePrototype? "musttail " : "tail ";
+}
+
+// Generate the access expression of a call, and return the called element.
+// For method calls, the self parameter is left on the stack, if it is used.
+static llElement generateCallAccess(deExpression accessExpression, deSignature signature) {
   generateExpression(accessExpression);
   llElement element = popElement(true);
-  deDatatype accessDatatype = llElementGetDatatype(element);
-  deDatatypeType accessType = deDatatypeGetType(accessDatatype);
   if (llElementIsDelegate(element)) {
     // If this is a delegate, the self expression is still on the stack, and
     // needs to be derefed or popped if not used.
@@ -2467,12 +3188,66 @@ static void generateCallExpression(deExpression expression) {
       derefElement(selfElement);
     }
   }
-  llElement returnElement;
-  bool returnsValuePassedByReference = llDatatypePassedByReference(returnType);
-  if (returnsValuePassedByReference) {
+  return element;
+}
+
+// Pop the call arguments on the stack above |stackPos|, and print them.
+static void printCallArguments(uint32 stackPos) {
+  bool firstTime = true;
+  while (llStackPos > stackPos) {
+    if (!firstTime) {
+      llPuts(", ");
+    }
+    firstTime = false;
+    llElement element = popElement(false);
+    llPrintf("%s %s", getElementTypeString(element), llElementGetName(element));
+  }
+}
+
+// Generate a function call.  The return value is reserved on the stack first,
+// then the arguments in reverse order of how they are listed.
+static void generateCallExpression(deExpression expression) {
+  // Calls in the parameters are not in tail position.
+  bool inTailPosition = llInTailPosition;
+  llInTailPosition = false;
+  // The call may resize arrays passed to it, or run user code.
+  llForgetBoundsChecks();
+  if (isBuiltinCall(expression)) {
+    generateBuiltinMethod(expression);
+    return;
+  }
+  deExpression accessExpression = deExpressionGetFirstExpression(expression);
+  deDatatype callType = deExpressionGetDatatype(accessExpression);
+  if (deDatatypeGetType(callType) == DE_TYPE_FUNCTION) {
+    deFunction function = deDatatypeGetFunction(callType);
+    if (deFunctionGetType(function) == DE_FUNC_STRUCT) {
+      generateStructConstructor(expression);
+      return;
+    }
+  }
+  deExpression parameters = deExpressionGetNextExpression(accessExpression);
+  deSignature signature = deExpressionGetSignature(expression);
+  deDatatype returnType = deExpressionGetDatatype(expression);
+  uint32 savedStackPos = llStackPos;
+  bool isMethodCall = deExpressionIsMethodCall(accessExpression);
+  if (signature != deSignatureNull) {
+    evaluateParameters(signature, deDatatypeNull, parameters, isMethodCall);
+  } else {
+    evaluateIndirectCallParameters(parameters);
+  }
+  llElement element = generateCallAccess(accessExpression, signature);
+  deDatatype accessDatatype = llElementGetDatatype(element);
+  deDatatypeType accessType = deDatatypeGetType(accessDatatype);
+  llElement returnElement;
+  bool returnsValuePassedByReference = llDatatypePassedByReference(returnType);
+  if (returnsValuePassedByReference) {
     returnElement = allocateTempValue(returnType);
     returnType = deNoneDatatypeCreate();
   }
+  char *tailMarker = "";
+  if (inTailPosition && !returnsValuePassedByReference) {
+    tailMarker = findTailCallMarker(savedStackPos, returnType);
+  }
   bool returnsVal = deDatatypeGetType(returnType) != DE_TYPE_NONE;
   uint32 retVal = 0;
   if (returnsVal) {
@@ -2482,20 +3257,13 @@ static void generateCallExpression(deExpression expression) {
   }
   if (signature == deSignatureNull) {
     utAssert(accessType == DE_TYPE_FUNCPTR);
-    llPrintf("call %s %s(", llGetTypeString(returnType, false), llElementGetName(element));
+    llPrintf("%scall %s %s(", tailMarker, llGetTypeString(returnType, false),
+        llElementGetName(element));
   } else {
     char *path = llEscapeIdentifier(deGetSignaturePath(signature));
-    llPrintf("call %s @%s(", llGetTypeString(returnType, false), path);
-  }
-  bool firstTime = true;
-  while (llStackPos > savedStackPos) {
-    if (!firstTime) {
-      llPuts(", ");
-    }
-    firstTime = false;
-    llElement element = popElement(false);
-    llPrintf("%s %s", getElementTypeString(element), llElementGetName(element));
+    llPrintf("%scall %s @%s(", tailMarker, llGetTypeString(returnType, false), path);
   }
+  printCallArguments(savedStackPos);
   llPrintf(")%s\n", locationInfo());
   if (returnsVal) {
     // If returned value is a reference counted object, add it to the needsFree list.
@@ -2506,10 +3274,15 @@ static void generateCallExpression(deExpression expression) {
   }
 }
 
+// Determine if limitCheck generates a check for the current statement.
+static bool limitChecksEnabled(void) {
+  return !deUnsafeMode && (llDebugMode || !deStatementGenerated(llCurrentStatement));
+}
+
 // Generate code to bounds check a value.  The message will be passed to
 // runtime_raiseException if the bounds check fails.
 static void limitCheck(llElement index, llElement limit) {
-  if (deUnsafeMode || (!llDebugMode && deStatementGenerated(llCurrentStatement))) {
+  if (!limitChecksEnabled()) {
     return;
   }
   deDatatype limitType = llElementGetDatatype(limit);
@@ -2527,9 +3300,9 @@ static void limitCheck(llElement index, llElement limit) {
   if (!generatedFailBlock) {
     llLimitCheckFailedLabel = newLabel("limitCheckFailed");
   }
-  llPrintf("  br i1 %s, label %%%s, label %%%s%s\n",
+  llPrintf("  br i1 %s, label %%%s, label %%%s%s%s\n",
       llElementGetName(condition), utSymGetName(passedLabel),
-      utSymGetName(llLimitCheckFailedLabel), locationInfo());
+      utSymGetName(llLimitCheckFailedLabel), branchWeightInfo(true), locationInfo());
   if (!generatedFailBlock) {
     llPrintf("%s:\n", utSymGetName(llLimitCheckFailedLabel));
     llDeclareRuntimeFunction("runtime_panic");
@@ -2555,9 +3328,9 @@ static void nullCheck(llElement index, bool alwaysCheck) {
   if (!generatedFailBlock) {
     llBoundsCheckFailedLabel = newLabel("boundsCheckFailed");
   }
-  llPrintf("  br i1 %s, label %%%s, label %%%s%s\n",
+  llPrintf("  br i1 %s, label %%%s, label %%%s%s%s\n",
       llElementGetName(condition), utSymGetName(passedLabel),
-      utSymGetName(llBoundsCheckFailedLabel), locationInfo());
+      utSymGetName(llBoundsCheckFailedLabel), branchWeightInfo(true), locationInfo());
   if (!generatedFailBlock) {
     llPrintf("%s:\n", utSymGetName(llBoundsCheckFailedLabel));
     llDeclareRuntimeFunction("runtime_panic");
@@ -2569,17 +3342,13 @@ static void nullCheck(llElement index, bool alwaysCheck) {
   llPrevLabel = passedLabel;
 }
 
-// Perform a bounds check before indexing into an array.
-static void boundsCheck(llElement array, llElement index, char *message) {
-  if (deUnsafeMode || (!llDebugMode && deStatementGenerated(llCurrentStatement))) {
-    return;
-  }
-  uint32 value = printNewValue();
-  llPrintf("getelementptr inbounds %%struct.runtime_array, %%struct.runtime_array* %s, i32 0, i32 1\n",
-      llElementGetName(array), locationInfo());
-  deDatatype sizetDatatype = deUintDatatypeCreate(llSizeWidth);
-  llElement numElements = createValueElement(sizetDatatype, value, true);
-  derefElement(&numElements);
+// Determine if bounds checks should be generated for the current statement.
+static inline bool boundsChecksEnabled(void) {
+  return !deUnsafeMode && (llDebugMode || !deStatementGenerated(llCurrentStatement));
+}
+
+// Branch to the bounds check failure block unless |index| < |numElements|.
+static void checkIndexInBounds(llElement index, llElement numElements) {
   index = resizeInteger(index, llSizeWidth, false, false);
   llElement string = generateString(deCStringCreate("Indexed passed the end of an array"));
   generateBasicComparison(index, numElements, RN_LT);
@@ -2589,9 +3358,9 @@ static void boundsCheck(llElement array, llElement index, char *message) {
   if (!generatedFailBlock) {
     llBoundsCheckFailedLabel = newLabel("boundsCheckFailed");
   }
-  llPrintf("  br i1 %s, label %%%s, label %%%s%s\n",
+  llPrintf("  br i1 %s, label %%%s, label %%%s%s%s\n",
       llElementGetName(condition), utSymGetName(passedLabel),
-      utSymGetName(llBoundsCheckFailedLabel), locationInfo());
+      utSymGetName(llBoundsCheckFailedLabel), branchWeightInfo(true), locationInfo());
   if (!generatedFailBlock) {
     llPrintf("%s:\n", utSymGetName(llBoundsCheckFailedLabel));
     llDeclareRuntimeFunction("runtime_panic");
@@ -2603,6 +3372,16 @@ static void boundsCheck(llElement array, llElement index, char *message) {
   llPrevLabel = passedLabel;
 }
 
+// Perform a bounds check before indexing into an array.
+static void boundsCheck(llElement array, llElement index, char *message) {
+  if (!boundsChecksEnabled()) {
+    return;
+  }
+  uint32 lenValue = loadArrayLength(array);
+  deDatatype sizetDatatype = deUintDatatypeCreate(llSizeWidth);
+  checkIndexInBounds(index, createValueElement(sizetDatatype, lenValue, false));
+}
+
 // Index into an array.
 static void indexArray(llElement array, llElement index, bool needsBoundsCheck) {
   deDatatype indexDatatype = llElementGetDatatype(index);
@@ -2610,13 +3389,15 @@ static void indexArray(llElement array, llElement index, bool needsBoundsCheck)
     uint32 refWidth = deClassGetRefWidth(deDatatypeGetClass(indexDatatype));
     index = createElement(deUintDatatypeCreate(refWidth),
         llElementGetName(index), llElementIsRef(index));
-    nullCheck(index, false);
+    if (needsBoundsCheck) {
+      nullCheck(index, false);
+    }
   } else if (needsBoundsCheck) {
     boundsCheck(array, index, "Index out of bounds");
   }
   deDatatype arrayDatatype = llElementGetDatatype(array);
   deDatatype elementDatatype = getElementType(arrayDatatype);
-  llElement dataPtr = loadArrayDataPointer(array);
+  llElement dataPtr = loadArrayDataPointer(array, true);
   char *type = llGetTypeString(llElementGetDatatype(dataPtr), true);
   char *indexType = llGetTypeString(llElementGetDatatype(index), false);
   uint32 valuePtr = printNewValue();
@@ -2625,6 +3406,24 @@ static void indexArray(llElement array, llElement index, bool needsBoundsCheck)
   pushValue(elementDatatype, valuePtr, true);
 }
 
+// Index into a fixed-size array.  Its elements are stored inline, so there is
+// no data pointer to load, and the length is a constant.  The binder already
+// checked constant indexes, so only variable indexes need a bounds check.
+static void indexFixedArray(llElement array, llElement index, bool needsBoundsCheck) {
+  deDatatype arrayDatatype = llElementGetDatatype(array);
+  uint32 numElements = deDatatypeGetWidth(arrayDatatype);
+  if (needsBoundsCheck && boundsChecksEnabled()) {
+    checkIndexInBounds(index, createSmallInteger(numElements, llSizeWidth, false));
+  }
+  // GEP indexes are signed, so zero-extend narrow unsigned indexes.
+  index = resizeInteger(index, llSizeWidth, false, false);
+  char *type = llGetTypeString(arrayDatatype, true);
+  uint32 valuePtr = printNewValue();
+  llPrintf("getelementptr inbounds %s, %s* %s, i32 0, i%s %s\n", type, type,
+           llElementGetName(array), llSize, llElementGetName(index));
+  pushValue(deDatatypeGetElementType(arrayDatatype), valuePtr, true);
+}
+
 // Generate code for the member access.
 static void generateMemberAccess(deIdent ident, deExpression left, deExpression right) {
   generateExpression(left);
@@ -2633,7 +3432,28 @@ static void generateMemberAccess(deIdent ident, deExpression left, deExpression
   deVariable arrayVar = deVariableGetGlobalArrayVariable(variable);
   char *arrayName = llGetVariableName(arrayVar);
   llElement array = createElement(deVariableGetDatatype(arrayVar), arrayName, true);
-  indexArray(array, index, true);
+  bool needsNullCheck = llObjectNeedsNullCheck(left);
+  indexArray(array, index, needsNullCheck);
+  // Only a check actually emitted makes later ones redundant.
+  if (needsNullCheck && boundsChecksEnabled()) {
+    llRecordNullCheck(left);
+  }
+  char *region = arrayName;
+  if (deVariableGetFieldGroup(variable) != 0) {
+    // The field is stored in a tuple of its group's array of tuples.
+    uint32 tupleIndex = deVariableGetTupleIndex(variable);
+    llElement tuple = popElement(false);
+    pushElement(indexTuple(tuple, tupleIndex, true), false);
+    region = utSprintf("%s.%u", arrayName, tupleIndex);
+  }
+  // Each field lives in its own global array or tuple position, so field
+  // elements never alias each other or array headers.  Fields passed by
+  // reference are accessed through their own headers, so they are left
+  // untagged.
+  if (!llDatatypePassedByReference(deVariableGetDatatype(variable))) {
+    llElement *element = llStack + llStackPos - 1;
+    element->tbaaTag = findTBAATag(region);
+  }
 }
 
 // Generate an index expression.
@@ -2646,8 +3466,17 @@ static void generateIndexExpression(deExpression expression) {
     llElement array = popElement(false);
     generateExpression(right);
     llElement index = popElement(true);
-    boundsCheck(array, index, "Index out of bounds");
-    indexArray(array, index, true);
+    bool needsBoundsCheck = llIndexNeedsBoundsCheck(expression);
+    indexArray(array, index, needsBoundsCheck);
+    if (needsBoundsCheck && boundsChecksEnabled()) {
+      llRecordBoundsCheck(expression);
+    }
+  } else if (type == DE_TYPE_FIXEDARRAY) {
+    generateExpression(left);
+    llElement array = popElement(false);
+    generateExpression(right);
+    llElement index = popElement(true);
+    indexFixedArray(array, index, deExpressionGetType(right) != DE_EXPR_INTEGER);
   } else {
     utAssert(type == DE_TYPE_TUPLE || type == DE_TYPE_STRUCT);
     utAssert(deExpressionGetType(right) == DE_EXPR_INTEGER);
@@ -2805,6 +3634,7 @@ static void generateDotExpression(deExpression expression) {
       break;
     }
     case DE_TYPE_STRUCT:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_FUNCPTR:
     case DE_TYPE_CLASS:
     case DE_TYPE_NONE:
@@ -3034,9 +3864,11 @@ static void generateSignedCastExpression(deExpression expression, bool isSigned)
       boolVal(deDatatypeSecret(datatype)), locationInfo());
 }
 
-// Generate a call to runtime_bigintExp.
+// Generate a call to runtime_bigintExp, or its variable time version if the
+// result is not secret.
 static void generateBigintExp(deExpression expression) {
-  llDeclareRuntimeFunction("runtime_bigintExp");
+  char *funcName = findExpressionFunction(expression);
+  llDeclareRuntimeFunction(funcName);
   deExpression base = deExpressionGetFirstExpression(expression);
   deExpression exp = deExpressionGetNextExpression(base);
   generateExpression(base);
@@ -3046,8 +3878,8 @@ static void generateBigintExp(deExpression expression) {
   expElement = resizeInteger(expElement, 32, false, false);
   llElement destArray = allocateTempValue(deExpressionGetDatatype(expression));
   llPrintf(
-      "  call void @runtime_bigintExp(%%struct.runtime_array* %s, %%struct.runtime_array* %s, "
-      "i32 %s)%s\n",
+      "  call void @%s(%%struct.runtime_array* %s, %%struct.runtime_array* %s, "
+      "i32 %s)%s\n", funcName,
       llElementGetName(destArray), llElementGetName(baseElement),
       llElementGetName(expElement), locationInfo());
 }
@@ -3090,11 +3922,15 @@ static void generateExpExpression(deExpression expression) {
   }
 }
 
-// Generate a modular exponentiation bigint call.
+// Generate a modular exponentiation bigint call.  If neither the base nor the
+// exponent is secret, use the variable time version.
 static void generateModularBigintExp(deExpression expression, llElement modulusElement) {
-  llDeclareRuntimeFunction("runtime_bigintModularExp");
   deExpression base = deExpressionGetFirstExpression(expression);
   deExpression exp = deExpressionGetNextExpression(base);
+  bool secret = deDatatypeSecret(deExpressionGetDatatype(expression)) ||
+      deDatatypeSecret(deExpressionGetDatatype(exp));
+  char *funcName = secret? "runtime_bigintModularExp" : "runtime_bigintModularExpVartime";
+  llDeclareRuntimeFunction(funcName);
   generateModularExpression(base, modulusElement);
   llElement baseElement = popElement(true);
   // We can't reduce the exponent by the modulus without knowing the
@@ -3107,10 +3943,10 @@ static void generateModularBigintExp(deExpression expression, llElement modulusE
   }
   llElement destArray = allocateTempValue(deExpressionGetDatatype(expression));
   llPrintf(
-      "  call void @runtime_bigintModularExp(%%struct.runtime_array* %s, %%struct.runtime_array* "
+      "  call void @%s(%%struct.runtime_array* %s, %%struct.runtime_array* "
       "%s, "
       "%%struct.runtime_array* %s, %%struct.runtime_array* %s)%s\n",
-      llElementGetName(destArray), llElementGetName(baseElement),
+      funcName, llElementGetName(destArray), llElementGetName(baseElement),
       llElementGetName(expElement), llElementGetName(modulusElement),
       locationInfo());
 }
@@ -3155,7 +3991,7 @@ static void generateOpEqualsExpression(deExpression expression) {
   generateExpression(expression);
   deExpressionSetType(expression, type);
   deExpression accessExpression = deExpressionGetFirstExpression(expression);
-  generateWriteExpression(accessExpression);
+  generateWriteExpression(accessExpression, false);
 }
 
 // Generate a constant string expression.
@@ -3208,7 +4044,7 @@ static void generateNegateExpression(deExpression expression) {
   if (deDatatypeIsFloat(datatype)) {
     char *type = llGetTypeString(datatype, false);
     uint32 value = printNewValue();
-    llPrintf("fneg %s %s\n", type, llElementGetName(leftElement));
+    llPrintf("fneg%s %s %s\n", llCurrentFastMathFlags, type, llElementGetName(leftElement));
     pushValue(datatype, value, false);
   } else if (width > llSizeWidth) {
     char *funcName = "runtime_bigintNegate";
@@ -3235,8 +4071,8 @@ static void generateNegateExpression(deExpression expression) {
     llPrintf("extractvalue {i%u, i1} %%%u, 1\n", width, structValue);
     utSym passed = newLabel("overflowCheckPassed");
     utSym failed = newLabel("overflowCheckFailed");
-    llPrintf("  br i1 %%%u, label %%%s, label %%%s\n",
-        overflowValue, utSymGetName(failed), utSymGetName(passed));
+    llPrintf("  br i1 %%%u, label %%%s, label %%%s%s\n",
+        overflowValue, utSymGetName(failed), utSymGetName(passed), branchWeightInfo(false));
     printLabel(failed);
     llDeclareRuntimeFunction("runtime_raiseOverflow");
     llPrintf("  call void @runtime_raiseOverflow()\n  unreachable\n");
@@ -3284,6 +4120,82 @@ static bool couldBeGreaterOrEqual(deExpression expression, uint32 width) {
   return false;
 }
 
+// Shift or rotate a bigint on native LLVM integers.  The distance must not be
+// secret, since LLVM may branch on it when shifting wide integers.  If
+// |clampDist| is true, no limit check guards the distance, so distances of
+// the width or more, including negative ones, must not reach an LLVM shift,
+// where they are poison.  Such shifts give 0, or the sign for ashr, as shifting
+// by the width does in the runtime, and such rotates leave the value unchanged.
+static void generateNativeBigintShiftOrRotate(deExpression expression, llElement leftElement,
+    llElement rightElement, bool clampDist) {
+  deDatatype datatype = deExpressionGetDatatype(expression);
+  uint32 width = deDatatypeGetWidth(datatype);
+  uint32 leftValue = loadNativeBigint(leftElement);
+  uint32 dist = printNewValue();
+  llPrintf("zext i32 %s to i%u\n", llElementGetName(rightElement), width);
+  char *location = locationInfo();
+  uint32 tooFar = 0;
+  if (clampDist) {
+    tooFar = printNewValue();
+    llPrintf("icmp uge i%u %%%u, %u%s\n", width, dist, width, location);
+  }
+  uint32 value;
+  switch (deExpressionGetType(expression)) {
+    case DE_EXPR_SHL:
+    case DE_EXPR_SHR: {
+      bool arithmetic = deExpressionGetType(expression) == DE_EXPR_SHR &&
+          deDatatypeGetType(datatype) == DE_TYPE_INT;
+      char *op = deExpressionGetType(expression) == DE_EXPR_SHL? "shl" :
+          arithmetic? "ashr" : "lshr";
+      value = printNewValue();
+      llPrintf("%s i%u %%%u, %%%u%s\n", op, width, leftValue, dist, location);
+      if (clampDist) {
+        // Select does not propagate poison from the operand it does not pick.
+        char *fill = "0";
+        if (arithmetic) {
+          uint32 sign = printNewValue();
+          llPrintf("ashr i%u %%%u, %u%s\n", width, leftValue, width - 1, location);
+          fill = utSprintf("%%%u", sign);
+        }
+        uint32 clamped = printNewValue();
+        llPrintf("select i1 %%%u, i%u %s, i%u %%%u%s\n", tooFar, width, fill, width, value,
+            location);
+        value = clamped;
+      }
+      break;
+    }
+    case DE_EXPR_ROTL:
+    case DE_EXPR_ROTR: {
+      if (clampDist) {
+        uint32 clamped = printNewValue();
+        llPrintf("select i1 %%%u, i%u 0, i%u %%%u%s\n", tooFar, width, width, dist, location);
+        dist = clamped;
+      }
+      // LLVM's funnel shift intrinsics need a urem libcall for odd widths, so
+      // rotate with two shifts.  Shifting by 1 and then width-1-dist keeps both
+      // shift distances less than the width when dist is 0.
+      bool left = deExpressionGetType(expression) == DE_EXPR_ROTL;
+      char *op = left? "shl" : "lshr";
+      char *otherOp = left? "lshr" : "shl";
+      uint32 shifted = printNewValue();
+      llPrintf("%s i%u %%%u, %%%u%s\n", op, width, leftValue, dist, location);
+      uint32 byOne = printNewValue();
+      llPrintf("%s i%u %%%u, 1%s\n", otherOp, width, leftValue, location);
+      uint32 otherDist = printNewValue();
+      llPrintf("sub i%u %u, %%%u%s\n", width, width - 1, dist, location);
+      uint32 wrapped = printNewValue();
+      llPrintf("%s i%u %%%u, %%%u%s\n", otherOp, width, byOne, otherDist, location);
+      value = printNewValue();
+      llPrintf("or i%u %%%u, %%%u%s\n", width, shifted, wrapped, location);
+      break;
+    }
+    default:
+      utExit("Unexpected shift/rotate type");
+      return;
+  }
+  storeNativeBigint(datatype, value);
+}
+
 // Generate a bigint rotate left/right intrinsic.
 static void generateBigintShiftOrRotateExpression(deExpression expression) {
   deDatatype datatype = deExpressionGetDatatype(expression);
@@ -3296,13 +4208,19 @@ static void generateBigintShiftOrRotateExpression(deExpression expression) {
   generateExpression(right);
   llElement rightElement = popElement(true);
   deDatatype rightType = deExpressionGetDatatype(right);
-  if (couldBeGreaterOrEqual(right, width)) {
+  bool mayBeTooFar = couldBeGreaterOrEqual(right, width);
+  if (mayBeTooFar) {
     llElement limit = createElement(deUintDatatypeCreate(32), utSprintf("%u", width), false);
     limitCheck(rightElement, limit);
   }
   if (deDatatypeGetWidth(rightType) != 32) {
     rightElement = resizeInteger(rightElement, 32, deDatatypeSigned(rightType), false);
   }
+  if (isNativeBigint(datatype) && !deDatatypeSecret(rightType)) {
+    generateNativeBigintShiftOrRotate(expression, leftElement, rightElement,
+        mayBeTooFar && !limitChecksEnabled());
+    return;
+  }
   char *function = findExpressionFunction(expression);
   llElement resultArray = allocateTempValue(datatype);
   llDeclareRuntimeFunction(function);
@@ -3622,6 +4540,7 @@ static void generateLogicalAndExpression(deExpression expression) {
   llElement result2 = popElement(true);
   jumpTo(andShortcutTakenLabel);
   llPrintf("%s:\n", utSymGetName(andShortcutTakenLabel));
+  llForgetBoundsChecks();
   // Generate the dreaded "phony" instruction, eg:
   //   %12 = phi i1 [ false, %2 ], [ %10, %8 ]
   uint32 value = printNewValue();
@@ -3661,6 +4580,7 @@ static void generateLogicalOrExpression( deExpression expression) {
   llElement result2 = popElement(true);
   jumpTo(orShortcutTakenLabel);
   llPrintf("%s:\n", utSymGetName(orShortcutTakenLabel));
+  llForgetBoundsChecks();
   // Generate the dreaded "phony" instruction, eg:
   //   %12 = phi i1 [ false, %2 ], [ %10, %8 ]
   uint32 value = printNewValue();
@@ -3901,6 +4821,13 @@ static void generateExpression(deExpression expression) {
       generateNotNullExpression(expression);
       break;
     case DE_EXPR_ARRAYOF:
+      if (type == DE_TYPE_FIXEDARRAY) {
+        // Fixed-size arrays are passed by reference, so we need a zeroed temp.
+        pushNullValue(datatype);
+        break;
+      }
+      pushDefaultValue(datatype);
+      break;
     case DE_EXPR_TYPEOF:
     case DE_EXPR_UINTTYPE:
     case DE_EXPR_INTTYPE:
@@ -3958,6 +4885,13 @@ static bool blockEndsInReturn(deBlock subBlock) {
   return type == DE_STATEMENT_RETURN || type == DE_STATEMENT_RAISE;
 }
 
+// Determine if the block's last statement is a raise.
+static bool blockEndsInRaise(deBlock subBlock) {
+  deStatement lastStatement = deBlockGetLastStatement(subBlock);
+  return lastStatement != deStatementNull &&
+      deStatementGetType(lastStatement) == DE_STATEMENT_RAISE;
+}
+
 // Generate instructions for the if statement.
 static utSym generateIfStatement(deStatement statement, utSym startLabel) {
   utSym doneLabel = newLabel("ifDone");
@@ -3984,9 +4918,11 @@ static utSym generateIfStatement(deStatement statement, utSym startLabel) {
       freeElements(false);
       llElement condition = popElement(true);
       char *location = locationInfo();
-      llPrintf("  br i1 %s, label %%%s, label %%%s%s\n",
+      // Bodies that end by raising an exception are error paths.
+      char *weights = blockEndsInRaise(subBlock)? branchWeightInfo(false) : "";
+      llPrintf("  br i1 %s, label %%%s, label %%%s%s%s\n",
           llElementGetName(condition), utSymGetName(ifBodyLabel),
-          utSymGetName(nextClauseLabel), location);
+          utSymGetName(nextClauseLabel), weights, location);
     }
     utSym blockEndLabel = generateBlockStatements(subBlock, ifBodyLabel);
     if (!blockEndsInReturn(subBlock)) {
@@ -4011,6 +4947,219 @@ static utSym generateSelectedSwitchCase(deStatement statement, utSym startLabel)
   return startLabel;
 }
 
+// Return the enum entry referenced by the expression, such as Color.Red, or
+// deVariableNull if it is not an enum entry.
+static deVariable findEnumEntry(deExpression expression) {
+  if (deExpressionGetType(expression) == DE_EXPR_DOT) {
+    expression = deExpressionGetNextExpression(deExpressionGetFirstExpression(expression));
+  }
+  if (deExpressionGetType(expression) != DE_EXPR_IDENT) {
+    return deVariableNull;
+  }
+  deIdent ident = deExpressionGetIdent(expression);
+  if (ident == deIdentNull || deIdentGetType(ident) != DE_IDENT_VARIABLE) {
+    return deVariableNull;
+  }
+  deVariable variable = deIdentGetVariable(ident);
+  deFunction function = deBlockGetOwningFunction(deVariableGetBlock(variable));
+  if (function == deFunctionNull || deFunctionGetType(function) != DE_FUNC_ENUM) {
+    return deVariableNull;
+  }
+  return variable;
+}
+
+// Return the value of a constant integer or enum case expression.  Signed
+// values are sign extended to 64 bits.
+static uint64 findSwitchCaseValue(deExpression expression) {
+  if (deExpressionGetType(expression) == DE_EXPR_INTEGER) {
+    deBigint bigint = deExpressionGetBigint(expression);
+    deLine line = deExpressionGetLine(expression);
+    if (deBigintSigned(bigint)) {
+      return deBigintGetInt64(bigint, line);
+    }
+    return deBigintGetUint64(bigint, line);
+  }
+  return deVariableGetEntryValue(findEnumEntry(expression));
+}
+
+// Return true if value a <= b, comparing as signed if |isSigned|.
+static inline bool switchCaseValueLe(uint64 a, uint64 b, bool isSigned) {
+  return isSigned? (int64)a <= (int64)b : a <= b;
+}
+
+// Return true if the case expression is a constant that can be used directly
+// in an LLVM switch instruction, or a small range of constants.
+static bool isSwitchCaseConstant(deExpression expression, bool isSigned) {
+  deExpressionType type = deExpressionGetType(expression);
+  if (type == DE_EXPR_INTEGER) {
+    return true;
+  }
+  if (type == DE_EXPR_DOTDOTDOT) {
+    deExpression lower = deExpressionGetFirstExpression(expression);
+    deExpression upper = deExpressionGetNextExpression(lower);
+    if (deExpressionGetType(lower) != DE_EXPR_INTEGER ||
+        deExpressionGetType(upper) != DE_EXPR_INTEGER) {
+      return false;
+    }
+    uint64 lowerValue = findSwitchCaseValue(lower);
+    uint64 upperValue = findSwitchCaseValue(upper);
+    return !switchCaseValueLe(lowerValue, upperValue, isSigned) ||
+        upperValue - lowerValue < LL_MAX_SWITCH_CASE_RANGE;
+  }
+  return findEnumEntry(expression) != deVariableNull;
+}
+
+// Determine if the switch can be lowered to an LLVM switch instruction.  The
+// target must be a public integer or enum that fits in a register, and every
+// case must be a constant.  Switching on secrets must keep the chain of
+// comparisons, since a jump table would leak the secret through the branch.
+static bool canGenerateLLVMSwitch(deStatement statement, llElement target) {
+  deDatatype datatype = llElementGetDatatype(target);
+  deDatatypeType type = deDatatypeGetType(datatype);
+  if ((type != DE_TYPE_INT && type != DE_TYPE_UINT && type != DE_TYPE_ENUM) ||
+      deDatatypeSecret(datatype) || deDatatypeGetWidth(datatype) > llSizeWidth) {
+    return false;
+  }
+  bool isSigned = type == DE_TYPE_INT;
+  deStatement caseStatement;
+  deForeachBlockStatement(deStatementGetSubBlock(statement), caseStatement) {
+    deExpression expression = deStatementGetExpression(caseStatement);
+    if (deStatementInstantiated(caseStatement) && expression != deExpressionNull) {
+      deExpression caseExpression;
+      deForeachExpressionExpression(expression, caseExpression) {
+        if (!isSwitchCaseConstant(caseExpression, isSigned)) {
+          return false;
+        }
+      } deEndExpressionExpression;
+    }
+  } deEndBlockStatement;
+  return true;
+}
+
+// Add a value to the LLVM switch instruction being printed.  Rune matches the
+// first case with a value, while LLVM rejects duplicate values, so values
+// already in the switch are skipped.
+static void addSwitchCaseValue(uint64 **values, uint32 *numValues, uint32 *allocated,
+    uint64 value, bool isSigned, char *type, utSym label) {
+  for (uint32 i = 0; i < *numValues; i++) {
+    if ((*values)[i] == value) {
+      return;
+    }
+  }
+  if (*numValues == *allocated) {
+    *allocated <<= 1;
+    utResizeArray(*values, *allocated);
+  }
+  (*values)[(*numValues)++] = value;
+  if (isSigned) {
+    llPrintf("    %s %lld, label %%%s\n", type, (int64)value, utSymGetName(label));
+  } else {
+    llPrintf("    %s %llu, label %%%s\n", type, value, utSymGetName(label));
+  }
+}
+
+// Generate an LLVM switch instruction, so that LLVM can build jump tables or
+// binary searches, followed by the case bodies.
+static void generateLLVMSwitchStatement(deStatement statement, llElement target, utSym doneLabel) {
+  deDatatype datatype = llElementGetDatatype(target);
+  bool isSigned = deDatatypeSigned(datatype);
+  char *type = llGetTypeString(datatype, false);
+  deBlock subBlock = deStatementGetSubBlock(statement);
+  utSym defaultLabel = doneLabel;
+  deStatement caseStatement;
+  deForeachBlockStatement(subBlock, caseStatement) {
+    if (deStatementInstantiated(caseStatement) &&
+        deStatementGetType(caseStatement) == DE_STATEMENT_DEFAULT) {
+      defaultLabel = newLabel("default");
+    }
+  } deEndBlockStatement;
+  uint32 numCases = 0;
+  deForeachBlockStatement(subBlock, caseStatement) {
+    numCases++;
+  } deEndBlockStatement;
+  utSym *caseLabels = utNewA(utSym, numCases + 1);
+  uint32 allocated = 16;
+  uint32 numValues = 0;
+  uint64 *values = utNewA(uint64, allocated);
+  llPrintf("  switch %s %s, label %%%s [\n", type, llElementGetName(target),
+      utSymGetName(defaultLabel));
+  uint32 caseIndex = 0;
+  deForeachBlockStatement(subBlock, caseStatement) {
+    utSym label = utSymNull;
+    if (deStatementInstantiated(caseStatement)) {
+      if (deStatementGetType(caseStatement) == DE_STATEMENT_DEFAULT) {
+        label = defaultLabel;
+      } else {
+        label = newLabel("caseBody");
+      }
+      deExpression expression = deStatementGetExpression(caseStatement);
+      if (expression != deExpressionNull) {
+        deExpression caseExpression;
+        deForeachExpressionExpression(expression, caseExpression) {
+          if (deExpressionGetType(caseExpression) == DE_EXPR_DOTDOTDOT) {
+            deExpression lower = deExpressionGetFirstExpression(caseExpression);
+            uint64 value = findSwitchCaseValue(lower);
+            uint64 upperValue = findSwitchCaseValue(deExpressionGetNextExpression(lower));
+            while (switchCaseValueLe(value, upperValue, isSigned)) {
+              addSwitchCaseValue(&values, &numValues, &allocated, value, isSigned, type, label);
+              if (value == upperValue) {
+                break;
+              }
+              value++;
+            }
+          } else {
+            addSwitchCaseValue(&values, &numValues, &allocated,
+                findSwitchCaseValue(caseExpression), isSigned, type, label);
+          }
+        } deEndExpressionExpression;
+      }
+    }
+    caseLabels[caseIndex++] = label;
+  } deEndBlockStatement;
+  llPrintf("  ]%s\n", locationInfo());
+  caseIndex = 0;
+  deForeachBlockStatement(subBlock, caseStatement) {
+    utSym label = caseLabels[caseIndex++];
+    if (label != utSymNull) {
+      printLabel(label);
+      deBlock caseBlock = deStatementGetSubBlock(caseStatement);
+      utSym blockEndLabel = generateBlockStatements(caseBlock, utSymNull);
+      if (!blockEndsInReturn(caseBlock)) {
+        printLabel(blockEndLabel);
+        jumpTo(doneLabel);
+      }
+    }
+  } deEndBlockStatement;
+  utFree(values);
+  utFree(caseLabels);
+}
+
+// Compare the switch target to a case value, or to a range of values such as
+// 1 ... 10, and push the boolean result.
+static void generateCaseComparison(llElement target, deExpression caseExpression) {
+  if (deExpressionGetType(caseExpression) == DE_EXPR_DOTDOTDOT) {
+    deExpression lower = deExpressionGetFirstExpression(caseExpression);
+    deExpression upper = deExpressionGetNextExpression(lower);
+    generateExpression(lower);
+    llElement lowerElement = popElement(true);
+    generateExpression(upper);
+    llElement upperElement = popElement(true);
+    generateComparison(target, lowerElement, RN_GE);
+    llElement geLower = popElement(true);
+    generateComparison(target, upperElement, RN_LE);
+    llElement leUpper = popElement(true);
+    pushElement(computeLogicalAnd(geLower, leUpper), false);
+    return;
+  }
+  generateExpression(caseExpression);
+  llElement value = popElement(true);
+  if (llDatatypeIsArray(llElementGetDatatype(value))) {
+    generateArrayComparison(target, value, RN_EQUAL);
+  } else {
+    generateBasicComparison(target, value, RN_EQUAL);
+  }
+}
+
 // Generate instructions for the switch statement.
 static utSym generateSwitchStatement(deStatement statement, utSym startLabel) {
   printLabel(startLabel);
@@ -4022,6 +5171,11 @@ static utSym generateSwitchStatement(deStatement statement, utSym startLabel) {
   llNumLocalsNeedingFree = llNeedsFreePos;
   llElement target = popElement(true);
   utSym doneLabel = newLabel("switchDone");
+  if (canGenerateLLVMSwitch(statement, target)) {
+    generateLLVMSwitchStatement(statement, target, doneLabel);
+    llNumLocalsNeedingFree = numNeedsFreeLocals;
+    return doneLabel;
+  }
   utSym defaultLabel = newLabel("default");
   utSym nextCaseLabel = utSymNull;
   deBlock subBlock = deStatementGetSubBlock(statement);
@@ -4051,13 +5205,7 @@ static utSym generateSwitchStatement(deStatement statement, utSym startLabel) {
           } else {
             nextCaseLabel = doneLabel;
           }
-          generateExpression(caseExpression);
-          llElement value = popElement(true);
-          if (llDatatypeIsArray(llElementGetDatatype(value))) {
-            generateArrayComparison(target, value, RN_EQUAL);
-          } else {
-            generateBasicComparison(target, value, RN_EQUAL);
-          }
+          generateCaseComparison(target, caseExpression);
           // Only free temp variables created in the comparison, not the switch expression.
           freeElements(false);
           llElement result = popElement(true);
@@ -4128,7 +5276,7 @@ static utSym generateDoWhileStatement(deStatement statement, utSym startLabel) {
 //     body
 //     update
 //   }
-static utSym generateForStatement(deStatement statement, utSym startLabel) {
+static utSym generateForLoop(deStatement statement, utSym startLabel, bool hoistedChecks) {
   deExpression expression = deStatementGetExpression(statement);
   deExpression init = deExpressionGetFirstExpression(expression);
   deExpression test = deExpressionGetNextExpression(init);
@@ -4150,7 +5298,13 @@ static utSym generateForStatement(deStatement statement, utSym startLabel) {
   llPrintf("  br i1 %s, label %%%s, label%%%s\n",
       llElementGetName(condition), utSymGetName(forLoopBody), utSymGetName(forLoopDone));
   deBlock body = deStatementGetSubBlock(statement);
+  uint32 savedLoopIndexes = llSaveLoopIndexes();
+  llAddLoopIndexes(statement);
+  if (hoistedChecks) {
+    llAddHoistedLoopIndexes(statement);
+  }
   utSym blockEndLabel = generateBlockStatements(body, forLoopBody);
+  llRestoreLoopIndexes(savedLoopIndexes);
   printLabel(blockEndLabel);
   generateExpression(update);
   freeElements(false);
@@ -4158,6 +5312,48 @@ static utSym generateForStatement(deStatement statement, utSym startLabel) {
   return forLoopDone;
 }
 
+// Generate a for statement.  If the loop indexes local arrays with its loop
+// variable, and the bound is loop invariant, check bound <= array.length()
+// once before the loop.  If that passes, run a copy of the loop without
+// those bounds checks, and otherwise run the original.
+static utSym generateForStatement(deStatement statement, utSym startLabel) {
+  deExpression bound;
+  uint32 numArrays = llInVersionedLoop? 0 : llFindHoistedBoundsChecks(statement, &bound);
+  if (numArrays == 0) {
+    return generateForLoop(statement, startLabel, false);
+  }
+  printLabel(startLabel);
+  generateExpression(bound);
+  llElement boundElement = resizeInteger(popElement(true), llSizeWidth, false, false);
+  llElement inBounds = createElement(deBoolDatatypeCreate(), "true", false);
+  for (uint32 i = 0; i < numArrays; i++) {
+    deVariable arrayVar = llGetHoistedArray(i);
+    llElement array = createElement(deVariableGetDatatype(arrayVar),
+        llGetVariableName(arrayVar), true);
+    llElement length = createValueElement(llSizeType, loadArrayLength(array), false);
+    generateBasicComparison(boundElement, length, RN_LE);
+    llElement fits = popElement(true);
+    uint32 value = printNewValue();
+    llPrintf("and i1 %s, %s\n", llElementGetName(inBounds), llElementGetName(fits));
+    inBounds = createValueElement(deBoolDatatypeCreate(), value, false);
+  }
+  utSym hoistedLoop = newLabel("hoistedChecksForLoop");
+  utSym checkedLoop = newLabel("boundsCheckedForLoop");
+  utSym doneLabel = newLabel("forLoopsDone");
+  llPrintf("  br i1 %s, label %%%s, label %%%s\n", llElementGetName(inBounds),
+      utSymGetName(hoistedLoop), utSymGetName(checkedLoop));
+  llInVersionedLoop = true;
+  printLabel(generateForLoop(statement, hoistedLoop, true));
+  jumpTo(doneLabel);
+  // Count each check once, as it appears in the hoisted copy.
+  llCountBoundsChecks(false);
+  printLabel(generateForLoop(statement, checkedLoop, false));
+  llCountBoundsChecks(true);
+  jumpTo(doneLabel);
+  llInVersionedLoop = false;
+  return doneLabel;
+}
+
 // Print a string by calling runtime_puts.
 static void callPuts(llElement string) {
   llDeclareRuntimeFunction("runtime_puts");
@@ -4165,35 +5361,6 @@ static void callPuts(llElement string) {
       llGetTypeString(llElementGetDatatype(string), false), llElementGetName(string));
 }
 
-// Push the setjmp buffer onto the linked list.
-static void pushSetjmpBuffer(uint32 setjmpBuffer) {
-  uint32 firstSetjmpBuffer = printNewValue();
-  llPrintf("load %%struct.jmpbuf_wrapped*, %%struct.jmpbuf_wrapped** @runtime_firstSetjmpBuffer\n");
-  uint32 nextPtrAddr = printNewValue();
-  llPrintf("getelementptr inbounds %%struct.jmpbuf_wrapped, %%struct.jmpbuf_wrapped* %%.tmp%u, i32 0, i32 1\n", setjmpBuffer);
-  llPrintf("  store %%struct.jmpbuf_wrapped* %%%u, %%struct.jmpbuf_wrapped** %%%u\n", firstSetjmpBuffer, nextPtrAddr);
-  llPrintf("  store %%struct.jmpbuf_wrapped* %%.tmp%u, %%struct.jmpbuf_wrapped** @runtime_firstSetjmpBuffer\n", setjmpBuffer);
-}
-
-// Pop the setjmp buffer off of the linked list.
-static void popSetjmpBuffer() {
-  uint32 firstSetjmpBuffer = printNewValue();
-  llPrintf("load %%struct.jmpbuf_wrapped*, %%struct.jmpbuf_wrapped** @runtime_firstSetjmpBuffer\n");
-  uint32 nextPtrAddr = printNewValue();
-  llPrintf("getelementptr inbounds %%struct.jmpbuf_wrapped, %%struct.jmpbuf_wrapped* %%%u, i32 0, i32 1\n", firstSetjmpBuffer);
-  uint32 nextPtr = printNewValue();
-  llPrintf("load %%struct.jmpbuf_wrapped*, %%struct.jmpbuf_wrapped** %%%u\n", nextPtrAddr);
-  llPrintf("  store %%struct.jmpbuf_wrapped* %%%u, %%struct.jmpbuf_wrapped** @runtime_firstSetjmpBuffer\n", nextPtr);
-}
-
-// Pop any setjmp buffers that were created in this function which surround this
-// return statement.
-static void popSetjmpBuffers() {
-  for (uint32 i = 0; i < llSetjmpDepth; i++) {
-    popSetjmpBuffer();
-  }
-}
-
 // Get a field of the Error struct.
 static llElement getErrorField(llElement target, uint32 field) {
   uint32 fieldPtr = printNewValue();
@@ -4295,40 +5462,164 @@ static void generateExceptStatement(deStatement statement, utSym exceptDoneLabel
   } deEndBlockStatement;
 }
 
-// Generate a try statement.  For now, just generate if (runtime_setjmp()).
+// Insert |text| into the function text at |pos|.
+static void insertString(uint32 pos, char *text) {
+  uint32 len = strlen(text);
+  uint32 tailLen = deStringPos - pos;
+  llPuts(text);
+  memmove(deStringVal + pos + len, deStringVal + pos, tailLen);
+  memcpy(deStringVal + pos, text, len);
+}
+
+// Determine if |line| is a call which may raise an exception.  LLVM
+// intrinsics cannot be invoked, except for resuming and destroying coroutines,
+// which run user code.
+static bool isInvokableCall(char *line) {
+  if (strncmp(line, "  ", 2) != 0) {
+    return false;
+  }
+  if (strstr(line, "@llvm.") != NULL && strstr(line, "@llvm.coro.resume(") == NULL &&
+      strstr(line, "@llvm.coro.destroy(") == NULL) {
+    return false;
+  }
+  char *p = line + 2;
+  if (*p == '%') {
+    p = strstr(p, " = ");
+    if (p == NULL) {
+      return false;
+    }
+    p += 3;
+  }
+  return strncmp(p, "call ", 5) == 0;
+}
+
+// Replace the %|label| operands of |phi| with the block each was split into.
+static void printPhiWithSplitBlocks(char *phi, utSym *splitBlocks, uint32 numSplitBlocks) {
+  char *line = utAllocString(phi);
+  for (uint32 i = 0; i < numSplitBlocks; i += 2) {
+    char *oldOperand = utSprintf("%%%s]", utSymGetName(splitBlocks[i]));
+    char *p = strstr(line, oldOperand);
+    if (p != NULL) {
+      *p = '\0';
+      char *newLine = utSprintf("%s%%%s]%s", line, utSymGetName(splitBlocks[i + 1]),
+          p + strlen(oldOperand));
+      utFree(line);
+      line = utAllocString(newLine);
+    }
+  }
+  llPrintf("%s\n", line);
+  utFree(line);
+}
+
+// Rewrite the calls printed since |start| as invokes that unwind to
+// |landingPad|.  Calls already turned into invokes by a nested try keep their
+// inner landing pad.  Each invoke ends its basic block, so phi operands naming
+// a split block are redirected to the block holding the end of it.
+static void convertCallsToInvokes(uint32 start, utSym landingPad) {
+  char *text = utAllocString(deStringVal + start);
+  deStringPos = start;
+  deStringVal[start] = '\0';
+  uint32 allocatedSplitBlocks = 16;
+  utSym *splitBlocks = utNewA(utSym, allocatedSplitBlocks);
+  uint32 numSplitBlocks = 0;
+  utSym blockLabel = utSymNull;
+  char *line = text;
+  while (*line != '\0') {
+    char *next = strchr(line, '\n');
+    utAssert(next != NULL);
+    *next++ = '\0';
+    uint32 len = strlen(line);
+    if (len != 0 && line[0] != ' ' && line[len - 1] == ':') {
+      line[len - 1] = '\0';
+      blockLabel = utSymCreate(line);
+      llPrintf("%s:\n", line);
+    } else if (isInvokableCall(line)) {
+      utSym contLabel = newLabel("invokeCont");
+      char *call = strstr(line, "call ");
+      // Metadata attachments such as !dbg follow the argument list.
+      char *attachments = strrchr(line, ')') + 1;
+      char *attachmentsCopy = utAllocString(attachments);
+      *attachments = '\0';
+      *call = '\0';
+      llPrintf("%sinvoke %s to label %%%s unwind label %%%s%s\n%s:\n", line, call + 5,
+          utSymGetName(contLabel), utSymGetName(landingPad), attachmentsCopy,
+          utSymGetName(contLabel));
+      utFree(attachmentsCopy);
+      if (numSplitBlocks + 2 > allocatedSplitBlocks) {
+        allocatedSplitBlocks <<= 1;
+        utResizeArray(splitBlocks, allocatedSplitBlocks);
+      }
+      if (numSplitBlocks != 0 && splitBlocks[numSplitBlocks - 2] == blockLabel) {
+        splitBlocks[numSplitBlocks - 1] = contLabel;
+      } else {
+        splitBlocks[numSplitBlocks++] = blockLabel;
+        splitBlocks[numSplitBlocks++] = contLabel;
+      }
+    } else if (strstr(line, " = phi ") != NULL) {
+      printPhiWithSplitBlocks(line, splitBlocks, numSplitBlocks);
+    } else {
+      llPrintf("%s\n", line);
+    }
+    line = next;
+  }
+  utFree(splitBlocks);
+  utFree(text);
+}
+
+// Destroy the coroutines of foreach loops in the try block being unwound,
+// starting with the slot numbered |firstSlot|.  Those loops will not run again.
+static void destroyTryCoroutines(uint32 firstSlot) {
+  for (int32 i = (int32)llNumTryCoroutineSlots - 1; i >= (int32)firstSlot; i--) {
+    uint32 slot = llTryCoroutineSlots[i];
+    utSym destroyLabel = newLabel("destroyCoroutine");
+    utSym doneLabel = newLabel("destroyedCoroutine");
+    uint32 handle = printNewValue();
+    llPrintf("load i8*, i8** %%.tmp%u\n", slot);
+    uint32 active = printNewValue();
+    llPrintf("icmp ne i8* %%%u, null\n", handle);
+    llPrintf("  br i1 %%%u, label %%%s, label %%%s\n", active, utSymGetName(destroyLabel),
+        utSymGetName(doneLabel));
+    printLabel(destroyLabel);
+    llPrintf("  call void @llvm.coro.destroy(i8* %%%u)\n", handle);
+    llPrintf("  store i8* null, i8** %%.tmp%u\n", slot);
+    jumpTo(doneLabel);
+    printLabel(doneLabel);
+  }
+  llNumTryCoroutineSlots = firstSlot;
+}
+
+// Generate a try statement.  Calls in the try block are generated as invokes
+// which unwind to a landing pad before the except statement, so the try block
+// itself costs nothing unless an exception is raised.  The runtime fills out
+// runtimeException before unwinding.  Resuming a coroutine may raise, so it is
+// invoked too, and the landing pad destroys the try block's coroutines.
 static utSym generateTryStatement(deStatement tryStatement, utSym startLabel) {
-  printLabel(startLabel);
-  uint32 setjmpBuffer = printNewTmpValue();
-  llTmpPrintf("alloca %%struct.jmpbuf_wrapped\n");
-  pushSetjmpBuffer(setjmpBuffer);
-  uint32 jmpbufTag = printNewValue();
-  llPrintf("getelementptr inbounds %%struct.jmpbuf_wrapped, %%struct.jmpbuf_wrapped* %%.tmp%u, i32 0, i32 0\n",
-       setjmpBuffer);
-  uint32 setjmpResult = printNewValue();
-  llPrintf("call i32 @_setjmp(%%struct.__jmp_buf_tag* %%%u)\n", jmpbufTag);
-  llElement setjmpElem = createValueElement(deUintDatatypeCreate(32), setjmpResult, false);
-  llElement zero = createSmallInteger(0, 32, false);
-  generateBasicComparison(setjmpElem, zero, RN_EQUAL);
-  llElement condition = popElement(true);
+  if (!llHasLandingPads) {
+    llDeclareRuntimeFunction("runtime_personality");
+    insertString(llPersonalityPos, " personality i32 (...)* @runtime_personality");
+    llHasLandingPads = true;
+  }
   utSym tryLabel = newLabel("try");
   utSym exceptLabel = newLabel("except");
   utSym exceptDoneLabel = newLabel("exceptDone");
-  llPrintf("  br i1 %s, label %%%s, label %%%s%s\n",
-      llElementGetName(condition), utSymGetName(tryLabel),
-      utSymGetName(exceptLabel), locationInfo());
+  printLabel(startLabel);
+  // Start the try block with a label, so any block we split has a name.
+  jumpTo(tryLabel);
+  uint32 tryStart = deStringPos;
+  uint32 firstSlot = llNumTryCoroutineSlots;
   deBlock subBlock = deStatementGetSubBlock(tryStatement);
-  llSetjmpDepth++;
+  llTryDepth++;
   utSym blockEndLabel = generateBlockStatements(subBlock, tryLabel);
-  llSetjmpDepth--;
+  llTryDepth--;
   if (!blockEndsInReturn(subBlock)) {
     printLabel(blockEndLabel);
-    popSetjmpBuffer();
     jumpTo(exceptDoneLabel);
   }
+  convertCallsToInvokes(tryStart, exceptLabel);
   printLabel(exceptLabel);
-  popSetjmpBuffer();
+  llPrintf("  %%.%s = landingpad { i8*, i32 } catch i8* null\n", utSymGetName(exceptLabel));
+  destroyTryCoroutines(firstSlot);
   deStatement exceptStatement = deStatementGetNextBlockStatement(tryStatement);
-  subBlock = deStatementGetSubBlock(exceptStatement);
   generateExceptStatement(exceptStatement, exceptDoneLabel);
   return exceptDoneLabel;
 }
@@ -4382,17 +5673,272 @@ static void generateRaiseStatement(deStatement statement) {
   deExpressionInsertExpression(expression, enumExpr);
 }
 
+// Determine if |expression| is a call which may be generated as a tail call,
+// when it is returned, or directly followed by a return.  Calls from main,
+// constructors, destructors and try blocks are not, nor are calls returning
+// values by reference or reference counted objects, which need more code after
+// the call.
+static bool isTailCallCandidate(deExpression expression) {
+  if (llPrototype == NULL || llTryDepth > 0 || deExpressionGetType(expression) != DE_EXPR_CALL ||
+      isBuiltinCall(expression)) {
+    return false;
+  }
+  deFunctionType type = deFunctionGetType(deBlockGetOwningFunction(llCurrentScopeBlock));
+  deSignature signature = deExpressionGetSignature(expression);
+  if ((type != DE_FUNC_PLAIN && type != DE_FUNC_OPERATOR) || signature == deSignatureNull) {
+    return false;
+  }
+  deFunctionType calleeType = deFunctionGetType(deSignatureGetFunction(signature));
+  if (calleeType != DE_FUNC_PLAIN && calleeType != DE_FUNC_OPERATOR) {
+    return false;
+  }
+  deDatatype returnType = deExpressionGetDatatype(expression);
+  return !llDatatypePassedByReference(returnType) && !isRefCountedClass(returnType);
+}
+
+// Determine if the call statement is directly followed by a return of nothing,
+// so the call may be a tail call.  Not inside foreach loops over coroutines,
+// which the return destroys after the call.
+static bool callStatementIsInTailPosition(deStatement statement) {
+  deExpression expression = deStatementGetExpression(statement);
+  if (llNumCoroutineHandles > 0 ||
+      deExpressionGetDatatype(expression) != deNoneDatatypeCreate()) {
+    return false;
+  }
+  deStatement next = deStatementGetNextBlockStatement(statement);
+  while (next != deStatementNull && !deStatementInstantiated(next)) {
+    next = deStatementGetNextBlockStatement(next);
+  }
+  return next != deStatementNull && deStatementGetType(next) == DE_STATEMENT_RETURN &&
+      deStatementGetExpression(next) == deExpressionNull &&
+      isTailCallCandidate(expression);
+}
+
+// Start a coroutine: allocate its frame, unless LLVM elides it, and begin.
+// Locals are initialized before this, in the entry block, so CoroSplit can
+// move those live across suspend points into the frame.
+static void printCoroutinePrologue(void) {
+  utSym entryLabel = llPrevLabel;
+  utSym allocLabel = newLabel("coroAlloc");
+  utSym beginLabel = newLabel("coroBegin");
+  llDeclareRuntimeFunction("llvm.coro.id");
+  llDeclareRuntimeFunction("llvm.coro.alloc");
+  llDeclareRuntimeFunction("llvm.coro.size");
+  llDeclareRuntimeFunction("llvm.coro.begin");
+  llDeclareRuntimeFunction("calloc");
+  llCoroId = printNewValue();
+  llPuts("call token @llvm.coro.id(i32 0, i8* null, i8* null, i8* null)\n");
+  uint32 needsAlloc = printNewValue();
+  llPrintf("call i1 @llvm.coro.alloc(token %%%u)\n", llCoroId);
+  llPrintf("  br i1 %%%u, label %%%s, label %%%s\n", needsAlloc,
+      utSymGetName(allocLabel), utSymGetName(beginLabel));
+  printLabel(allocLabel);
+  uint32 size = printNewValue();
+  llPrintf("call i%s @llvm.coro.size.i%s()\n", llSize, llSize);
+  uint32 memory = printNewValue();
+  llPrintf("call i8* @calloc(i%s 1, i%s %%%u)\n", llSize, llSize, size);
+  jumpTo(beginLabel);
+  printLabel(beginLabel);
+  uint32 frame = printNewValue();
+  llPrintf("phi i8* [null, %%%s], [%%%u, %%%s]\n", utSymGetName(entryLabel), memory,
+      utSymGetName(allocLabel));
+  llCoroHandle = printNewValue();
+  llPrintf("call noalias i8* @llvm.coro.begin(token %%%u, i8* %%%u)\n", llCoroId, frame);
+}
+
+// Destroy the coroutines called by the foreach loops being generated, before
+// jumping out of them.
+static void destroyActiveCoroutines(void) {
+  for (int32 i = (int32)llNumCoroutineHandles - 1; i >= 0; i--) {
+    llPrintf("  call void @llvm.coro.destroy(i8* %%%u)\n", llCoroutineHandles[i]);
+  }
+}
+
+// Generate a yield statement in a coroutine.  Write the value through
+// %.yieldVal, and suspend.  If the caller destroys the coroutine rather than
+// resuming it, free the locals and clean up.  Return the label where it resumes.
+static utSym generateYieldStatement(deStatement statement) {
+  if (!llInCoroutine) {
+    utExit("Not expecting to see a yield() statement during code generation");
+  }
+  generateExpression(deStatementGetExpression(statement));
+  llElement value = popElement(true);
+  deDatatype datatype = llElementGetDatatype(value);
+  llElement dest = createElement(datatype, "%.yieldVal", true);
+  if (llDatatypePassedByReference(datatype) || deDatatypeContainsArray(datatype)) {
+    copyOrMoveElement(dest, value, true);
+  } else {
+    storeBasicType(dest, value);
+  }
+  freeElements(false);
+  llDeclareRuntimeFunction("llvm.coro.suspend");
+  utSym resumeLabel = newLabel("yieldResume");
+  utSym destroyLabel = newLabel("yieldDestroy");
+  uint32 result = printNewValue();
+  llPuts("call i8 @llvm.coro.suspend(token none, i1 false)\n");
+  llPrintf("  switch i8 %%%u, label %%coroSuspend [i8 0, label %%%s\n"
+      "      i8 1, label %%%s]\n", result, utSymGetName(resumeLabel), utSymGetName(destroyLabel));
+  printLabel(destroyLabel);
+  destroyActiveCoroutines();
+  freeElements(true);
+  llPuts("  br label %coroCleanup\n");
+  return resumeLabel;
+}
+
+// Finish the coroutine after its last statement.  It suspends a final time,
+// and the caller destroys it, which frees the frame unless LLVM elided it.
+static void printCoroutineEpilogue(deBlock block, utSym label) {
+  llDeclareRuntimeFunction("llvm.coro.suspend");
+  llDeclareRuntimeFunction("llvm.coro.free");
+  llDeclareRuntimeFunction("llvm.coro.end");
+  llDeclareRuntimeFunction("free");
+  if (!blockEndsInReturn(block)) {
+    printLabel(label);
+    freeElements(true);
+    llPuts("  br label %coroFinal\n");
+  }
+  printLabel(utSymCreate("coroFinal"));
+  uint32 result = printNewValue();
+  llPuts("call i8 @llvm.coro.suspend(token none, i1 true)\n");
+  llPrintf("  switch i8 %%%u, label %%coroSuspend [i8 0, label %%coroFinalResume\n"
+      "      i8 1, label %%coroCleanup]\n", result);
+  printLabel(utSymCreate("coroFinalResume"));
+  llPuts("  unreachable\n");
+  printLabel(utSymCreate("coroCleanup"));
+  uint32 memory = printNewValue();
+  llPrintf("call i8* @llvm.coro.free(token %%%u, i8* %%%u)\n", llCoroId, llCoroHandle);
+  uint32 allocated = printNewValue();
+  llPrintf("icmp ne i8* %%%u, null\n", memory);
+  llPrintf("  br i1 %%%u, label %%coroFree, label %%coroSuspend\n", allocated);
+  printLabel(utSymCreate("coroFree"));
+  llPrintf("  call void @free(i8* %%%u)\n", memory);
+  llPuts("  br label %coroSuspend\n");
+  printLabel(utSymCreate("coroSuspend"));
+  printNewValue();
+  llPrintf("call i1 @llvm.coro.end(i8* %%%u, i1 false)\n", llCoroHandle);
+  llPrintf("  ret i8* %%%u\n", llCoroHandle);
+}
+
+// Assign the value a coroutine yielded to the loop variable.  Like the
+// assignment inlined iterators generate, this does not reference count objects.
+static void assignLoopVariable(deExpression access, llElement slot) {
+  if (isUnusedVariable(access)) {
+    return;
+  }
+  generateExpression(access);
+  llElement dest = popElement(false);
+  if (deDatatypeContainsArray(llElementGetDatatype(slot))) {
+    // The coroutine frees the slot's old value when it yields again.
+    copyElement(dest, slot, true);
+  } else {
+    moveTupleOrObject(dest, slot);
+  }
+}
+
+// Generate a foreach statement over a coroutine iterator.  The first call
+// runs the coroutine to its first yield, and returns its handle.  The body
+// runs once per yielded value, and then resumes the coroutine, until it is
+// done.  Calls to other iterators were inlined.
+static utSym generateForeachStatement(deStatement statement, utSym startLabel) {
+  deExpression assignment = deStatementGetExpression(statement);
+  deExpression access = deExpressionGetFirstExpression(assignment);
+  deExpression call = deExpressionGetNextExpression(access);
+  deSignature signature = deExpressionGetSignature(call);
+  if (signature == deSignatureNull || !deFunctionCoroutine(deSignatureGetFunction(signature))) {
+    utExit("Not expecting to see a foreach statement during code generation");
+  }
+  printLabel(startLabel);
+  llDeclareRuntimeFunction("llvm.coro.done");
+  llDeclareRuntimeFunction("llvm.coro.resume");
+  llDeclareRuntimeFunction("llvm.coro.destroy");
+  // The coroutine runs user code.
+  llForgetBoundsChecks();
+  uint32 savedNumLocalsNeedingFree = llNumLocalsNeedingFree;
+  deDatatype yieldType = deExpressionGetDatatype(call);
+  // Arrays in the slot are freed when the loop is done.
+  llElement slot = allocateTempValue(yieldType);
+  popElement(false);
+  if (deDatatypeContainsArray(yieldType)) {
+    // Clear arrays freed on an earlier pass through an enclosing loop.
+    char *type = llGetTypeString(yieldType, true);
+    llPrintf("  store %s zeroinitializer, %s* %s\n", type, type, llElementGetName(slot));
+  }
+  uint32 savedStackPos = llStackPos;
+  deExpression accessExpression = deExpressionGetFirstExpression(call);
+  deExpression parameters = deExpressionGetNextExpression(accessExpression);
+  evaluateParameters(signature, deDatatypeNull, parameters,
+      deExpressionIsMethodCall(accessExpression));
+  generateCallAccess(accessExpression, signature);
+  pushElement(slot, false);
+  uint32 handle = printNewValue();
+  llPrintf("call i8* @%s(", llEscapeIdentifier(deGetSignaturePath(signature)));
+  printCallArguments(savedStackPos);
+  llPrintf(")%s\n", locationInfo());
+  // Keep the arguments and the slot until the loop is done.
+  llNumLocalsNeedingFree = llNeedsFreePos;
+  if (llNumCoroutineHandles == llCoroutineHandlesAllocated) {
+    llCoroutineHandlesAllocated <<= 1;
+    utResizeArray(llCoroutineHandles, llCoroutineHandlesAllocated);
+  }
+  llCoroutineHandles[llNumCoroutineHandles++] = handle;
+  uint32 handleSlot = 0;
+  if (llTryDepth > 0) {
+    // Remember the handle for the landing pad, until the loop destroys it.
+    handleSlot = printNewTmpValue();
+    llTmpPrintf("alloca i8*\n");
+    llTmpPrintf("  store i8* null, i8** %%.tmp%u\n", handleSlot);
+    llPrintf("  store i8* %%%u, i8** %%.tmp%u\n", handle, handleSlot);
+    if (llNumTryCoroutineSlots == llTryCoroutineSlotsAllocated) {
+      llTryCoroutineSlotsAllocated <<= 1;
+      utResizeArray(llTryCoroutineSlots, llTryCoroutineSlotsAllocated);
+    }
+    llTryCoroutineSlots[llNumTryCoroutineSlots++] = handleSlot;
+  }
+  utSym loopLabel = newLabel("foreachLoop");
+  utSym bodyLabel = newLabel("foreachBody");
+  utSym doneLabel = newLabel("foreachDone");
+  jumpTo(loopLabel);
+  printLabel(loopLabel);
+  uint32 done = printNewValue();
+  llPrintf("call i1 @llvm.coro.done(i8* %%%u)\n", handle);
+  llPrintf("  br i1 %%%u, label %%%s, label %%%s\n", done,
+      utSymGetName(doneLabel), utSymGetName(bodyLabel));
+  printLabel(bodyLabel);
+  assignLoopVariable(access, slot);
+  deBlock body = deStatementGetSubBlock(statement);
+  utSym blockEndLabel = generateBlockStatements(body, utSymNull);
+  if (!blockEndsInReturn(body)) {
+    printLabel(blockEndLabel);
+    llPrintf("  call void @llvm.coro.resume(i8* %%%u)\n", handle);
+    jumpTo(loopLabel);
+  }
+  printLabel(doneLabel);
+  llPrintf("  call void @llvm.coro.destroy(i8* %%%u)\n", handle);
+  if (handleSlot != 0) {
+    llPrintf("  store i8* null, i8** %%.tmp%u\n", handleSlot);
+  }
+  llNumCoroutineHandles--;
+  llNumLocalsNeedingFree = savedNumLocalsNeedingFree;
+  return utSymNull;
+}
+
 // Generate a return statement.
 static void generateReturnStatement(deStatement statement) {
   deExpression expression = deStatementGetExpression(statement);
   deFunctionType funcType = deFunctionGetType(deBlockGetOwningFunction(llCurrentScopeBlock));
+  destroyActiveCoroutines();
+  if (llInCoroutine) {
+    // Returning from a coroutine finishes it.
+    freeElements(true);
+    llPuts("  br label %coroFinal\n");
+    return;
+  }
   if (funcType == DE_FUNC_DESTRUCTOR) {
     generateCallToFreeFunc();
   }
   if (funcType == DE_FUNC_CONSTRUCTOR) {
     // This is a constructor.  Return self.
     freeElements(true);
-    popSetjmpBuffers();
     deVariable self = deBlockGetFirstVariable(llCurrentScopeBlock);
     deDatatype selfType = deVariableGetDatatype(self);
     utAssert(deDatatypeGetType(selfType) == DE_TYPE_CLASS);
@@ -4400,19 +5946,23 @@ static void generateReturnStatement(deStatement statement) {
     char *location = locationInfo();
     llPrintf("  ret i%u %s%s\n", deClassGetRefWidth(theClass), llGetVariableName(self), location);
   } else if (expression == deExpressionNull) {
-    freeElements(true);
-    popSetjmpBuffers();
+    // A tail call in the previous statement already freed the locals.
+    if (!llGeneratedTailCall) {
+      freeElements(true);
+    }
+    llGeneratedTailCall = false;
     char *location = locationInfo();
     llPrintf("  ret void%s\n", location);
   } else {
+    llInTailPosition = isTailCallCandidate(expression);
     generateExpression(expression);
+    llInTailPosition = false;
     deDatatype returnType = deExpressionGetDatatype(expression);
     if (llDatatypePassedByReference(returnType)) {
       llElement *elementPtr = topOfStack();
       llElement retVal = createElement(returnType, "%.retVal", true);
       copyOrMoveElement(retVal, *elementPtr, false);
       freeElements(true);
-      popSetjmpBuffers();
       llPrintf("  ret void%s\n", locationInfo());
     } else {
       llElement element = popElement(true);
@@ -4420,8 +5970,10 @@ static void generateReturnStatement(deStatement statement) {
         // Ref before freeing elements in case we are returning a local varialbe.
         refObject(element);
       }
-      freeElements(true);
-      popSetjmpBuffers();
+      if (!llGeneratedTailCall) {
+        freeElements(true);
+      }
+      llGeneratedTailCall = false;
       llPrintf("  ret %s %s%s\n", llGetTypeString(returnType, false),
           llElementGetName(element), locationInfo());
     }
@@ -4489,7 +6041,9 @@ static utSym generateStatement(deStatement statement, utSym label) {
     case DE_STATEMENT_CALL:
       printLabel(label);
       label = utSymNull;
+      llInTailPosition = callStatementIsInTailPosition(statement);
       generateExpression(deStatementGetExpression(statement));
+      llInTailPosition = false;
       if (deExpressionGetDatatype(expression) != deNoneDatatypeCreate()) {
         popElement(false);
       }
@@ -4536,9 +6090,12 @@ static utSym generateStatement(deStatement statement, utSym label) {
       // Nothing to do.
       break;
     case DE_STATEMENT_YIELD:
-      utExit("Not expecting to see a yield() statement during code generation");
+      printLabel(label);
+      label = generateYieldStatement(statement);
+      break;
     case DE_STATEMENT_FOREACH:
-      utExit("Not expecting to see a foreach statement during code generation");
+      label = generateForeachStatement(statement, label);
+      break;
   }
   return label;
 }
@@ -4567,6 +6124,83 @@ static void resetBlock(deBlock block, deSignature signature) {
   } deEndBlockVariable;
 }
 
+// Return the function text starting at |start| in the string buffer, with the
+// temporaries spliced in where flushStringBuffer will put them.  The caller
+// frees the result.
+static char *getFunctionText(uint32 start) {
+  char *text = deStringVal + start;
+  char *p = strstr(text, LL_TMPVARS_STRING);
+  if (p == NULL) {
+    return utAllocString(text);
+  }
+  size_t prefixLen = p - text;
+  size_t tmpLen = strlen(llTmpValueBuffer);
+  char *suffix = p + sizeof(LL_TMPVARS_STRING) - 1;
+  char *result = utNewA(char, prefixLen + tmpLen + strlen(suffix) + 1);
+  memcpy(result, text, prefixLen);
+  memcpy(result + prefixLen, llTmpValueBuffer, tmpLen);
+  strcpy(result + prefixLen + tmpLen, suffix);
+  return result;
+}
+
+// If the function just generated, starting at |start| in the string buffer,
+// is identical to one generated earlier, replace it with a thunk which
+// tail-calls the earlier one.  Instantiations of the same function for
+// different classes with the same reference width often lower to the same IR.
+// A thunk rather than an alias keeps each function a separate definition, so
+// partitioning with -j still works, and LLVM can inline it away.
+static void shareIdenticalFunction(deSignature signature, uint32 start) {
+  if (!llShareIdenticalFunctions || llDebugMode || llInCoroutine ||
+      deFunctionAlwaysInline(deSignatureGetFunction(signature))) {
+    return;
+  }
+  char *name = utAllocString(llEscapeIdentifier(llPath));
+  char *text = getFunctionText(start);
+  char *sharedName = llFindIdenticalFunction(name, text);
+  utFree(text);
+  if (sharedName == NULL) {
+    utFree(name);
+    return;
+  }
+  if (llShowSharedFunctions) {
+    printf("%s: thunk to identical function\n",
+        deGetBlockPath(deSignatureGetBlock(signature), false));
+  }
+  // The header is "\ndefine <visibility> <return type> @<name>(<params>)".
+  char *header = deStringVal + start;
+  char *retType = strchr(header + sizeof("\ndefine ") - 1, ' ') + 1;
+  char *namePos = strstr(retType, utSprintf(" @%s(", name));
+  char *params = namePos + strlen(name) + 3;
+  char *p = params;
+  uint32 depth = 0;
+  while (*p != ')' || depth != 0) {
+    if (*p == '(') {
+      depth++;
+    } else if (*p == ')') {
+      depth--;
+    }
+    p++;
+  }
+  *namePos = '\0';
+  *p = '\0';
+  char *thunk;
+  if (!strcmp(retType, "void")) {
+    thunk = utSprintf("%s @%s(%s) {\n  musttail call void @%s(%s)\n  ret void\n}\n\n",
+        header, name, params, sharedName, params);
+  } else {
+    thunk = utSprintf("%s @%s(%s) {\n  %%.result = musttail call %s @%s(%s)\n  ret %s %%.result\n}\n\n",
+        header, name, params, retType, sharedName, params, retType);
+  }
+  thunk = utAllocString(thunk);
+  deStringPos = start;
+  deStringVal[start] = '\0';
+  llPuts(thunk);
+  llTmpValueBuffer[0] = '\0';
+  llTmpValuePos = 0;
+  utFree(thunk);
+  utFree(name);
+}
+
 // Generate LLVM assembly code for a fully bound block.
 static void generateBlockAssemblyCode(deBlock block, deSignature signature) {
   resetBlock(block, signature);
@@ -4589,13 +6223,31 @@ static void generateBlockAssemblyCode(deBlock block, deSignature signature) {
   }
   llStackPos = 0;
   llCurrentScopeBlock = block;
-  printFunctionHeader(block, signature);
   llLabelNum = 1;
+  uint32 start = deStringPos;
+  printFunctionHeader(block, signature);
+  if (llInCoroutine) {
+    printCoroutinePrologue();
+  }
   llLimitCheckFailedLabel = utSymNull;
   llBoundsCheckFailedLabel = utSymNull;
-  generateBlockStatements(block, utSymNull);
+  llStartFunctionBoundsChecks();
+  utSym label = generateBlockStatements(block, utSymNull);
+  if (llInCoroutine) {
+    printCoroutineEpilogue(block, label);
+  }
   llPrintf("}\n\n");
+  if (llShowBoundsChecks && signature != deSignatureNull) {
+    llReportFunctionBoundsChecks(deGetBlockPath(deSignatureGetBlock(signature), false));
+  }
+  if (signature != deSignatureNull) {
+    shareIdenticalFunction(signature, start);
+  }
   utFree(llPath);
+  if (llPrototype != NULL) {
+    utFree(llPrototype);
+    llPrototype = NULL;
+  }
   llCurrentScopeBlock = deBlockNull;
   llDebugMode = savedDebugMode;
   llDeclareNewTuples();
@@ -4615,22 +6267,19 @@ static void printHeader(void) {
 #endif
 #endif
   fprintf(llAsmFile, "; ModuleID = '%s'\n", llModuleName);
+  // Profile names of internal functions include the source file name, so
+  // keep it independent of the directory the .ll file is written to.
+  fprintf(llAsmFile, "source_filename = \"%s\"\n", llModuleName);
   fprintf(llAsmFile,
       "target datalayout = \"e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128\"\n"
       "%s\n\n"
       "%%struct.runtime_array = type {i64*, i64}\n",
       triple);
   fputs("%struct.runtime_bool = type { i32 }\n", llAsmFile);
-  fputs("%struct.__jmp_buf_tag = type { [8 x i64], i32, %struct.__sigset_t }\n", llAsmFile);
-  fputs("%struct.__sigset_t = type { [16 x i64] }\n", llAsmFile);
-  fputs("declare i32 @_setjmp(%struct.__jmp_buf_tag* noundef)\n", llAsmFile);
-  fputs("declare void @longjmp(%struct.__jmp_buf_tag* noundef, i32 noundef)\n", llAsmFile);
-  fputs("%struct.jmpbuf_wrapped = type {%struct.__jmp_buf_tag, %struct.jmpbuf_wrapped*}\n", llAsmFile);
-  fputs("@runtime_firstSetjmpBuffer = dso_local global %struct.jmpbuf_wrapped* zeroinitializer\n", llAsmFile);
 }
 
-// Generate LLVM assembly code.
-void llGenerateLLVMAssemblyCode(char* fileName, bool debugMode) {
+// Generate LLVM assembly code to llAsmFile, and close it.
+static void generateLLVMAssemblyCode(char* fileName, bool debugMode) {
   llStackPos = 0;
   llStackAllocated = 32;
   llStack = utNewA(llElement, llStackAllocated);
@@ -4638,10 +6287,12 @@ void llGenerateLLVMAssemblyCode(char* fileName, bool debugMode) {
   llNumLocalsNeedingFree = 0;
   llNeedsFreeAllocated = 32;
   llNeedsFree = utNewA(llElement, llNeedsFreeAllocated);
-  llAsmFile = fopen(fileName, "w");
-  if (llAsmFile == NULL) {
-    deError(0, "Unable to write to %s", fileName);
-  }
+  llNumCoroutineHandles = 0;
+  llCoroutineHandlesAllocated = 8;
+  llCoroutineHandles = utNewA(uint32, llCoroutineHandlesAllocated);
+  llNumTryCoroutineSlots = 0;
+  llTryCoroutineSlotsAllocated = 8;
+  llTryCoroutineSlots = utNewA(uint32, llTryCoroutineSlotsAllocated);
   llModuleName = utAllocString(utBaseName(fileName));
   llDebugMode = debugMode;
   llSize = "64";
@@ -4652,6 +6303,9 @@ void llGenerateLLVMAssemblyCode(char* fileName, bool debugMode) {
   llTmpValuePos = 0;
   llTmpValueBuffer = utNewA(char, llTmpValueLen);
   llStart();
+  llStartBoundsChecks();
+  llStartFunctionSharing();
+  llInVersionedLoop = false;
   printHeader();
   flushStringBuffer();
   llDeclareExternCFunctions();
@@ -4670,7 +6324,9 @@ void llGenerateLLVMAssemblyCode(char* fileName, bool debugMode) {
       deBlock block = deSignatureGetBlock(signature);
       deFunction function = deBlockGetOwningFunction(block);
       deFunctionType type = deFunctionGetType(function);
-      if (block != rootBlock && type != DE_FUNC_ITERATOR && type != DE_FUNC_STRUCT &&
+      bool isInlined = type == DE_FUNC_ITERATOR &&
+          !deFunctionCoroutine(deSignatureGetFunction(signature));
+      if (block != rootBlock && !isInlined && type != DE_FUNC_STRUCT &&
           deFunctionGetLinkage(function) != DE_LINK_EXTERN_C) {
         deResetString();
         llDeclareBlockGlobals(block);
@@ -4682,11 +6338,39 @@ void llGenerateLLVMAssemblyCode(char* fileName, bool debugMode) {
   llWriteDeclarations();
   flushStringBuffer();
   fclose(llAsmFile);
+  if (llShowBoundsChecks) {
+    llReportBoundsChecks();
+  }
+  llStopBoundsChecks();
+  llStopFunctionSharing();
   llStop();
   utFree(llNeedsFree);
+  utFree(llCoroutineHandles);
+  utFree(llTryCoroutineSlots);
   utFree(llStack);
   utFree(llModuleName);
   utFree(llTmpValueBuffer);
   llTmpValueLen = 0;
   llTmpValuePos = 0;
 }
+
+// Generate LLVM assembly code to |fileName|.
+void llGenerateLLVMAssemblyCode(char* fileName, bool debugMode) {
+  llAsmFile = fopen(fileName, "w");
+  if (llAsmFile == NULL) {
+    deError(0, "Unable to write to %s", fileName);
+  }
+  generateLLVMAssemblyCode(fileName, debugMode);
+}
+
+// Generate LLVM assembly code in memory, for the in-process backend.
+// |fileName| only names the module.  The caller frees the result with free.
+char *llGenerateLLVMAssemblyText(char* fileName, bool debugMode, size_t *length) {
+  char *text;
+  llAsmFile = open_memstream(&text, length);
+  if (llAsmFile == NULL) {
+    deError(0, "Unable to generate LLVM IR in memory");
+  }
+  generateLLVMAssemblyCode(fileName, debugMode);
+  return text;
+}
@@ -42,6 +42,8 @@ void llCreateFilepathTags(void);
 llTag llGenerateMainTags(void);
 void llGenerateSignatureTags(deSignature signature);
 void llWriteDebugTags(void);
+void llWriteMetadataNodes(void);
+uint32 llCreateMetadataNode(char *text);
 void llCreateGlobalVariableTags(deBlock block);
 void llDeclareLocalVariable(deVariable variable, uint32 argNum);
 void llDeclareGlobalVariable(deVariable variable);
@@ -53,6 +55,31 @@ bool llDatatypeIsArray(deDatatype datatype);
 uint32 llBigintBitsToWords(uint32 width, bool isSigned);
 bool llDatatypePassedByReference(deDatatype datatype);
 
+// Bounds check elimination.
+void llStartBoundsChecks(void);
+void llStopBoundsChecks(void);
+uint32 llSaveLoopIndexes(void);
+void llRestoreLoopIndexes(uint32 savedNumLoopIndexes);
+void llAddLoopIndexes(deStatement statement);
+uint32 llFindHoistedBoundsChecks(deStatement statement, deExpression *bound);
+deVariable llGetHoistedArray(uint32 index);
+void llAddHoistedLoopIndexes(deStatement statement);
+bool llIndexNeedsBoundsCheck(deExpression expression);
+bool llObjectNeedsNullCheck(deExpression expression);
+void llRecordBoundsCheck(deExpression expression);
+void llRecordNullCheck(deExpression expression);
+void llForgetBoundsChecks(void);
+void llForgetVariableBoundsChecks(deVariable variable);
+void llCountBoundsChecks(bool count);
+void llStartFunctionBoundsChecks(void);
+void llReportFunctionBoundsChecks(char *name);
+void llReportBoundsChecks(void);
+
+// Function sharing.
+void llStartFunctionSharing(void);
+void llStopFunctionSharing(void);
+char *llFindIdenticalFunction(char *name, char *text);
+
 // LLVM has a bug: type declarations MUST precede their use.  Therefore, when
 // printing a function, use these functions instead of writing to the file
 // directly.  This allows declarations required by the function to be printed
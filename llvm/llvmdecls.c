@@ -46,10 +46,11 @@ bool llDatatypeIsArray(deDatatype datatype) {
   return false;
 }
 
-// True if an array, tuple, string or bigint.
+// True if an array, fixed-size array, tuple, string or bigint.
 bool llDatatypePassedByReference(deDatatype datatype) {
   deDatatypeType type = deDatatypeGetType(datatype);
-  return type == DE_TYPE_TUPLE || type == DE_TYPE_STRUCT || deDatatypeContainsArray(datatype);
+  return type == DE_TYPE_TUPLE || type == DE_TYPE_STRUCT || type == DE_TYPE_FIXEDARRAY ||
+      deDatatypeContainsArray(datatype);
 }
 
 // Escape a string.  Non-printable characters and " are represented as \xx, two
@@ -255,6 +256,11 @@ static char *getTypeString(deDatatype datatype, bool isDefinition) {
       return utSprintf("i%u", deDatatypeGetWidth(datatype));
     case DE_TYPE_TUPLE:
       return getTupleTypeString(datatype, isDefinition);
+    case DE_TYPE_FIXEDARRAY: {
+      char *elementType = getTypeString(deDatatypeGetElementType(datatype), true);
+      char *arrayType = utSprintf("[%u x %s]", deDatatypeGetWidth(datatype), elementType);
+      return isDefinition? arrayType : utSprintf("%s*", arrayType);
+    }
     case DE_TYPE_NONE:
       return "void";
     case DE_TYPE_FUNCTION:
@@ -317,13 +323,18 @@ static void declareRuntimeFunctions(void) {
   createFuncDecl("runtime_freeArray", "declare dso_local void @runtime_freeArray(%struct.runtime_array*)");
   createFuncDecl("runtime_foreachArrayObject",
       "declare dso_local void @runtime_foreachArrayObject(%struct.runtime_array*, i8 *, i32, i32)");
-  createFuncDecl("runtime_panicCstr", "declare dso_local void @runtime_panicCstr(i8*, ...)");
+  createFuncDecl("runtime_panicCstr", "declare dso_local void @runtime_panicCstr(i8*, ...) cold noreturn");
   createFuncDecl("runtime_allocArray", utSprintf(
       "declare dso_local void @runtime_allocArray(%%struct.runtime_array*, i%s, i%s, i1 zeroext)",
       llSize, llSize));
+  createFuncDecl("runtime_initArrayFromData", utSprintf(
+      "declare dso_local void @runtime_initArrayFromData(%%struct.runtime_array*, i8*, i%s, i%s)",
+      llSize, llSize));
   createFuncDecl("runtime_appendArrayElement", utSprintf(
       "declare dso_local void @runtime_appendArrayElement(%%struct.runtime_array*, i8*, i%s, i1 zeroext, i1 zeroext)",
       llSize));
+  createFuncDecl("runtime_appendMovedArray", "declare dso_local void @runtime_appendMovedArray("
+      "%struct.runtime_array*, %struct.runtime_array*)");
   createFuncDecl("runtime_arrayStart", utSprintf("declare dso_local void @runtime_arrayStart()"));
   createFuncDecl("runtime_arrayStop", "declare dso_local void @runtime_arrayStop()");
   createFuncDecl("runtime_compactArrayHeap", "declare dso_local void @runtime_compactArrayHeap()");
@@ -339,7 +350,10 @@ static void declareRuntimeFunctions(void) {
   createFuncDecl("runtime_nativeIntToString", utSprintf(
       "declare dso_local void @runtime_nativeIntToString(%%struct.runtime_array*, i%s, i32, i1 zeroext)",
       llSize));
-  createFuncDecl("runtime_panic", "declare dso_local void @runtime_panic(%struct.runtime_array*, ...) noreturn");
+  createFuncDecl("runtime_nativeIntToStackString", utSprintf(
+      "declare dso_local void @runtime_nativeIntToStackString(%%struct.runtime_array*, i%s*, i%s, "
+      "i%s, i32, i1 zeroext)", llSize, llSize, llSize));
+  createFuncDecl("runtime_panic", "declare dso_local void @runtime_panic(%struct.runtime_array*, ...) cold noreturn");
   createFuncDecl("runtime_putsCstr", "declare dso_local void @runtime_putsCstr(i8*)");
   createFuncDecl("runtime_puts", "declare dso_local void @runtime_puts(%struct.runtime_array*)");
   createFuncDecl("runtime_resizeArray", utSprintf(
@@ -353,11 +367,12 @@ static void declareRuntimeFunctions(void) {
       "declare dso_local i%s @runtime_stringFind(%%struct.runtime_array*, %%struct.runtime_array*, i%s)", llSize, llSize));
   createFuncDecl("runtime_stringRfind", utSprintf(
       "declare dso_local i%s @runtime_stringRfind(%%struct.runtime_array*, %%struct.runtime_array*, i%s)", llSize, llSize));
-  createFuncDecl("runtime_raiseExceptionCstr", "declare dso_local void @runtime_raiseExceptionCstr(i8*, ...) noreturn");
+  createFuncDecl("runtime_raiseExceptionCstr", "declare dso_local void @runtime_raiseExceptionCstr(i8*, ...) cold noreturn");
   createFuncDecl("runtime_raiseException", "declare dso_local void @runtime_raiseException("
     "%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*, i32, "
-    "%struct.runtime_array*, ...) noreturn");
-  createFuncDecl("runtime_raiseOverflow", "declare dso_local void @runtime_raiseOverflow() noreturn");
+    "%struct.runtime_array*, ...) cold noreturn");
+  createFuncDecl("runtime_personality", "declare dso_local i32 @runtime_personality(...)");
+  createFuncDecl("runtime_raiseOverflow", "declare dso_local void @runtime_raiseOverflow() cold noreturn");
   createFuncDecl("runtime_vsprintf", "declare dso_local void @runtime_vsprintf(%struct.runtime_array*, %struct.runtime_array*, %struct.__va_list_tag*)");
   createFuncDecl("runtime_sprintf", "declare dso_local void @runtime_sprintf(%struct.runtime_array*, %struct.runtime_array*, ...)");
   createFuncDecl("runtime_makeEmptyArray",
@@ -461,6 +476,32 @@ static void declareRuntimeFunctions(void) {
       "%struct.runtime_array*, %struct.runtime_array*);");
   createFuncDecl("runtime_bigintModularNegate", "declare void @runtime_bigintModularNegate("
       "%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintMulVartime",
+      "declare void @runtime_bigintMulVartime(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintMulTruncVartime",
+      "declare void @runtime_bigintMulTruncVartime(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintDivVartime",
+      "declare void @runtime_bigintDivVartime(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintModVartime",
+      "declare void @runtime_bigintModVartime(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintExpVartime",
+      "declare void @runtime_bigintExpVartime(%struct.runtime_array*, %struct.runtime_array*, i32)");
+  createFuncDecl("runtime_bigintModularMulVartime",
+      "declare void @runtime_bigintModularMulVartime(%struct.runtime_array*, %struct.runtime_array*, "
+      "%struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintModularExpVartime",
+      "declare void @runtime_bigintModularExpVartime(%struct.runtime_array*, %struct.runtime_array*, "
+      "%struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintMulKaratsuba",
+      "declare void @runtime_bigintMulKaratsuba(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintMulTruncKaratsuba",
+      "declare void @runtime_bigintMulTruncKaratsuba(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintMulToom3",
+      "declare void @runtime_bigintMulToom3(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintMulTruncToom3",
+      "declare void @runtime_bigintMulTruncToom3(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("runtime_bigintModularMulBatch",
+      "declare void @runtime_bigintModularMulBatch(%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
   createFuncDecl("runtime_smallnumMul", utSprintf(
       "declare i%s @runtime_smallnumMul(i%s, i%s, i1 zeroext, i1 zeroext)", llSize, llSize, llSize));
   createFuncDecl("runtime_smallnumDiv", utSprintf(
@@ -499,6 +540,17 @@ static void declareRuntimeFunctions(void) {
   createFuncDecl("runtime_bigintDivRem",
       "declare void @runtime_bigintDivRem(%struct.runtime_array*, "
       "%struct.runtime_array*, %struct.runtime_array*, %struct.runtime_array*)");
+  createFuncDecl("free", "declare dso_local void @free(i8*)");
+  createFuncDecl("llvm.coro.id", "declare token @llvm.coro.id(i32, i8*, i8*, i8*)");
+  createFuncDecl("llvm.coro.alloc", "declare i1 @llvm.coro.alloc(token)");
+  createFuncDecl("llvm.coro.size", utSprintf("declare i%s @llvm.coro.size.i%s()", llSize, llSize));
+  createFuncDecl("llvm.coro.begin", "declare i8* @llvm.coro.begin(token, i8*)");
+  createFuncDecl("llvm.coro.suspend", "declare i8 @llvm.coro.suspend(token, i1)");
+  createFuncDecl("llvm.coro.free", "declare i8* @llvm.coro.free(token, i8*)");
+  createFuncDecl("llvm.coro.end", "declare i1 @llvm.coro.end(i8*, i1)");
+  createFuncDecl("llvm.coro.done", "declare i1 @llvm.coro.done(i8*)");
+  createFuncDecl("llvm.coro.resume", "declare void @llvm.coro.resume(i8*)");
+  createFuncDecl("llvm.coro.destroy", "declare void @llvm.coro.destroy(i8*)");
 }
 
 // Initialize the  declarations module.
@@ -736,7 +788,7 @@ static void declareGlobalVariable(deVariable variable) {
   char *typeString = llGetTypeString(datatype, true);
   char *initializer;
   if (llDatatypeIsArray(datatype) || type == DE_TYPE_TUPLE || type == DE_TYPE_STRUCT ||
-      type == DE_TYPE_FLOAT) {
+      type == DE_TYPE_FIXEDARRAY || type == DE_TYPE_FLOAT) {
     initializer = "zeroinitializer";
   } else {
     initializer = "0";
@@ -781,6 +833,8 @@ char *llEscapeText(char *text) {
 void llWriteDeclarations(void) {
   if (llDebugMode) {
     llWriteDebugTags();
+  } else {
+    llWriteMetadataNodes();
   }
 }
 
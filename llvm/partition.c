@@ -0,0 +1,231 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Split the LLVM IR generated for a program into several modules, so clang can
+// optimize them in parallel.  Function definitions are spread across the
+// partitions, balancing their size.  Partition 0 also gets main and the global
+// variables.  Everything else at the top level, such as types, runtime
+// declarations, string constants, and metadata, is copied to every partition.
+// Each partition declares the functions defined in the others.  Constants are
+// internal, so duplicating them is safe, and unused copies are dropped by the
+// optimizer.  Internal functions are made hidden, so calls between partitions
+// still link.  Debug info is not supported: its metadata is not shared safely.
+
+#include "ll.h"
+#include "llexport.h"
+
+typedef enum {
+  LL_ENTITY_SHARED,    // Copied to every partition.
+  LL_ENTITY_GLOBAL,    // Defined in partition 0, external elsewhere.
+  LL_ENTITY_FUNCTION,  // Defined in one partition, declared elsewhere.
+} llEntityType;
+
+// A top level entity in the IR: a line, or a whole function definition.
+typedef struct {
+  char *text;
+  size_t length;
+  llEntityType type;
+  uint32 partition;
+} llEntity;
+
+// Return true if the line starting at |text| starts with |prefix|.
+static bool startsWith(char *text, char *prefix) {
+  return !strncmp(text, prefix, strlen(prefix));
+}
+
+// Return the end of the function definition starting at |text|, just past the
+// closing brace line.  Only the closing brace of a definition is on a line by
+// itself.
+static char *findFunctionEnd(char *text, char *end) {
+  char *p = text;
+  while (p < end) {
+    char *lineEnd = memchr(p, '\n', end - p);
+    if (lineEnd == NULL) {
+      return end;
+    }
+    if (lineEnd - p == 1 && *p == '}') {
+      return lineEnd + 1;
+    }
+    p = lineEnd + 1;
+  }
+  return end;
+}
+
+// Split |text| into top level entities.  The caller frees the result.
+static llEntity *findEntities(char *text, size_t length, uint32 *numEntities) {
+  uint32 allocated = 256;
+  llEntity *entities = utNewA(llEntity, allocated);
+  uint32 num = 0;
+  char *end = text + length;
+  char *p = text;
+  while (p < end) {
+    char *lineEnd = memchr(p, '\n', end - p);
+    char *next = lineEnd == NULL? end : lineEnd + 1;
+    llEntityType type = LL_ENTITY_SHARED;
+    if (startsWith(p, "define ")) {
+      type = LL_ENTITY_FUNCTION;
+      next = findFunctionEnd(next, end);
+    } else if (*p == '@' && lineEnd != NULL) {
+      *lineEnd = '\0';
+      if (strstr(p, " = dso_local global ") != NULL) {
+        type = LL_ENTITY_GLOBAL;
+      }
+      *lineEnd = '\n';
+    }
+    if (num == allocated) {
+      allocated <<= 1;
+      utResizeArray(entities, allocated);
+    }
+    entities[num].text = p;
+    entities[num].length = next - p;
+    entities[num].type = type;
+    entities[num].partition = 0;
+    num++;
+    p = next;
+  }
+  *numEntities = num;
+  return entities;
+}
+
+// Assign each function to the partition with the least code so far.  The
+// definition of main stays in partition 0, with the globals.
+static void assignPartitions(llEntity *entities, uint32 numEntities, uint32 numPartitions) {
+  size_t *sizes = utNewA(size_t, numPartitions);
+  memset(sizes, 0, numPartitions * sizeof(size_t));
+  for (uint32 i = 0; i < numEntities; i++) {
+    llEntity *entity = entities + i;
+    if (entity->type == LL_ENTITY_FUNCTION) {
+      uint32 partition = 0;
+      if (!startsWith(entity->text, "define dso_local i32 @main(")) {
+        for (uint32 j = 1; j < numPartitions; j++) {
+          if (sizes[j] < sizes[partition]) {
+            partition = j;
+          }
+        }
+      }
+      entity->partition = partition;
+      sizes[partition] += entity->length;
+    }
+  }
+  utFree(sizes);
+}
+
+// Write an external declaration of the global variable defined by |entity|.
+// The initializer is the last word on the line.
+static void writeExternalGlobal(FILE *file, llEntity *entity) {
+  char *nameEnd = strstr(entity->text, " = dso_local global ");
+  char *typeStart = nameEnd + sizeof(" = dso_local global ") - 1;
+  char *typeEnd = entity->text + entity->length - 1;
+  while (typeEnd > typeStart && *typeEnd != ' ') {
+    typeEnd--;
+  }
+  fwrite(entity->text, 1, nameEnd - entity->text, file);
+  fputs(" = external global ", file);
+  fwrite(typeStart, 1, typeEnd - typeStart, file);
+  fputc('\n', file);
+}
+
+// Write the function definition, making internal functions hidden so the
+// other partitions can call them.
+static void writeDefinition(FILE *file, llEntity *entity) {
+  char *text = entity->text;
+  size_t length = entity->length;
+  if (startsWith(text, "define internal ")) {
+    fputs("define hidden ", file);
+    text += sizeof("define internal ") - 1;
+    length -= sizeof("define internal ") - 1;
+  }
+  fwrite(text, 1, length, file);
+}
+
+// Write a declaration for the function defined by |entity|: its header up to
+// the closing parenthesis of the parameters.  LLVM ignores parameter names in
+// declarations.
+static void writeDeclaration(FILE *file, llEntity *entity) {
+  char *p = entity->text + sizeof("define ") - 1;
+  char *linkage = "dso_local ";
+  if (startsWith(p, "internal ")) {
+    p += sizeof("internal ") - 1;
+    linkage = "hidden ";
+  } else if (startsWith(p, "dso_local ")) {
+    p += sizeof("dso_local ") - 1;
+  }
+  char *start = p;
+  // Quoted names may contain parentheses.
+  p = strchr(p, '@') + 1;
+  if (*p == '"') {
+    p = strchr(p + 1, '"') + 1;
+  }
+  p = strchr(p, '(');
+  uint32 depth = 0;
+  do {
+    if (*p == '(') {
+      depth++;
+    } else if (*p == ')') {
+      depth--;
+    }
+    p++;
+  } while (depth > 0);
+  fprintf(file, "declare %s", linkage);
+  fwrite(start, 1, p - start, file);
+  fputc('\n', file);
+}
+
+// Write partition |partition| to |file|.
+static void writePartition(FILE *file, llEntity *entities, uint32 numEntities, uint32 partition) {
+  for (uint32 i = 0; i < numEntities; i++) {
+    llEntity *entity = entities + i;
+    switch (entity->type) {
+      case LL_ENTITY_SHARED:
+        fwrite(entity->text, 1, entity->length, file);
+        break;
+      case LL_ENTITY_GLOBAL:
+        if (partition == 0) {
+          fwrite(entity->text, 1, entity->length, file);
+        } else {
+          writeExternalGlobal(file, entity);
+        }
+        break;
+      case LL_ENTITY_FUNCTION:
+        if (entity->partition == partition) {
+          writeDefinition(file, entity);
+        } else if (!startsWith(entity->text, "define dso_local i32 @main(")) {
+          writeDeclaration(file, entity);
+        }
+        break;
+    }
+  }
+}
+
+// Split the LLVM IR in |text| into |numPartitions| modules, written to
+// |fileNames|.  |text| must not have debug info.  Return false on failure,
+// after printing the reason.
+bool llPartitionLLVMAssembly(char *text, size_t length, uint32 numPartitions, char **fileNames) {
+  uint32 numEntities;
+  llEntity *entities = findEntities(text, length, &numEntities);
+  assignPartitions(entities, numEntities, numPartitions);
+  bool passed = true;
+  for (uint32 i = 0; i < numPartitions && passed; i++) {
+    FILE *file = fopen(fileNames[i], "w");
+    if (file == NULL) {
+      printf("Unable to write to %s\n", fileNames[i]);
+      passed = false;
+    } else {
+      writePartition(file, entities, numEntities, i);
+      fclose(file);
+    }
+  }
+  utFree(entities);
+  return passed;
+}
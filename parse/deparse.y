@@ -233,6 +233,7 @@ static void moveImportsToBlock(deBlock subBlock, deBlock destBlock) {
 %token <lineVal> KWARROW
 %token <lineVal> KWIMPLIES
 %token <lineVal> KWAS
+%token <lineVal> KWAOS
 %token <lineVal> KWASSERT
 %token <lineVal> KWBITANDEQUALS
 %token <lineVal> KWBITOREQUALS
@@ -241,6 +242,7 @@ static void moveImportsToBlock(deBlock subBlock, deBlock destBlock) {
 %token <lineVal> KWCASCADE
 %token <lineVal> KWCASTTRUNC
 %token <lineVal> KWCLASS
+%token <lineVal> KWCOROUTINE
 %token <lineVal> KWDEBUG
 %token <lineVal> KWDEFAULT
 %token <lineVal> KWDIVEQUALS
@@ -257,6 +259,7 @@ static void moveImportsToBlock(deBlock subBlock, deBlock destBlock) {
 %token <lineVal> KWEXTERN
 %token <lineVal> KWF32
 %token <lineVal> KWF64
+%token <lineVal> KWFASTMATH
 %token <lineVal> KWFINAL
 %token <lineVal> KWFOR
 %token <lineVal> KWFUNC
@@ -446,6 +449,15 @@ classHeader: KWCLASS IDENT optWidth
   deTemplateCreate(constructor, $3, $1);
   deCurrentBlock = deFunctionGetSubBlock(constructor);
 }
+| KWAOS KWCLASS IDENT optWidth  // Means fields are stored as an array of structures.
+{
+  deFunction constructor = deFunctionCreate(deCurrentFilepath, deCurrentBlock,
+      DE_FUNC_CONSTRUCTOR, $3, DE_LINK_MODULE, $1);
+  deFunctionSetInUnitTest(constructor, deInUnitTest);
+  deTemplate templ = deTemplateCreate(constructor, $4, $1);
+  deTemplateSetArrayOfStructs(templ, true);
+  deCurrentBlock = deFunctionGetSubBlock(constructor);
+}
 
 optWidth:  // Empty
 {
@@ -689,6 +701,14 @@ functionHeader: KWFUNC IDENT
   deFunctionSetInUnitTest(function, deInUnitTest);
   deCurrentBlock = deFunctionGetSubBlock(function);
 }
+| KWFASTMATH KWFUNC IDENT
+{
+  deFunction function = deFunctionCreate(deCurrentFilepath, deCurrentBlock,
+      DE_FUNC_PLAIN, $3, DE_LINK_MODULE, $1);
+  deFunctionSetInUnitTest(function, deInUnitTest);
+  deFunctionSetFastMath(function, true);
+  deCurrentBlock = deFunctionGetSubBlock(function);
+}
 | KWITERATOR IDENT
 {
   deFunction function = deFunctionCreate(deCurrentFilepath, deCurrentBlock,
@@ -697,6 +717,15 @@ functionHeader: KWFUNC IDENT
   deCurrentBlock = deFunctionGetSubBlock(function);
   deInIterator = true;
 }
+| KWCOROUTINE KWITERATOR IDENT
+{
+  deFunction function = deFunctionCreate(deCurrentFilepath, deCurrentBlock,
+      DE_FUNC_ITERATOR, $3, DE_LINK_MODULE, $1);
+  deFunctionSetInUnitTest(function, deInUnitTest);
+  deFunctionSetCoroutine(function, true);
+  deCurrentBlock = deFunctionGetSubBlock(function);
+  deInIterator = true;
+}
 | KWOPERATOR operator
 {
   deFunction operator = deOperatorFunctionCreate(deCurrentBlock, $2, $1);
@@ -1275,6 +1304,12 @@ compoundTypeExpression: basicTypeExpression
   deExpressionSetType($2, DE_EXPR_ARRAY);
   $$ = $2;
 }
+| '[' typeRangeExpression ';' INTEGER ']'
+{
+  // A fixed-size array, like [u8; 32].
+  $$ = deBinaryExpressionCreate(DE_EXPR_ARRAYOF, $2,
+      deIntegerExpressionCreate($4, deCurrentLine), $1);
+}
 | '(' typeRangeExpressionList ')'
 {
   // Modify the type from DE_EXPR_LIST to DE_EXPR_TUPLE.
@@ -1384,6 +1419,10 @@ accessExpression: writableExpression
 {
   $$ = deUnaryExpressionCreate(DE_EXPR_ARRAYOF, $3, $1);
 }
+| KWARRAYOF '(' typeExpression ',' expression ')'
+{
+  $$ = deBinaryExpressionCreate(DE_EXPR_ARRAYOF, $3, $5, $1);
+}
 | KWTYPEOF '(' expression ')'
 {
   $$ = deUnaryExpressionCreate(DE_EXPR_TYPEOF, $3, $1);
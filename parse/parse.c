@@ -32,6 +32,11 @@ bool deLogTokens;
 bool deInvertReturnCode;
 char *deLLVMFileName;
 bool deTestMode;
+bool deStableSignatureNames;
+bool deArrayOfStructs;
+bool deGroupFields;
+bool deShowFieldGroups;
+bool deElideRefCounting;
 char *deExeName;
 char *deLibDir;
 char *deRunePackageDir;
@@ -140,6 +140,7 @@ static void appendDatatypeString(deString string, deDatatype datatype) {
       deStringPuts(string, "void");
       break;
     case DE_TYPE_MODINT:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_CLASS:
     case DE_TYPE_FUNCPTR:
     case DE_TYPE_TEMPLATE:
@@ -269,6 +270,9 @@ static void declareDatatype(deString headerTop, deDatatype datatype, deLine line
     case DE_TYPE_FUNCPTR:
       deError(line, "RPC calls cannot pass function pointers");
       break;
+    case DE_TYPE_FIXEDARRAY:
+      deError(line, "RPC calls cannot pass fixed-size arrays");
+      break;
     case DE_TYPE_TUPLE:
       declareTupleElementTypes(headerTop, datatype, line);
       break;
@@ -749,6 +753,7 @@ static void decodeParameter(deString server, deString lexpr, deDatatype datatype
     case DE_TYPE_CLASS:
     case DE_TYPE_TEMPLATE:
     case DE_TYPE_MODINT:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_ENUMCLASS:
     case DE_TYPE_EXPR:
       utExit("Unexpected datatype in RPC call");
@@ -881,6 +886,7 @@ static void encodeParameter(deString server, deString expr, deDatatype datatype)
     case DE_TYPE_CLASS:
     case DE_TYPE_TEMPLATE:
     case DE_TYPE_MODINT:
+    case DE_TYPE_FIXEDARRAY:
     case DE_TYPE_ENUMCLASS:
     case DE_TYPE_EXPR:
       utExit("Unexpected datatype in RPC call");
@@ -17,6 +17,18 @@
 numPassed="0"
 numFailed="0"
 
+# Check that each line of the expected compiler output file $1, if it exists,
+# is in the compiler output file $2.  The access weights printed by
+# -showfieldgroups are estimates which change with the builtin packages, so
+# they are not compared.
+compilerOutputMatches() {
+  if [ ! -e "$1" ]; then
+    return 0
+  fi
+  sed 's/ ([0-9]*)//g' "$2" | grep -qvxFf - "$1" && return 1
+  return 0
+}
+
 rm -f tests/*.result tests/*.ll
 
 for outFile in tests/*.stdout; do
@@ -24,19 +36,22 @@ for outFile in tests/*.stdout; do
   resFile=$(echo "$outFile" | sed 's/stdout$/result/')
   inputFile=$(echo "$outFile" | sed 's/stdout$/stdin/')
   argsFile=$(echo "$outFile" | sed 's/stdout$/args/')
+  compilerFile=$(echo "$outFile" | sed 's/stdout$/compiler/')
+  compilerResFile="$compilerFile.result"
   executable=$(echo "$test" | sed 's/\.rn$//')
   args="-g"
   if [ -e "$argsFile" ]; then
     args=`cat $argsFile`
   fi
   if [ -e "$inputFile" ]; then
-    ./rune "$args" "$test" && "./$executable"  > "$resFile" < "$inputFile"
+    ./rune $args "$test" > "$compilerResFile" && "./$executable"  > "$resFile" < "$inputFile"
   else
-    ./rune "$args" "$test" && "./$executable"  > "$resFile"
+    ./rune $args "$test" > "$compilerResFile" && "./$executable"  > "$resFile"
   fi
+  cat "$compilerResFile"
   sed 's/\r$//' -i "$outFile"
   sed 's/\r$//' -i "$resFile"
-  if cmp -s "$outFile" "$resFile"; then
+  if cmp -s "$outFile" "$resFile" && compilerOutputMatches "$compilerFile" "$compilerResFile"; then
     echo "$test passed"
     numPassed=$((numPassed + 1))
   else
@@ -47,7 +62,7 @@ done
 
 for test in errortests/*.rn; do
   executable=$(echo "$test" | sed 's/\.rn$//')
-  result=$(./rune "$args" -x "$test" | grep "Exiting due to error")
+  result=$(./rune $args -x "$test" | grep "Exiting due to error")
   if [[ "$result" == "" ]]; then
     result=$("./$executable" | egrep "(Exception|Panic)")
   fi
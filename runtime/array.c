@@ -186,6 +186,33 @@ void runtime_allocArray(runtime_array *array, size_t numElements, size_t element
   updateArrayBackPointer(array);
 }
 
+// Initialize |array| to hold |numElements| elements in |buffer|, which has
+// room for |bufferWords| words, including the header.  The compiler uses this
+// for temporaries it has proven never escape their statement, with |buffer| on
+// the stack.  Such arrays must never be freed or resized.
+void runtime_initStackArray(runtime_array *array, size_t *buffer, size_t bufferWords,
+    size_t numElements, size_t elementSize) {
+  size_t numWords = runtime_bytesToWords(numElements * elementSize);
+  if (numWords + RN_HEADER_WORDS > bufferWords) {
+    runtime_panicCstr("Stack array buffer is too small");
+  }
+  runtime_heapHeader *header = (runtime_heapHeader*)buffer;
+  runtime_zeroMemory(buffer, numWords + RN_HEADER_WORDS);
+  header->allocatedWords = numWords;
+  header->hasSubArrays = false;
+  array->data = numWords == 0? NULL : buffer + RN_HEADER_WORDS;
+  array->numElements = numElements;
+  updateArrayBackPointer(array);
+}
+
+// Allocate |array| and copy |numElements| elements from |data| into it.  The
+// compiler uses this to print fixed-size arrays, which are stored inline.
+void runtime_initArrayFromData(runtime_array *array, const uint8_t *data,
+    size_t numElements, size_t elementSize) {
+  runtime_allocArray(array, numElements, elementSize, false);
+  runtime_memcopy((uint8_t*)array->data, data, numElements * elementSize);
+}
+
 // Mostly for debugging from C.
 void runtime_arrayInitCstr(runtime_array *array, const char *text) {
   runtime_freeArray(array);
@@ -524,6 +551,14 @@ void runtime_appendArrayElement(runtime_array *array, uint8_t *data, size_t elem
   }
 }
 
+// Move the array |element| to the end of |array|, an array of arrays, leaving
+// |element| empty.  This avoids copying an element that will not be used again.
+void runtime_appendMovedArray(runtime_array *array, runtime_array *element) {
+  size_t numElements = array->numElements;
+  arrayResize(array, numElements + 1, sizeof(runtime_array), true, true);
+  runtime_moveArray((runtime_array*)array->data + numElements, element);
+}
+
 // Copy |source| to the end of |dest|.
 void runtime_concatArrays(runtime_array *dest, runtime_array *source, size_t elementSize, bool hasSubArrays) {
   size_t sourceNumElements = source->numElements;
@@ -0,0 +1,279 @@
+//  Copyright 2024 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Batched constant time bigint operations.  Batch verifiers often perform the
+// same modular operation on thousands of independent values, so we interleave
+// RN_BATCH_LANES values limb by limb, and run Montgomery multiplication on all
+// lanes in lock step.  Each limb of all lanes is one vector, so every step is a
+// vector multiply-add with no data dependent branches.  The vector width is
+// fixed, so on targets with narrower SIMD the compiler splits each operation,
+// e.g. into two AVX2 operations for 8 lanes.
+#include "runtime.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The number of values multiplied in lock step.  8 fills an AVX-512 register.
+#define RN_BATCH_LANES 8
+
+// One limb of every lane, in 64-bit elements.  Limbs are below 2^32 between
+// operations, and multiplies mask their operands to 32 bits, so GCC and clang
+// emit 32x32->64 bit vector multiplies: pmuludq, vpmuludq on AVX2.
+typedef uint64_t runtime_lanes __attribute__((vector_size(8 * RN_BATCH_LANES), aligned(8)));
+
+// Montgomery multiplication state shared by all lanes: an odd modulus in
+// 32-bit limbs, -modulus^-1 mod 2^32, and R^2 mod modulus, where R = 2^(32n).
+typedef struct {
+  uint32_t numLimbs;
+  uint64_t *modulus;
+  uint64_t *r2;
+  uint64_t m0Inv;
+} runtime_montgomery;
+
+// Allocate a zeroed buffer of limbs.
+static uint64_t *allocLimbs(uint32_t numLimbs) {
+  uint64_t *limbs = calloc(numLimbs == 0? 1 : numLimbs, sizeof(uint64_t));
+  if (limbs == NULL) {
+    runtime_panicCstr("Out of memory in batched bigint operation");
+  }
+  return limbs;
+}
+
+// Unpack an unsigned CTTK bigint into 32-bit limbs, stored |stride| apart.
+static void loadLimbs(const runtime_array *bigint, uint64_t *limbs, uint32_t numLimbs,
+    uint32_t stride) {
+  const uint32_t *data = (const uint32_t*)bigint->data;
+  uint32_t numWords = bigint->numElements;
+  for (uint32_t i = 0; i < numLimbs; i++) {
+    limbs[i * stride] = 0;
+  }
+  uint32_t bitPos = 0;
+  for (uint32_t i = 2; i < numWords; i++) {
+    uint64_t word = data[i] & 0x7fffffff;
+    uint32_t limb = bitPos >> 5;
+    uint32_t shift = bitPos & 31;
+    if (limb < numLimbs) {
+      limbs[limb * stride] |= (word << shift) & 0xffffffff;
+      if (shift > 1 && limb + 1 < numLimbs) {
+        limbs[(limb + 1) * stride] |= word >> (32 - shift);
+      }
+    }
+    bitPos += 31;
+  }
+}
+
+// Pack 32-bit limbs stored |stride| apart into |dest| as an unsigned bigint.
+static void storeLimbs(runtime_array *dest, const uint64_t *limbs, uint32_t numLimbs,
+    uint32_t stride, uint32_t width, bool secret) {
+  runtime_integerToBigint(dest, 0, width, false, secret);
+  uint32_t *data = (uint32_t*)dest->data;
+  uint32_t numWords = dest->numElements;
+  uint32_t bitPos = 0;
+  for (uint32_t i = 2; i < numWords; i++) {
+    uint32_t limb = bitPos >> 5;
+    uint32_t shift = bitPos & 31;
+    uint64_t value = limb < numLimbs? limbs[limb * stride] >> shift : 0;
+    if (limb + 1 < numLimbs) {
+      value |= limbs[(limb + 1) * stride] << (32 - shift);
+    }
+    uint32_t word = value & 0x7fffffff;
+    if (bitPos >= width) {
+      word = 0;
+    } else if (bitPos + 31 > width) {
+      word &= (1u << (width - bitPos)) - 1;
+    }
+    data[i] = word;
+    bitPos += 31;
+  }
+}
+
+// Set up Montgomery multiplication for an odd public modulus.
+static void initMontgomery(runtime_montgomery *mont, const runtime_array *modulus,
+    uint32_t numLimbs) {
+  mont->numLimbs = numLimbs;
+  mont->modulus = allocLimbs(numLimbs + 1);
+  mont->r2 = allocLimbs(numLimbs + 1);
+  loadLimbs(modulus, mont->modulus, numLimbs, 1);
+  // Newton iteration doubles the number of correct bits each time.
+  uint32_t m0 = mont->modulus[0];
+  uint32_t inv = 1;
+  for (uint32_t i = 0; i < 5; i++) {
+    inv *= 2 - m0 * inv;
+  }
+  mont->m0Inv = (uint32_t)-inv;
+  // R^2 mod modulus, by doubling 1 a total of 64n times.  The modulus is
+  // public, so this does not need to be constant time.
+  uint64_t *x = mont->r2;
+  x[0] = 1;
+  for (uint32_t i = 0; i < 64 * numLimbs; i++) {
+    uint64_t carry = 0;
+    for (uint32_t j = 0; j <= numLimbs; j++) {
+      uint64_t value = (x[j] << 1) | carry;
+      carry = value >> 32;
+      x[j] = value & 0xffffffff;
+    }
+    bool geq = true;
+    for (int32_t j = numLimbs; j >= 0; j--) {
+      if (x[j] != mont->modulus[j]) {
+        geq = x[j] > mont->modulus[j];
+        break;
+      }
+    }
+    if (geq) {
+      uint64_t borrow = 0;
+      for (uint32_t j = 0; j <= numLimbs; j++) {
+        uint64_t value = x[j] - mont->modulus[j] - borrow;
+        borrow = value >> 63;
+        x[j] = value & 0xffffffff;
+      }
+    }
+  }
+}
+
+// Free Montgomery state.
+static void freeMontgomery(runtime_montgomery *mont) {
+  free(mont->modulus);
+  free(mont->r2);
+}
+
+// Set |r| to a*b*R^-1 mod modulus in every lane, using CIOS Montgomery
+// multiplication.  |a|, |r| and |t| are interleaved, with limb i of lane l at
+// [i*RN_BATCH_LANES + l].  |b| is interleaved unless |bShared| is true, in
+// which case it is a single value used for every lane.  |t| is scratch space
+// of n+2 interleaved limbs.  Either |a| or |b| must be less than the modulus.
+static void montMulLanes(const runtime_montgomery *mont, uint64_t *rLimbs, const uint64_t *aLimbs,
+    const uint64_t *bLimbs, bool bShared, uint64_t *tLimbs) {
+  runtime_lanes *r = (runtime_lanes*)rLimbs;
+  const runtime_lanes *a = (const runtime_lanes*)aLimbs;
+  const runtime_lanes *b = (const runtime_lanes*)bLimbs;
+  runtime_lanes *t = (runtime_lanes*)tLimbs;
+  uint32_t n = mont->numLimbs;
+  const uint64_t *m = mont->modulus;
+  const runtime_lanes low = (runtime_lanes){0} + 0xffffffff;
+  memset(t, 0, (n + 2) * sizeof(runtime_lanes));
+  for (uint32_t i = 0; i < n; i++) {
+    // t += a * b[i].
+    runtime_lanes bi = (bShared? (runtime_lanes){0} + bLimbs[i] : b[i]) & low;
+    runtime_lanes carry = {0};
+    for (uint32_t j = 0; j < n; j++) {
+      runtime_lanes value = t[j] + (a[j] & low) * bi + carry;
+      t[j] = value & low;
+      carry = value >> 32;
+    }
+    runtime_lanes value = t[n] + carry;
+    t[n] = value & low;
+    t[n + 1] = value >> 32;
+    // t = (t + q*m) / 2^32, where q makes the low limb zero.
+    runtime_lanes q = (t[0] * (uint32_t)mont->m0Inv) & low;
+    carry = (t[0] + q * (uint32_t)m[0]) >> 32;
+    for (uint32_t j = 1; j < n; j++) {
+      value = t[j] + q * (uint32_t)m[j] + carry;
+      t[j - 1] = value & low;
+      carry = value >> 32;
+    }
+    value = t[n] + carry;
+    t[n - 1] = value & low;
+    t[n] = t[n + 1] + (value >> 32);
+  }
+  // t < 2*modulus.  Subtract the modulus, and keep the difference unless it
+  // borrowed, selecting with a mask rather than a branch.
+  runtime_lanes borrow = {0};
+  for (uint32_t j = 0; j <= n; j++) {
+    runtime_lanes value = t[j] - m[j] - borrow;
+    borrow = value >> 63;
+    r[j] = value & low;
+  }
+  runtime_lanes keep = -borrow;
+  for (uint32_t j = 0; j < n; j++) {
+    r[j] = (t[j] & keep) | (r[j] & ~keep);
+  }
+}
+
+// Return a pointer to element |index| of an array of bigints.
+static inline runtime_array *getBigintElement(const runtime_array *array, uint64_t index) {
+  return ((runtime_array*)array->data) + index;
+}
+
+// Compute dest[i] = a[i]*b[i] mod modulus for every i, where |a|, |b| and
+// |dest| are arrays of bigints, in constant time.  |dest| is resized to match.
+// Moduli must be public and odd, since we use Montgomery multiplication; even
+// moduli fall back to runtime_bigintModularMul on each element.
+void runtime_bigintModularMulBatch(runtime_array *dest, runtime_array *a, runtime_array *b,
+    runtime_array *modulus) {
+  if (runtime_bigintSecret(modulus)) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,"Modulus cannot be secret");
+  }
+  if (runtime_bigintSigned(modulus)) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,"Modulus must be unsigned");
+  }
+  uint64_t numValues = a->numElements;
+  if (b->numElements != numValues) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,
+        "Batched operands have different lengths");
+  }
+  if (dest->numElements != numValues) {
+    runtime_resizeArray(dest, numValues, sizeof(runtime_array), true);
+  }
+  if (numValues == 0) {
+    return;
+  }
+  const uint32_t *modulusData = (const uint32_t*)modulus->data;
+  if ((modulusData[2] & 1) == 0) {
+    for (uint64_t i = 0; i < numValues; i++) {
+      runtime_bigintModularMul(getBigintElement(dest, i), getBigintElement(a, i),
+          getBigintElement(b, i), modulus);
+    }
+    return;
+  }
+  // Every element must have a's width, or loadLimbs would truncate wider ones.
+  uint32_t width = runtime_bigintWidth(getBigintElement(a, 0));
+  for (uint64_t i = 0; i < numValues; i++) {
+    if (runtime_bigintWidth(getBigintElement(a, i)) != width ||
+        runtime_bigintWidth(getBigintElement(b, i)) != width) {
+      runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,
+          "Batched operands have different widths");
+    }
+  }
+  uint32_t modWidth = runtime_bigintWidth(modulus);
+  uint32_t numLimbs = ((width > modWidth? width : modWidth) + 31) / 32;
+  runtime_montgomery mont;
+  initMontgomery(&mont, modulus, numLimbs);
+  const uint32_t L = RN_BATCH_LANES;
+  uint64_t *aLanes = allocLimbs((numLimbs + 1) * L);
+  uint64_t *bLanes = allocLimbs((numLimbs + 1) * L);
+  uint64_t *rLanes = allocLimbs((numLimbs + 1) * L);
+  uint64_t *t = allocLimbs((numLimbs + 2) * L);
+  for (uint64_t first = 0; first < numValues; first += L) {
+    uint32_t lanes = numValues - first < L? numValues - first : L;
+    memset(aLanes, 0, (numLimbs + 1) * L * sizeof(uint64_t));
+    memset(bLanes, 0, (numLimbs + 1) * L * sizeof(uint64_t));
+    for (uint32_t l = 0; l < lanes; l++) {
+      loadLimbs(getBigintElement(a, first + l), aLanes + l, numLimbs, L);
+      loadLimbs(getBigintElement(b, first + l), bLanes + l, numLimbs, L);
+    }
+    // Convert a to Montgomery form, then a*R * b * R^-1 = a*b.
+    montMulLanes(&mont, rLanes, aLanes, mont.r2, true, t);
+    montMulLanes(&mont, rLanes, rLanes, bLanes, false, t);
+    for (uint32_t l = 0; l < lanes; l++) {
+      bool secret = runtime_bigintSecret(getBigintElement(a, first + l)) ||
+          runtime_bigintSecret(getBigintElement(b, first + l));
+      // Storing may resize the element, so look it up each time.
+      storeLimbs(getBigintElement(dest, first + l), rLanes + l, numLimbs, L, width, secret);
+    }
+  }
+  free(aLanes);
+  free(bLanes);
+  free(rLanes);
+  free(t);
+  freeMontgomery(&mont);
+}
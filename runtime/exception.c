@@ -0,0 +1,228 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Table-based exception handling.  Rune try statements are compiled to LLVM
+// invoke and landingpad instructions, and LLVM writes a language specific data
+// area (LSDA) for each function listing which call sites land where.  Raising
+// an exception calls the system unwinder, which calls runtime_personality for
+// each frame.  Nothing runs on the non-throwing path.
+//
+// There is only one Rune exception in flight at a time, and its data lives in
+// the runtimeException global, so the unwinder's exception object is static.
+// Every Rune landing pad catches everything, so we never need the LSDA type
+// table.
+
+#include "runtime.h"
+
+#include <unwind.h>
+
+// "RUNE\0\0\0\0", in the vendor/language layout the Itanium ABI suggests.
+#define RN_EXCEPTION_CLASS 0x52554e4500000000ULL
+
+// DWARF pointer encodings used in the LSDA.
+#define RN_DW_EH_PE_absptr 0x00
+#define RN_DW_EH_PE_uleb128 0x01
+#define RN_DW_EH_PE_udata2 0x02
+#define RN_DW_EH_PE_udata4 0x03
+#define RN_DW_EH_PE_udata8 0x04
+#define RN_DW_EH_PE_sleb128 0x09
+#define RN_DW_EH_PE_sdata2 0x0a
+#define RN_DW_EH_PE_sdata4 0x0b
+#define RN_DW_EH_PE_sdata8 0x0c
+#define RN_DW_EH_PE_pcrel 0x10
+#define RN_DW_EH_PE_indirect 0x80
+#define RN_DW_EH_PE_omit 0xff
+
+static struct _Unwind_Exception runtime_exceptionObject;
+
+// Read an unsigned LEB128 value.
+static uintptr_t readULEB128(const uint8_t **p) {
+  uintptr_t result = 0;
+  uint32_t shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*p)++;
+    result |= (uintptr_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return result;
+}
+
+// Read a signed LEB128 value.
+static intptr_t readSLEB128(const uint8_t **p) {
+  uintptr_t result = 0;
+  uint32_t shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*p)++;
+    result |= (uintptr_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  if ((byte & 0x40) && shift < sizeof(result) * 8) {
+    result |= ~(uintptr_t)0 << shift;
+  }
+  return (intptr_t)result;
+}
+
+// Read a value written with DWARF pointer |encoding|.  The LSDA is not
+// necessarily aligned, so fixed size values are copied byte by byte.
+static uintptr_t readEncodedPointer(const uint8_t **p, uint8_t encoding) {
+  const uint8_t *start = *p;
+  uintptr_t result;
+  if (encoding == RN_DW_EH_PE_omit) {
+    return 0;
+  }
+  switch (encoding & 0x0f) {
+    case RN_DW_EH_PE_absptr: {
+      memcpy(&result, *p, sizeof(uintptr_t));
+      *p += sizeof(uintptr_t);
+      break;
+    }
+    case RN_DW_EH_PE_uleb128:
+      result = readULEB128(p);
+      break;
+    case RN_DW_EH_PE_sleb128:
+      result = (uintptr_t)readSLEB128(p);
+      break;
+    case RN_DW_EH_PE_udata2: {
+      uint16_t value;
+      memcpy(&value, *p, sizeof(value));
+      *p += sizeof(value);
+      result = value;
+      break;
+    }
+    case RN_DW_EH_PE_udata4: {
+      uint32_t value;
+      memcpy(&value, *p, sizeof(value));
+      *p += sizeof(value);
+      result = value;
+      break;
+    }
+    case RN_DW_EH_PE_udata8: {
+      uint64_t value;
+      memcpy(&value, *p, sizeof(value));
+      *p += sizeof(value);
+      result = (uintptr_t)value;
+      break;
+    }
+    case RN_DW_EH_PE_sdata2: {
+      int16_t value;
+      memcpy(&value, *p, sizeof(value));
+      *p += sizeof(value);
+      result = (uintptr_t)(intptr_t)value;
+      break;
+    }
+    case RN_DW_EH_PE_sdata4: {
+      int32_t value;
+      memcpy(&value, *p, sizeof(value));
+      *p += sizeof(value);
+      result = (uintptr_t)(intptr_t)value;
+      break;
+    }
+    case RN_DW_EH_PE_sdata8: {
+      int64_t value;
+      memcpy(&value, *p, sizeof(value));
+      *p += sizeof(value);
+      result = (uintptr_t)value;
+      break;
+    }
+    default:
+      runtime_panicCstr("Unsupported LSDA pointer encoding %u", encoding);
+      return 0;
+  }
+  if (result != 0) {
+    if ((encoding & 0x70) == RN_DW_EH_PE_pcrel) {
+      result += (uintptr_t)start;
+    }
+    if (encoding & RN_DW_EH_PE_indirect) {
+      result = *(uintptr_t *)result;
+    }
+  }
+  return result;
+}
+
+// Find the landing pad covering |ip| in the LSDA.  Return 0 if the call site
+// has no landing pad, meaning the exception should keep unwinding.
+static uintptr_t findLandingPad(const uint8_t *lsda, uintptr_t funcStart, uintptr_t ip) {
+  const uint8_t *p = lsda;
+  uintptr_t landingPadStart = funcStart;
+  uint8_t lpStartEncoding = *p++;
+  if (lpStartEncoding != RN_DW_EH_PE_omit) {
+    landingPadStart = readEncodedPointer(&p, lpStartEncoding);
+  }
+  uint8_t typeEncoding = *p++;
+  if (typeEncoding != RN_DW_EH_PE_omit) {
+    readULEB128(&p);  // Offset of the type table, which we do not use.
+  }
+  uint8_t callSiteEncoding = *p++;
+  uintptr_t callSiteTableLength = readULEB128(&p);
+  const uint8_t *callSiteTableEnd = p + callSiteTableLength;
+  while (p < callSiteTableEnd) {
+    uintptr_t start = readEncodedPointer(&p, callSiteEncoding);
+    uintptr_t length = readEncodedPointer(&p, callSiteEncoding);
+    uintptr_t landingPad = readEncodedPointer(&p, callSiteEncoding);
+    readULEB128(&p);  // Action: every Rune landing pad catches everything.
+    if (ip < funcStart + start) {
+      // The table is sorted by start address.
+      return 0;
+    }
+    if (ip < funcStart + start + length) {
+      return landingPad == 0? 0 : landingPadStart + landingPad;
+    }
+  }
+  return 0;
+}
+
+// The personality routine named by every Rune function containing a try
+// statement.  Only Rune exceptions are caught.
+_Unwind_Reason_Code runtime_personality(int version, _Unwind_Action actions,
+    uint64_t exceptionClass, struct _Unwind_Exception *exceptionObject,
+    struct _Unwind_Context *context) {
+  if (version != 1) {
+    return _URC_FATAL_PHASE1_ERROR;
+  }
+  if (exceptionClass != RN_EXCEPTION_CLASS) {
+    return _URC_CONTINUE_UNWIND;
+  }
+  const uint8_t *lsda = (const uint8_t *)_Unwind_GetLanguageSpecificData(context);
+  if (lsda == NULL) {
+    return _URC_CONTINUE_UNWIND;
+  }
+  int ipBeforeInstruction = 0;
+  uintptr_t ip = _Unwind_GetIPInfo(context, &ipBeforeInstruction);
+  if (!ipBeforeInstruction) {
+    // The return address points after the call.
+    ip--;
+  }
+  uintptr_t landingPad = findLandingPad(lsda, _Unwind_GetRegionStart(context), ip);
+  if (landingPad == 0) {
+    return _URC_CONTINUE_UNWIND;
+  }
+  if (actions & _UA_SEARCH_PHASE) {
+    return _URC_HANDLER_FOUND;
+  }
+  _Unwind_SetGR(context, __builtin_eh_return_data_regno(0), (uintptr_t)exceptionObject);
+  _Unwind_SetGR(context, __builtin_eh_return_data_regno(1), 1);
+  _Unwind_SetIP(context, landingPad);
+  return _URC_INSTALL_CONTEXT;
+}
+
+// Unwind to the nearest enclosing try statement.  runtimeException must
+// already be filled out.  This returns only if no try statement catches the
+// exception, in which case the caller reports it and exits.
+void runtime_throwException(void) {
+  runtime_exceptionObject.exception_class = RN_EXCEPTION_CLASS;
+  runtime_exceptionObject.exception_cleanup = NULL;
+  _Unwind_RaiseException(&runtime_exceptionObject);
+}
@@ -31,7 +31,7 @@ bool runtime_jmpBufSet = false;
 
 // This will exit if runtime_setLongJmp() has not been called.  Otherwise, it will
 // long-jump to runtime_jmpBuf.
-static void exitOrLongjmp() {
+static __attribute__((noreturn)) void exitOrLongjmp() {
   if (runtime_jmpBufSet) {
     runtime_jmpBufSet = false;
     longjmp(runtime_jmpBuf, 1);
@@ -221,13 +221,12 @@ void runtime_raiseException(const runtime_array *enumClassName, const runtime_ar
   runtimeException.errorMessage = runtime_makeEmptyArray();
   runtime_vsprintf(&runtimeException.errorMessage, format, ap);
   va_end(ap);
-  if (runtime_firstSetjmpBuffer != NULL) {
-    runtimeException.errorEnumName = *enumClassName;
-    runtimeException.errorValueName = *enumValueName;
-    runtimeException.filePath = *filePath;
-    runtimeException.line = line;
-    longjmp(runtime_firstSetjmpBuffer->buf, 1);
-  }
+  runtimeException.errorEnumName = *enumClassName;
+  runtimeException.errorValueName = *enumValueName;
+  runtimeException.filePath = *filePath;
+  runtimeException.line = line;
+  // This only returns if no try statement catches the exception.
+  runtime_throwException();
   if (runtime_jmpBufSet) {
     printf("Expected ");
   }
@@ -249,13 +248,11 @@ void runtime_raiseExceptionCstr(const char *exceptionName, const char *fileName,
   char buf[RN_MAX_CSTRING];
   vsnprintf(buf, RN_MAX_CSTRING, format, ap);
   va_end(ap);
-  if (runtime_firstSetjmpBuffer != NULL) {
-    runtime_arrayInitCstr(&runtimeException.errorEnumName, "Exception");
-    runtime_arrayInitCstr(&runtimeException.errorValueName, exceptionName);
-    runtime_arrayInitCstr(&runtimeException.filePath, fileName);
-    runtimeException.line = line;
-    longjmp(runtime_firstSetjmpBuffer->buf, 1);
-  }
+  runtime_arrayInitCstr(&runtimeException.errorEnumName, "Exception");
+  runtime_arrayInitCstr(&runtimeException.errorValueName, exceptionName);
+  runtime_arrayInitCstr(&runtimeException.filePath, fileName);
+  runtimeException.line = line;
+  runtime_throwException();
   runtime_putsCstr("Exception: ");
   runtime_putsCstr(buf);
   runtime_putsCstr("\n");
@@ -906,35 +903,48 @@ void runtime_printf(const char *format, ...) {
   runtime_freeArray(&formatArray);
 }
 
-// Convert an integer to a string.
-void runtime_nativeIntToString(runtime_array *string, uint64_t value, uint32_t base, bool isSigned) {
-  runtime_freeArray(string);
+// The longest native integer string: a negative 64-bit value in base 2.
+#define RN_MAX_INT_STRING_LENGTH 65
+
+// Write the digits of |value| to the end of |buf|, which has room for
+// RN_MAX_INT_STRING_LENGTH characters.  Return the start of the digits.
+static uint8_t *formatNativeInt(uint8_t *buf, uint64_t value, uint32_t base, bool isSigned) {
+  uint8_t *p = buf + RN_MAX_INT_STRING_LENGTH;
   bool negated = false;
   if (isSigned && (int64_t)value < 0) {
     negated = true;
     value = -value;
   }
-  if (value == 0) {
-    uint8_t c = '0';
-    runtime_appendArrayElement(string, &c, sizeof(uint8_t), false, false);
-    return;
-  }
-  while (value != 0) {
+  do {
     uint64_t digit = value % base;
     value /= base;
-    uint8_t c;
-    if (digit > 9) {
-      c = 'a' + digit - 10;
-    } else {
-      c = '0' + digit;
-    }
-    runtime_appendArrayElement(string, &c, sizeof(uint8_t), false, false);
-  }
+    *--p = digit > 9? 'a' + digit - 10 : '0' + digit;
+  } while (value != 0);
   if (negated) {
-    uint8_t c = '-';
-    runtime_appendArrayElement(string, &c, sizeof(uint8_t), false, false);
+    *--p = '-';
   }
-  runtime_reverseArray(string, sizeof(uint8_t), false);
+  return p;
+}
+
+// Convert an integer to a string.
+void runtime_nativeIntToString(runtime_array *string, uint64_t value, uint32_t base, bool isSigned) {
+  runtime_freeArray(string);
+  uint8_t buf[RN_MAX_INT_STRING_LENGTH];
+  uint8_t *digits = formatNativeInt(buf, value, base, isSigned);
+  size_t length = buf + RN_MAX_INT_STRING_LENGTH - digits;
+  runtime_allocArray(string, length, sizeof(uint8_t), false);
+  memcpy(string->data, digits, length);
+}
+
+// Convert an integer to a string held in |buffer|, which is on the caller's
+// stack.  The string must not be freed.
+void runtime_nativeIntToStackString(runtime_array *string, size_t *buffer, size_t bufferWords,
+    uint64_t value, uint32_t base, bool isSigned) {
+  uint8_t buf[RN_MAX_INT_STRING_LENGTH];
+  uint8_t *digits = formatNativeInt(buf, value, base, isSigned);
+  size_t length = buf + RN_MAX_INT_STRING_LENGTH - digits;
+  runtime_initStackArray(string, buffer, bufferWords, length, sizeof(uint8_t));
+  memcpy(string->data, digits, length);
 }
 
 // Convert a bigint to ASCII, using the base.
@@ -16,4 +16,3 @@
 #include "runtime.h"
 
 struct ExceptionStruct runtimeException;
-struct jmpbuf_wrapped *runtime_firstSetjmpBuffer;
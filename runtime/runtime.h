@@ -43,6 +43,11 @@
 // TODO: Store the list in an runtime_array and allow it to grow dynamically.,
 #define RN_MAX_CSTRING 1024u
 
+// Error paths that never return.  Generated code declares these the same way,
+// and the attributes must also be on the definitions, which replace those
+// declarations when the runtime is linked as bitcode.
+#define RN_COLD_NORETURN __attribute__((cold, noreturn))
+
 // These are primitive element types.  They are needed for array comparison.
 typedef enum {
   RN_UINT,
@@ -99,6 +104,10 @@ void runtime_initArrayOfStringsFromCUTF8(runtime_array *array, const uint8_t **v
 void runtime_allocArray(runtime_array *array, size_t numElements, size_t elementSize,
     bool hasSubArrays);
 void runtime_arrayInitCstr(runtime_array *array, const char *text);
+void runtime_initStackArray(runtime_array *array, size_t *buffer, size_t bufferWords,
+    size_t numElements, size_t elementSize);
+void runtime_initArrayFromData(runtime_array *array, const uint8_t *data,
+    size_t numElements, size_t elementSize);
 void runtime_resizeArray(runtime_array *array, uint64_t numElements, size_t elementSize,
     bool hasSubArrays);
 void runtime_copyArray(runtime_array *dest, runtime_array *source, size_t elementSize,
@@ -113,6 +122,7 @@ void runtime_updateArrayBackPointer(runtime_array *array);
 void runtime_compactArrayHeap(void);
 void runtime_appendArrayElement(runtime_array *array, uint8_t *data, size_t elementSize,
     bool isArray, bool hasSubArrays);
+void runtime_appendMovedArray(runtime_array *array, runtime_array *element);
 void runtime_concatArrays(runtime_array *dest, runtime_array *source, size_t elementSize,
     bool hasSubArrays);
 void runtime_xorStrings(runtime_array *dest, runtime_array *a, runtime_array *b);
@@ -149,16 +159,18 @@ void runtime_putsCstr(const char *string);
 void runtime_sprintf(runtime_array *array, const runtime_array *format, ...);
 void runtime_printf(const char *format, ...);
 void runtime_vsprintf(runtime_array *array, const runtime_array *format, va_list ap);
-void runtime_raiseException(const runtime_array *enumClassName,
+RN_COLD_NORETURN void runtime_raiseException(const runtime_array *enumClassName,
                             const runtime_array *enumValueName,
                             const runtime_array *filePath, uint32_t line,
                             const runtime_array *format, ...);
-void runtime_raiseExceptionCstr(const char *exceptionName, const char *fileName, uint32_t line,
-    const char *format, ...);
-void runtime_raiseOverflow();
-void runtime_panic(const runtime_array *format, ...);
-void runtime_panicCstr(const char *format, ...);
+RN_COLD_NORETURN void runtime_raiseExceptionCstr(const char *exceptionName,
+    const char *fileName, uint32_t line, const char *format, ...);
+RN_COLD_NORETURN void runtime_raiseOverflow();
+RN_COLD_NORETURN void runtime_panic(const runtime_array *format, ...);
+RN_COLD_NORETURN void runtime_panicCstr(const char *format, ...);
 void runtime_nativeIntToString(runtime_array *string, uint64_t value, uint32_t base, bool isSigned);
+void runtime_nativeIntToStackString(runtime_array *string, size_t *buffer, size_t bufferWords,
+    uint64_t value, uint32_t base, bool isSigned);
 void runtime_bigintToString(runtime_array *string, runtime_array *bigint, uint32_t base);
 void runtime_stringToHex(runtime_array *destHexString, const runtime_array *sourceBinString);
 void runtime_hexToString(runtime_array *destBinString, const runtime_array *sourceHexString);
@@ -285,6 +297,34 @@ static inline void runtime_copyBigint(runtime_array *dest, runtime_array *source
   runtime_copyArray(dest, source, sizeof(uint32_t), false);
 }
 
+// Variable time bigint APIs, for values that are not secret.  These use the
+// same representation as the constant time APIs above.
+void runtime_bigintMulVartime(runtime_array *dest, runtime_array *a, runtime_array *b);
+void runtime_bigintMulTruncVartime(runtime_array *dest, runtime_array *a, runtime_array *b);
+void runtime_bigintDivVartime(runtime_array *dest, runtime_array *a, runtime_array *b);
+void runtime_bigintModVartime(runtime_array *dest, runtime_array *a, runtime_array *b);
+void runtime_bigintExpVartime(runtime_array *dest, runtime_array *base, uint32_t exponent);
+void runtime_bigintModularMulVartime(runtime_array *dest, runtime_array *a, runtime_array *b, runtime_array *modulus);
+void runtime_bigintModularExpVartime(runtime_array *dest, runtime_array *base, runtime_array *exponent, runtime_array *modulus);
+
+// Constant time subquadratic multiplication for very wide bigints.  Products
+// at least RN_KARATSUBA_MIN_WIDTH bits wide use Karatsuba, and at least
+// RN_TOOM3_MIN_WIDTH bits wide use Toom-3.  The code generator picks the entry
+// point with these, and widemul.c picks the algorithm for sub-products.  One
+// level of Toom-3 over Karatsuba first beats Karatsuba alone at 18432 bits, by
+// 2%, and by 6% at 24576 bits.  See benchmarks/results.md, and runtime_bench's
+// bigintMulKaratsuba and bigintMulToom3 records to check it on other machines.
+#define RN_KARATSUBA_MIN_WIDTH 3072
+#define RN_TOOM3_MIN_WIDTH 18432
+void runtime_bigintMulKaratsuba(runtime_array *dest, runtime_array *a, runtime_array *b);
+void runtime_bigintMulTruncKaratsuba(runtime_array *dest, runtime_array *a, runtime_array *b);
+void runtime_bigintMulToom3(runtime_array *dest, runtime_array *a, runtime_array *b);
+void runtime_bigintMulTruncToom3(runtime_array *dest, runtime_array *a, runtime_array *b);
+
+// Batched constant time modular operations on arrays of bigints.
+void runtime_bigintModularMulBatch(runtime_array *dest, runtime_array *a, runtime_array *b,
+    runtime_array *modulus);
+
 // Small secret integer APIs.  Are any other operations non-constant anywhere?
 uint64_t runtime_smallnumMul(uint64_t a, uint64_t b, bool isSigned, bool secret);
 uint64_t runtime_smallnumDiv(uint64_t a, uint64_t b, bool isSigned, bool secret);
@@ -315,12 +355,8 @@ void runtime_bigintCondCopy(runtime_bool doCopy, runtime_array *dest, const runt
 extern jmp_buf runtime_jmpBuf;
 extern bool runtime_jmpBufSet;
 
-// Used for exception handling.
-struct jmpbuf_wrapped {
-  jmp_buf buf;
-  struct jmpbuf_wrapped *wrapped_buf;
-};
-extern struct jmpbuf_wrapped *runtime_firstSetjmpBuffer;
+// Used for exception handling.  See exception.c.
+void runtime_throwException(void);
 
 // Declare the type of runtimeException so we can fill it out.
 struct ExceptionStruct {
@@ -318,6 +318,107 @@ static void testBigintModularExp(void) {
   runtime_freeArray(&res);
 }
 
+// Test that the variable time bigint functions match the constant time ones.
+// 4096-bit operands are wide enough to use Karatsuba.
+static void testBigintVartime(void) {
+  runtime_array modulus = runtime_makeEmptyArray();
+  initBigintTo25519(&modulus);
+  runtime_array a = runtime_makeEmptyArray();
+  runtime_array b = runtime_makeEmptyArray();
+  runtime_array expected = runtime_makeEmptyArray();
+  runtime_array result = runtime_makeEmptyArray();
+  runtime_integerToBigint(&a, 0xdeadbeefcafef00dull, 4096, false, false);
+  runtime_bigintExp(&a, &a, 60);
+  runtime_integerToBigint(&b, 0x123456789abcdefull, 4096, false, false);
+  runtime_bigintExp(&b, &b, 3);
+  runtime_bigintMul(&expected, &a, &b);
+  runtime_bigintMulVartime(&result, &a, &b);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_bigintMulTrunc(&expected, &a, &a);
+  runtime_bigintMulTruncVartime(&result, &a, &a);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_bigintDiv(&expected, &a, &b);
+  runtime_bigintDivVartime(&result, &a, &b);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_bigintMod(&expected, &a, &b);
+  runtime_bigintModVartime(&result, &a, &b);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_integerToBigint(&a, 12345, 255, false, false);
+  runtime_integerToBigint(&b, 0xfedcba987654321ull, 255, false, false);
+  runtime_bigintModularMul(&expected, &a, &b, &modulus);
+  runtime_bigintModularMulVartime(&result, &a, &b, &modulus);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_bigintModularExp(&expected, &a, &b, &modulus);
+  runtime_bigintModularExpVartime(&result, &a, &b, &modulus);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_freeArray(&modulus);
+  runtime_freeArray(&a);
+  runtime_freeArray(&b);
+  runtime_freeArray(&expected);
+  runtime_freeArray(&result);
+}
+
+// Test that Karatsuba and Toom-3 match CTTK's multiplication, on signed secret
+// values.
+static void testBigintWideMul(void) {
+  runtime_array a = runtime_makeEmptyArray();
+  runtime_array b = runtime_makeEmptyArray();
+  runtime_array expected = runtime_makeEmptyArray();
+  runtime_array result = runtime_makeEmptyArray();
+  runtime_integerToBigint(&a, -0x123456789abcdefll, 8192, true, true);
+  runtime_bigintExp(&a, &a, 60);
+  runtime_integerToBigint(&b, 0xfedcba987654321ll, 8192, true, true);
+  runtime_bigintExp(&b, &b, 61);
+  runtime_bigintMul(&expected, &a, &b);
+  runtime_bigintMulKaratsuba(&result, &a, &b);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_bigintMulToom3(&result, &a, &b);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_bigintMulTrunc(&expected, &a, &expected);
+  runtime_bigintMulTruncKaratsuba(&result, &a, &result);
+  assert(runtime_compareBigints(RN_EQUAL, &result, &expected));
+  runtime_freeArray(&a);
+  runtime_freeArray(&b);
+  runtime_freeArray(&expected);
+  runtime_freeArray(&result);
+}
+
+// Test that batched modular multiplication matches runtime_bigintModularMul on
+// each element, including a partial final batch of lanes.
+static void testBigintModularMulBatch(void) {
+  uint32_t numValues = 11;
+  runtime_array modulus = runtime_makeEmptyArray();
+  runtime_array a = runtime_makeEmptyArray();
+  runtime_array b = runtime_makeEmptyArray();
+  runtime_array dest = runtime_makeEmptyArray();
+  runtime_array expected = runtime_makeEmptyArray();
+  runtime_integerToBigint(&modulus, 0xffffffffffffffc5ull, 255, false, false);
+  runtime_bigintExp(&modulus, &modulus, 3);
+  runtime_resizeArray(&a, numValues, sizeof(runtime_array), true);
+  runtime_resizeArray(&b, numValues, sizeof(runtime_array), true);
+  for (uint32_t i = 0; i < numValues; i++) {
+    runtime_array *aElement = ((runtime_array*)a.data) + i;
+    runtime_array *bElement = ((runtime_array*)b.data) + i;
+    runtime_integerToBigint(aElement, 0x123456789abcdefull * (i + 1), 255, false, true);
+    runtime_bigintExp(aElement, aElement, 2);
+    runtime_integerToBigint(bElement, 0xfedcba987654321ull - i, 255, false, true);
+  }
+  runtime_bigintModularMulBatch(&dest, &a, &b, &modulus);
+  assert(dest.numElements == numValues);
+  for (uint32_t i = 0; i < numValues; i++) {
+    runtime_array *result = ((runtime_array*)dest.data) + i;
+    runtime_bigintModularMul(&expected, ((runtime_array*)a.data) + i,
+        ((runtime_array*)b.data) + i, &modulus);
+    assert(runtime_bigintSecret(result));
+    assert(runtime_compareBigints(RN_EQUAL, result, &expected));
+  }
+  runtime_freeArray(&modulus);
+  runtime_freeArray(&a);
+  runtime_freeArray(&b);
+  runtime_freeArray(&dest);
+  runtime_freeArray(&expected);
+}
+
 // Test the Bigint API.
 static void testBigints(void) {
   testIntegerConversion();
@@ -332,6 +433,9 @@ static void testBigints(void) {
   testBigintModularInverse();
   testBigintModularDiv();
   testBigintModularExp();
+  testBigintVartime();
+  testBigintWideMul();
+  testBigintModularMulBatch();
 }
 
 // Test the Smallnum API.
@@ -0,0 +1,613 @@
+//  Copyright 2024 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Variable time bigint runtime functions for values that are not secret.
+// Bigints are still stored in the CTTK format used by bigint.c, so they can be
+// passed freely between the two APIs.  Operands are unpacked into 64-bit limbs
+// holding a magnitude plus a sign, and we use 128-bit intermediates, skip zero
+// limbs, and switch to Karatsuba for wide operands.  None of this is constant
+// time, so every entry point falls back to the CTTK version if it is handed a
+// secret, though the code generator should never let that happen.
+#include "runtime.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Operands with at least this many 64-bit limbs are multiplied with Karatsuba.
+#define RN_KARATSUBA_THRESHOLD 32
+
+typedef unsigned __int128 runtime_doubleLimb;
+
+// Return the number of 64-bit limbs needed to hold |width| bits.
+static inline uint32_t widthToLimbs(uint32_t width) {
+  return (width + 63) / 64;
+}
+
+// Allocate a zeroed buffer of 64-bit limbs.
+static uint64_t *allocLimbs(uint32_t numLimbs) {
+  uint64_t *limbs = calloc(numLimbs == 0? 1 : numLimbs, sizeof(uint64_t));
+  if (limbs == NULL) {
+    runtime_panicCstr("Out of memory in variable time bigint operation");
+  }
+  return limbs;
+}
+
+// Return the number of limbs after dropping leading zero limbs.
+static inline uint32_t normalizedLength(const uint64_t *a, uint32_t len) {
+  while (len > 0 && a[len - 1] == 0) {
+    len--;
+  }
+  return len;
+}
+
+// Negate a two's complement value in place.
+static void negateLimbs(uint64_t *a, uint32_t len) {
+  uint64_t carry = 1;
+  for (uint32_t i = 0; i < len; i++) {
+    uint64_t value = ~a[i] + carry;
+    carry = carry && value == 0;
+    a[i] = value;
+  }
+}
+
+// Throw the same exception the CTTK path throws when a result does not fit.
+static void raiseNAN(void) {
+  runtime_raiseExceptionCstr("NotANumber", __FILE__, __LINE__,
+      "Bigint was set to NaN");
+}
+
+// Throw an exception if |a| and |b| have different size or if one is signed and
+// the other is not.
+static void checkSameType(const runtime_array *a, const runtime_array *b) {
+  if (a->data == NULL || b->data == NULL) {
+    runtime_panicCstr("Null array passed to variable time bigint operation");
+  }
+  if (runtime_bigintWidth(a) != runtime_bigintWidth(b) ||
+      runtime_bigintSigned(a) != runtime_bigintSigned(b)) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,
+        "Different bigint types in binary operation");
+  }
+}
+
+// Unpack a CTTK bigint into |numLimbs| 64-bit limbs holding its magnitude, and
+// return true if it is negative.  |numLimbs| must be large enough to hold the
+// bigint's width.
+static bool loadBigint(const runtime_array *bigint, uint64_t *limbs, uint32_t numLimbs) {
+  const uint32_t *data = (const uint32_t*)bigint->data;
+  uint32_t numWords = bigint->numElements;
+  bool negative = (data[numWords - 1] >> 30) != 0;
+  memset(limbs, 0, numLimbs * sizeof(uint64_t));
+  uint32_t bitPos = 0;
+  for (uint32_t i = 2; i < numWords; i++) {
+    uint64_t word = data[i] & 0x7fffffff;
+    uint32_t limb = bitPos >> 6;
+    uint32_t shift = bitPos & 63;
+    if (limb < numLimbs) {
+      limbs[limb] |= word << shift;
+      if (shift > 33 && limb + 1 < numLimbs) {
+        limbs[limb + 1] |= word >> (64 - shift);
+      }
+    }
+    bitPos += 31;
+  }
+  if (negative) {
+    // Sign extend, then negate to find the magnitude.
+    uint32_t limb = bitPos >> 6;
+    if (limb < numLimbs) {
+      limbs[limb] |= ~(uint64_t)0 << (bitPos & 63);
+      for (limb++; limb < numLimbs; limb++) {
+        limbs[limb] = ~(uint64_t)0;
+      }
+    }
+    negateLimbs(limbs, numLimbs);
+  }
+  return negative;
+}
+
+// Return the limb at |index| of a two's complement value, sign extending past
+// the end.
+static inline uint64_t getLimb(const uint64_t *limbs, uint32_t numLimbs, uint32_t index, bool negative) {
+  if (index < numLimbs) {
+    return limbs[index];
+  }
+  return negative? ~(uint64_t)0 : 0;
+}
+
+// Return true if the magnitude fits in the given integer type.
+static bool magnitudeFits(const uint64_t *limbs, uint32_t numLimbs, bool negative,
+    uint32_t width, bool isSigned) {
+  uint32_t len = normalizedLength(limbs, numLimbs);
+  if (len == 0) {
+    return true;
+  }
+  if (negative && !isSigned) {
+    return false;
+  }
+  uint32_t bits = 64 * (len - 1) + 64 - __builtin_clzll(limbs[len - 1]);
+  uint32_t maxBits = isSigned? width - 1 : width;
+  if (bits <= maxBits) {
+    return true;
+  }
+  // The only other value that fits is -2^(width-1).
+  if (!isSigned || !negative || bits != width) {
+    return false;
+  }
+  for (uint32_t i = 0; i < len - 1; i++) {
+    if (limbs[i] != 0) {
+      return false;
+    }
+  }
+  return (limbs[len - 1] & (limbs[len - 1] - 1)) == 0;
+}
+
+// Pack a magnitude and sign into |dest| as a CTTK bigint of the given type.
+// Raise an exception if it does not fit, unless |truncate| is true, in which
+// case we keep the low |width| bits, like the CTTK *_trunc functions.  This
+// destroys the contents of |limbs|.
+static void storeBigint(runtime_array *dest, uint64_t *limbs, uint32_t numLimbs,
+    bool negative, uint32_t width, bool isSigned, bool truncate) {
+  if (!truncate && !magnitudeFits(limbs, numLimbs, negative, width, isSigned)) {
+    raiseNAN();
+  }
+  if (negative) {
+    negateLimbs(limbs, numLimbs);
+  }
+  bool signBit = false;
+  if (isSigned) {
+    uint32_t pos = width - 1;
+    signBit = (getLimb(limbs, numLimbs, pos >> 6, negative) >> (pos & 63)) & 1;
+  }
+  runtime_integerToBigint(dest, 0, width, isSigned, false);
+  uint32_t *data = (uint32_t*)dest->data;
+  uint32_t numWords = dest->numElements;
+  uint32_t bitPos = 0;
+  for (uint32_t i = 2; i < numWords; i++) {
+    uint32_t limb = bitPos >> 6;
+    uint32_t shift = bitPos & 63;
+    uint64_t value = getLimb(limbs, numLimbs, limb, negative) >> shift;
+    if (shift > 33) {
+      value |= getLimb(limbs, numLimbs, limb + 1, negative) << (64 - shift);
+    }
+    uint32_t word = value & 0x7fffffff;
+    // Bits at and above |width| are copies of the sign bit.
+    if (bitPos >= width) {
+      word = signBit? 0x7fffffff : 0;
+    } else if (bitPos + 31 > width) {
+      uint32_t highMask = ~((1u << (width - bitPos)) - 1) & 0x7fffffff;
+      word = signBit? word | highMask : word & ~highMask;
+    }
+    data[i] = word;
+    bitPos += 31;
+  }
+}
+
+// Add |b| into |a|, where |bLen| <= |aLen|.  Return the carry out.
+static uint64_t addLimbs(uint64_t *a, uint32_t aLen, const uint64_t *b, uint32_t bLen) {
+  uint64_t carry = 0;
+  uint32_t i = 0;
+  for (; i < bLen; i++) {
+    runtime_doubleLimb sum = (runtime_doubleLimb)a[i] + b[i] + carry;
+    a[i] = (uint64_t)sum;
+    carry = (uint64_t)(sum >> 64);
+  }
+  for (; carry != 0 && i < aLen; i++) {
+    a[i]++;
+    carry = a[i] == 0;
+  }
+  return carry;
+}
+
+// Subtract |b| from |a|, where |bLen| <= |aLen|.  Return the borrow out.
+static uint64_t subLimbs(uint64_t *a, uint32_t aLen, const uint64_t *b, uint32_t bLen) {
+  uint64_t borrow = 0;
+  uint32_t i = 0;
+  for (; i < bLen; i++) {
+    uint64_t value = a[i] - b[i];
+    uint64_t borrow1 = a[i] < b[i];
+    a[i] = value - borrow;
+    borrow = borrow1 | (value < borrow);
+  }
+  for (; borrow != 0 && i < aLen; i++) {
+    borrow = a[i] == 0;
+    a[i]--;
+  }
+  return borrow;
+}
+
+// Set |r| to |a| * |b|, skipping zero limbs of |b|.  |r| must hold aLen + bLen
+// limbs and must not overlap the inputs.
+static void mulSchoolbook(uint64_t *r, const uint64_t *a, uint32_t aLen,
+    const uint64_t *b, uint32_t bLen) {
+  memset(r, 0, (aLen + bLen) * sizeof(uint64_t));
+  for (uint32_t i = 0; i < bLen; i++) {
+    uint64_t bi = b[i];
+    if (bi == 0) {
+      continue;
+    }
+    uint64_t carry = 0;
+    for (uint32_t j = 0; j < aLen; j++) {
+      runtime_doubleLimb t = (runtime_doubleLimb)a[j] * bi + r[i + j] + carry;
+      r[i + j] = (uint64_t)t;
+      carry = (uint64_t)(t >> 64);
+    }
+    r[i + aLen] = carry;
+  }
+}
+
+// Set |r| to |a| * |b| where both have |n| limbs, using Karatsuba above
+// RN_KARATSUBA_THRESHOLD.  |r| must hold 2n limbs and not overlap the inputs.
+static void mulKaratsuba(uint64_t *r, const uint64_t *a, const uint64_t *b, uint32_t n) {
+  if (n < RN_KARATSUBA_THRESHOLD) {
+    mulSchoolbook(r, a, n, b, n);
+    return;
+  }
+  uint32_t low = n / 2;
+  uint32_t high = n - low;
+  // z0 = a0*b0 goes in the low half of r, and z2 = a1*b1 in the high half.
+  mulKaratsuba(r, a, b, low);
+  mulKaratsuba(r + 2 * low, a + low, b + low, high);
+  // z1 = (a0 + a1)*(b0 + b1) - z0 - z2.
+  uint64_t *sumA = allocLimbs(high + 1);
+  uint64_t *sumB = allocLimbs(high + 1);
+  uint64_t *z1 = allocLimbs(2 * (high + 1));
+  memcpy(sumA, a + low, high * sizeof(uint64_t));
+  memcpy(sumB, b + low, high * sizeof(uint64_t));
+  addLimbs(sumA, high + 1, a, low);
+  addLimbs(sumB, high + 1, b, low);
+  mulKaratsuba(z1, sumA, sumB, high + 1);
+  subLimbs(z1, 2 * (high + 1), r, 2 * low);
+  subLimbs(z1, 2 * (high + 1), r + 2 * low, 2 * high);
+  // The true value of z1 fits in the remainder of r, so any limbs of z1 past
+  // the end of r are zero.
+  uint32_t rLen = 2 * n - low;
+  uint32_t z1Len = normalizedLength(z1, 2 * (high + 1));
+  addLimbs(r + low, rLen, z1, z1Len < rLen? z1Len : rLen);
+  free(sumA);
+  free(sumB);
+  free(z1);
+}
+
+// Set |r| to |a| * |b|.  |r| must hold aLen + bLen limbs and not overlap the
+// inputs.
+static void mulLimbs(uint64_t *r, const uint64_t *a, uint32_t aLen,
+    const uint64_t *b, uint32_t bLen) {
+  uint32_t rLen = aLen + bLen;
+  aLen = normalizedLength(a, aLen);
+  bLen = normalizedLength(b, bLen);
+  if (aLen == 0 || bLen == 0) {
+    memset(r, 0, rLen * sizeof(uint64_t));
+    return;
+  }
+  uint32_t n = aLen > bLen? aLen : bLen;
+  uint32_t m = aLen > bLen? bLen : aLen;
+  if (m < RN_KARATSUBA_THRESHOLD || 2 * m < n) {
+    mulSchoolbook(r, a, aLen, b, bLen);
+    memset(r + aLen + bLen, 0, (rLen - aLen - bLen) * sizeof(uint64_t));
+    return;
+  }
+  // Pad the shorter operand so Karatsuba sees equal lengths.
+  uint64_t *paddedA = allocLimbs(n);
+  uint64_t *paddedB = allocLimbs(n);
+  uint64_t *product = allocLimbs(2 * n);
+  memcpy(paddedA, a, aLen * sizeof(uint64_t));
+  memcpy(paddedB, b, bLen * sizeof(uint64_t));
+  mulKaratsuba(product, paddedA, paddedB, n);
+  memset(r, 0, rLen * sizeof(uint64_t));
+  memcpy(r, product, (aLen + bLen) * sizeof(uint64_t));
+  free(paddedA);
+  free(paddedB);
+  free(product);
+}
+
+// Compute |q| = |u| / |v| and |r| = |u| % |v| using Knuth's algorithm D.  |q|
+// must hold uLen limbs and |r| must hold vLen limbs.  Either may be NULL.  |v|
+// must not be zero.
+static void divRemLimbs(uint64_t *q, uint64_t *r, const uint64_t *u, uint32_t uLen,
+    const uint64_t *v, uint32_t vLen) {
+  uint32_t qLen = uLen;
+  uint32_t rLen = vLen;
+  if (q != NULL) {
+    memset(q, 0, qLen * sizeof(uint64_t));
+  }
+  uLen = normalizedLength(u, uLen);
+  vLen = normalizedLength(v, vLen);
+  if (uLen < vLen) {
+    if (r != NULL) {
+      // |r| may be the same buffer as |u|.
+      memmove(r, u, uLen * sizeof(uint64_t));
+      memset(r + uLen, 0, (rLen - uLen) * sizeof(uint64_t));
+    }
+    return;
+  }
+  if (vLen == 1) {
+    uint64_t divisor = v[0];
+    runtime_doubleLimb rem = 0;
+    for (int32_t i = uLen - 1; i >= 0; i--) {
+      runtime_doubleLimb cur = (rem << 64) | u[i];
+      if (q != NULL) {
+        q[i] = (uint64_t)(cur / divisor);
+      }
+      rem = cur % divisor;
+    }
+    if (r != NULL) {
+      memset(r, 0, rLen * sizeof(uint64_t));
+      r[0] = (uint64_t)rem;
+    }
+    return;
+  }
+  // Normalize so the top bit of the divisor is set.
+  uint32_t s = __builtin_clzll(v[vLen - 1]);
+  uint64_t *vn = allocLimbs(vLen);
+  uint64_t *un = allocLimbs(uLen + 1);
+  for (uint32_t i = vLen - 1; i > 0; i--) {
+    vn[i] = s == 0? v[i] : (v[i] << s) | (v[i - 1] >> (64 - s));
+  }
+  vn[0] = v[0] << s;
+  un[uLen] = s == 0? 0 : u[uLen - 1] >> (64 - s);
+  for (uint32_t i = uLen - 1; i > 0; i--) {
+    un[i] = s == 0? u[i] : (u[i] << s) | (u[i - 1] >> (64 - s));
+  }
+  un[0] = u[0] << s;
+  uint64_t vTop = vn[vLen - 1];
+  uint64_t vNext = vn[vLen - 2];
+  for (int32_t j = uLen - vLen; j >= 0; j--) {
+    runtime_doubleLimb num = ((runtime_doubleLimb)un[j + vLen] << 64) | un[j + vLen - 1];
+    runtime_doubleLimb qhat = num / vTop;
+    runtime_doubleLimb rhat = num % vTop;
+    while ((qhat >> 64) != 0 ||
+        (runtime_doubleLimb)(uint64_t)qhat * vNext > ((rhat << 64) | un[j + vLen - 2])) {
+      qhat--;
+      rhat += vTop;
+      if ((rhat >> 64) != 0) {
+        break;
+      }
+    }
+    // Multiply and subtract.
+    uint64_t borrow = 0;
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < vLen; i++) {
+      runtime_doubleLimb p = qhat * vn[i] + carry;
+      carry = (uint64_t)(p >> 64);
+      uint64_t low = (uint64_t)p;
+      uint64_t value = un[i + j] - low;
+      uint64_t borrow1 = un[i + j] < low;
+      un[i + j] = value - borrow;
+      borrow = borrow1 + (value < borrow);
+    }
+    uint64_t top = un[j + vLen];
+    uint64_t value = top - carry;
+    uint64_t borrow1 = top < carry;
+    un[j + vLen] = value - borrow;
+    borrow = borrow1 | (value < borrow);
+    if (borrow != 0) {
+      // We subtracted one too many times, so add back.
+      qhat--;
+      un[j + vLen] += addLimbs(un + j, vLen, vn, vLen);
+    }
+    if (q != NULL) {
+      q[j] = (uint64_t)qhat;
+    }
+  }
+  if (r != NULL) {
+    memset(r, 0, rLen * sizeof(uint64_t));
+    for (uint32_t i = 0; i < vLen; i++) {
+      r[i] = s == 0? un[i] : (un[i] >> s) | (un[i + 1] << (64 - s));
+    }
+  }
+  free(vn);
+  free(un);
+}
+
+// Multiply two bigints in variable time.  Throw an exception on overflow unless
+// |truncate| is true.
+static void mulBigints(runtime_array *dest, runtime_array *a, runtime_array *b, bool truncate) {
+  checkSameType(a, b);
+  uint32_t width = runtime_bigintWidth(a);
+  bool isSigned = runtime_bigintSigned(a);
+  uint32_t numLimbs = widthToLimbs(width);
+  uint64_t *aLimbs = allocLimbs(numLimbs);
+  uint64_t *bLimbs = allocLimbs(numLimbs);
+  uint64_t *product = allocLimbs(2 * numLimbs);
+  bool negative = loadBigint(a, aLimbs, numLimbs) != loadBigint(b, bLimbs, numLimbs);
+  mulLimbs(product, aLimbs, numLimbs, bLimbs, numLimbs);
+  storeBigint(dest, product, 2 * numLimbs, negative, width, isSigned, truncate);
+  free(aLimbs);
+  free(bLimbs);
+  free(product);
+}
+
+// Multiply two non-secret bigints.  Throw an exception on overflow/underflow.
+void runtime_bigintMulVartime(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  if (runtime_bigintSecret(a) || runtime_bigintSecret(b)) {
+    runtime_bigintMul(dest, a, b);
+    return;
+  }
+  mulBigints(dest, a, b, false);
+}
+
+// Multiply two non-secret bigints.  Truncate the result if it is too big.
+void runtime_bigintMulTruncVartime(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  if (runtime_bigintSecret(a) || runtime_bigintSecret(b)) {
+    runtime_bigintMulTrunc(dest, a, b);
+    return;
+  }
+  mulBigints(dest, a, b, true);
+}
+
+// Divide two non-negative bigints in variable time.  Return false if either
+// is negative, in which case the caller should use the CTTK version, so we
+// round exactly like it does.
+static bool divRemBigints(runtime_array *dest, runtime_array *a, runtime_array *b, bool wantQuotient) {
+  checkSameType(a, b);
+  uint32_t width = runtime_bigintWidth(a);
+  bool isSigned = runtime_bigintSigned(a);
+  uint32_t numLimbs = widthToLimbs(width);
+  uint64_t *aLimbs = allocLimbs(numLimbs);
+  uint64_t *bLimbs = allocLimbs(numLimbs);
+  uint64_t *result = allocLimbs(numLimbs);
+  bool negative = loadBigint(a, aLimbs, numLimbs) | loadBigint(b, bLimbs, numLimbs);
+  if (!negative) {
+    if (normalizedLength(bLimbs, numLimbs) == 0) {
+      raiseNAN();
+    }
+    if (wantQuotient) {
+      divRemLimbs(result, NULL, aLimbs, numLimbs, bLimbs, numLimbs);
+    } else {
+      divRemLimbs(NULL, result, aLimbs, numLimbs, bLimbs, numLimbs);
+    }
+    storeBigint(dest, result, numLimbs, false, width, isSigned, false);
+  }
+  free(aLimbs);
+  free(bLimbs);
+  free(result);
+  return !negative;
+}
+
+// Divide two non-secret bigints.  Throw an exception if |b| is 0.
+void runtime_bigintDivVartime(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  if (runtime_bigintSecret(a) || runtime_bigintSecret(b) ||
+      !divRemBigints(dest, a, b, true)) {
+    runtime_bigintDiv(dest, a, b);
+  }
+}
+
+// Compute the remainder of two non-secret bigints.  Throw an exception if |b|
+// is 0.
+void runtime_bigintModVartime(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  if (runtime_bigintSecret(a) || runtime_bigintSecret(b) ||
+      !divRemBigints(dest, a, b, false)) {
+    runtime_bigintMod(dest, a, b);
+  }
+}
+
+// Non-modular exponentiation of a non-secret base.  |dest| and |base| can be
+// the same.
+void runtime_bigintExpVartime(runtime_array *dest, runtime_array *base, uint32_t exponent) {
+  if (runtime_bigintSecret(base)) {
+    runtime_bigintExp(dest, base, exponent);
+    return;
+  }
+  uint32_t width = runtime_bigintWidth(base);
+  bool isSigned = runtime_bigintSigned(base);
+  runtime_array t = runtime_makeEmptyArray();
+  runtime_copyBigint(&t, base);
+  // Set dest to 1 after initializing t in case dest == base.
+  runtime_integerToBigint(dest, 1, width, isSigned, false);
+  while (exponent != 0) {
+    if (exponent & 1) {
+      mulBigints(dest, dest, &t, false);
+    }
+    exponent >>= 1;
+    if (exponent != 0) {
+      // Be careful not to overflow t with an extra squaring.
+      mulBigints(&t, &t, &t, false);
+    }
+  }
+  runtime_freeArray(&t);
+}
+
+// Set |r| to |a| * |b| mod |m|.  All have |n| limbs, and |product| must hold 2n
+// limbs of scratch space.
+static inline void mulModLimbs(uint64_t *r, const uint64_t *a, const uint64_t *b,
+    const uint64_t *m, uint32_t n, uint64_t *product) {
+  mulLimbs(product, a, n, b, n);
+  divRemLimbs(NULL, r, product, 2 * n, m, n);
+}
+
+// Check that the modulus is public and unsigned, as required by the CTTK path.
+static void checkModulus(const runtime_array *modulus) {
+  if (runtime_bigintSecret(modulus)) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,"Modulus cannot be secret");
+  }
+  if (runtime_bigintSigned(modulus)) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,"Modulus must be unsigned");
+  }
+}
+
+// Variable time modular multiplication of non-secret values.
+void runtime_bigintModularMulVartime(runtime_array *dest, runtime_array *a,
+    runtime_array *b, runtime_array *modulus) {
+  if (runtime_bigintSecret(a) || runtime_bigintSecret(b)) {
+    runtime_bigintModularMul(dest, a, b, modulus);
+    return;
+  }
+  checkModulus(modulus);
+  uint32_t width = runtime_bigintWidth(a);
+  uint32_t modWidth = runtime_bigintWidth(modulus);
+  uint32_t numLimbs = widthToLimbs(width > modWidth? width : modWidth);
+  uint64_t *aLimbs = allocLimbs(numLimbs);
+  uint64_t *bLimbs = allocLimbs(numLimbs);
+  uint64_t *mLimbs = allocLimbs(numLimbs);
+  uint64_t *product = allocLimbs(2 * numLimbs);
+  loadBigint(a, aLimbs, numLimbs);
+  loadBigint(b, bLimbs, numLimbs);
+  loadBigint(modulus, mLimbs, numLimbs);
+  if (normalizedLength(mLimbs, numLimbs) == 0) {
+    raiseNAN();
+  }
+  mulModLimbs(aLimbs, aLimbs, bLimbs, mLimbs, numLimbs, product);
+  storeBigint(dest, aLimbs, numLimbs, false, width, runtime_bigintSigned(a), false);
+  free(aLimbs);
+  free(bLimbs);
+  free(mLimbs);
+  free(product);
+}
+
+// Variable time modular exponentiation of non-secret values.  This is plain
+// left-to-right square-and-multiply, which only looks at the exponent's
+// significant bits.
+void runtime_bigintModularExpVartime(runtime_array *dest, runtime_array *base,
+    runtime_array *exponent, runtime_array *modulus) {
+  if (runtime_bigintSecret(base) || runtime_bigintSecret(exponent)) {
+    runtime_bigintModularExp(dest, base, exponent, modulus);
+    return;
+  }
+  if (runtime_rnBoolToBool(runtime_bigintNegative(exponent))) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,
+        "Tried to exponentiate with negative exponent");
+  }
+  checkModulus(modulus);
+  uint32_t width = runtime_bigintWidth(modulus);
+  uint32_t baseWidth = runtime_bigintWidth(base);
+  uint32_t numLimbs = widthToLimbs(width > baseWidth? width : baseWidth);
+  uint32_t expLimbs = widthToLimbs(runtime_bigintWidth(exponent));
+  uint64_t *baseLimbs = allocLimbs(numLimbs);
+  uint64_t *mLimbs = allocLimbs(numLimbs);
+  uint64_t *eLimbs = allocLimbs(expLimbs);
+  uint64_t *result = allocLimbs(numLimbs);
+  uint64_t *product = allocLimbs(2 * numLimbs);
+  loadBigint(base, baseLimbs, numLimbs);
+  loadBigint(modulus, mLimbs, numLimbs);
+  loadBigint(exponent, eLimbs, expLimbs);
+  if (normalizedLength(mLimbs, numLimbs) == 0) {
+    raiseNAN();
+  }
+  divRemLimbs(NULL, baseLimbs, baseLimbs, numLimbs, mLimbs, numLimbs);
+  result[0] = 1;
+  int32_t topLimb = normalizedLength(eLimbs, expLimbs) - 1;
+  for (int32_t i = topLimb; i >= 0; i--) {
+    int32_t topBit = i == topLimb? 63 - __builtin_clzll(eLimbs[i]) : 63;
+    for (int32_t bit = topBit; bit >= 0; bit--) {
+      mulModLimbs(result, result, result, mLimbs, numLimbs, product);
+      if ((eLimbs[i] >> bit) & 1) {
+        mulModLimbs(result, result, baseLimbs, mLimbs, numLimbs, product);
+      }
+    }
+  }
+  storeBigint(dest, result, numLimbs, false, width, false, false);
+  free(baseLimbs);
+  free(mLimbs);
+  free(eLimbs);
+  free(result);
+  free(product);
+}
@@ -0,0 +1,400 @@
+//  Copyright 2024 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Constant time Karatsuba and Toom-3 multiplication for very wide bigints.
+// CTTK multiplies with the schoolbook method on 31-bit limbs, which dominates
+// the cost of u4096 and wider products.  Operands are unpacked from the CTTK
+// format into 64-bit limbs without branching on their values, and the shape of
+// the recursion depends only on the width, which is a static type.  The only
+// data dependent branch is the final overflow check, which leaks exactly what
+// CTTK's NaN check leaks.  We assume 64x64->128 bit multiplication is constant
+// time, which is true on x86-64 and aarch64.
+//
+// The code generator selects runtime_bigintMulKaratsuba or
+// runtime_bigintMulToom3 based on the width, since the best algorithm is known
+// at compile time.
+#include "runtime.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The inverse of 3 mod 2^64, used for exact division by 3.
+#define RN_INVERSE_OF_3 0xaaaaaaaaaaaaaaabull
+
+typedef unsigned __int128 runtime_doubleLimb;
+
+// Return the number of 64-bit limbs needed to hold |width| bits.
+static inline uint32_t widthToLimbs(uint32_t width) {
+  return (width + 63) / 64;
+}
+
+// Allocate a zeroed buffer of 64-bit limbs.
+static uint64_t *allocLimbs(uint32_t numLimbs) {
+  uint64_t *limbs = calloc(numLimbs == 0? 1 : numLimbs, sizeof(uint64_t));
+  if (limbs == NULL) {
+    runtime_panicCstr("Out of memory in wide bigint multiplication");
+  }
+  return limbs;
+}
+
+// Negate |a| if |mask| is all ones.  |mask| must be 0 or all ones.
+static void condNegate(uint64_t *a, uint32_t len, uint64_t mask) {
+  uint64_t carry = mask & 1;
+  for (uint32_t i = 0; i < len; i++) {
+    runtime_doubleLimb t = (runtime_doubleLimb)(a[i] ^ mask) + carry;
+    a[i] = (uint64_t)t;
+    carry = (uint64_t)(t >> 64);
+  }
+}
+
+// Return an all ones mask if the two's complement value is negative.
+static inline uint64_t signMask(const uint64_t *a, uint32_t len) {
+  return -(a[len - 1] >> 63);
+}
+
+// Add |b| into |a|, where |bLen| <= |aLen|, carrying through all of |a|.
+static void addInto(uint64_t *a, uint32_t aLen, const uint64_t *b, uint32_t bLen) {
+  uint64_t carry = 0;
+  for (uint32_t i = 0; i < aLen; i++) {
+    runtime_doubleLimb t = (runtime_doubleLimb)a[i] + (i < bLen? b[i] : 0) + carry;
+    a[i] = (uint64_t)t;
+    carry = (uint64_t)(t >> 64);
+  }
+}
+
+// Subtract |b| from |a|, where |bLen| <= |aLen|, borrowing through all of |a|.
+// |b| is sign extended if |signExtend| is true.
+static void subFrom(uint64_t *a, uint32_t aLen, const uint64_t *b, uint32_t bLen, bool signExtend) {
+  uint64_t fill = signExtend? signMask(b, bLen) : 0;
+  uint64_t borrow = 0;
+  for (uint32_t i = 0; i < aLen; i++) {
+    uint64_t bi = i < bLen? b[i] : fill;
+    uint64_t value = a[i] - bi;
+    uint64_t borrow1 = a[i] < bi;
+    a[i] = value - borrow;
+    borrow = borrow1 | (value < borrow);
+  }
+}
+
+// Arithmetic shift right by one bit.  This divides an even value by 2.
+static void halve(uint64_t *a, uint32_t len) {
+  for (uint32_t i = 0; i < len - 1; i++) {
+    a[i] = (a[i] >> 1) | (a[i + 1] << 63);
+  }
+  a[len - 1] = (uint64_t)((int64_t)a[len - 1] >> 1);
+}
+
+// Divide a two's complement value that is a multiple of 3 by 3.  This computes
+// |a| * 3^-1 mod 2^(64*len), which is exact when 3 divides |a|.
+static void divideBy3(uint64_t *a, uint32_t len) {
+  uint64_t borrow = 0;
+  for (uint32_t i = 0; i < len; i++) {
+    uint64_t value = a[i] - borrow;
+    uint64_t borrow1 = a[i] < borrow;
+    uint64_t q = value * RN_INVERSE_OF_3;
+    a[i] = q;
+    borrow = (uint64_t)(((runtime_doubleLimb)q * 3) >> 64) + borrow1;
+  }
+}
+
+static void mulLimbs(uint64_t *r, const uint64_t *a, const uint64_t *b, uint32_t n);
+
+// Set r[0..2n) to |a| * |b| with the schoolbook method.
+static void mulBasecase(uint64_t *r, const uint64_t *a, const uint64_t *b, uint32_t n) {
+  memset(r, 0, 2 * n * sizeof(uint64_t));
+  for (uint32_t i = 0; i < n; i++) {
+    uint64_t carry = 0;
+    for (uint32_t j = 0; j < n; j++) {
+      runtime_doubleLimb t = (runtime_doubleLimb)a[j] * b[i] + r[i + j] + carry;
+      r[i + j] = (uint64_t)t;
+      carry = (uint64_t)(t >> 64);
+    }
+    r[i + n] = carry;
+  }
+}
+
+// Set r[0..2n) to |a| * |b| with one level of Karatsuba.  n must be at least 4.
+static void mulKaratsuba(uint64_t *r, const uint64_t *a, const uint64_t *b, uint32_t n) {
+  uint32_t low = n / 2;
+  uint32_t high = n - low;
+  // z0 = a0*b0 goes in the low half of r, and z2 = a1*b1 in the high half.
+  mulLimbs(r, a, b, low);
+  mulLimbs(r + 2 * low, a + low, b + low, high);
+  // z1 = (a0 + a1)*(b0 + b1) - z0 - z2.
+  uint64_t *sumA = allocLimbs(high + 1);
+  uint64_t *sumB = allocLimbs(high + 1);
+  uint64_t *z1 = allocLimbs(2 * (high + 1));
+  memcpy(sumA, a + low, high * sizeof(uint64_t));
+  memcpy(sumB, b + low, high * sizeof(uint64_t));
+  addInto(sumA, high + 1, a, low);
+  addInto(sumB, high + 1, b, low);
+  mulLimbs(z1, sumA, sumB, high + 1);
+  subFrom(z1, 2 * (high + 1), r, 2 * low, false);
+  subFrom(z1, 2 * (high + 1), r + 2 * low, 2 * high, false);
+  addInto(r + low, 2 * n - low, z1, 2 * (high + 1));
+  free(sumA);
+  free(sumB);
+  free(z1);
+}
+
+// Set |r| to |x| * |y|, where |x| and |y| are two's complement values of |len|
+// limbs, and |r| has 2*len limbs.
+static void mulSigned(uint64_t *r, const uint64_t *x, const uint64_t *y, uint32_t len) {
+  uint64_t *absX = allocLimbs(len);
+  uint64_t *absY = allocLimbs(len);
+  uint64_t xMask = signMask(x, len);
+  uint64_t yMask = signMask(y, len);
+  memcpy(absX, x, len * sizeof(uint64_t));
+  memcpy(absY, y, len * sizeof(uint64_t));
+  condNegate(absX, len, xMask);
+  condNegate(absY, len, yMask);
+  mulLimbs(r, absX, absY, len);
+  condNegate(r, 2 * len, xMask ^ yMask);
+  free(absX);
+  free(absY);
+}
+
+// Set r[0..2n) to |a| * |b| with one level of Toom-3, evaluating at 0, 1, -1,
+// -2 and infinity, and interpolating with Bodrato's sequence.  n must be at
+// least 3.
+static void mulToom3(uint64_t *r, const uint64_t *a, const uint64_t *b, uint32_t n) {
+  uint32_t k = (n + 2) / 3;
+  // Evaluations need 3 extra bits plus a sign, and products twice that.
+  uint32_t evalLen = k + 1;
+  uint32_t prodLen = 2 * evalLen;
+  uint64_t *paddedA = allocLimbs(3 * k);
+  uint64_t *paddedB = allocLimbs(3 * k);
+  memcpy(paddedA, a, n * sizeof(uint64_t));
+  memcpy(paddedB, b, n * sizeof(uint64_t));
+  const uint64_t *x[2] = {paddedA, paddedB};
+  uint64_t *p1[2], *pm1[2], *pm2[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    const uint64_t *x0 = x[i];
+    const uint64_t *x1 = x[i] + k;
+    const uint64_t *x2 = x[i] + 2 * k;
+    p1[i] = allocLimbs(evalLen);
+    pm1[i] = allocLimbs(evalLen);
+    pm2[i] = allocLimbs(evalLen);
+    // t = x0 + x2, p(1) = t + x1, p(-1) = t - x1.
+    memcpy(pm1[i], x0, k * sizeof(uint64_t));
+    addInto(pm1[i], evalLen, x2, k);
+    memcpy(p1[i], pm1[i], evalLen * sizeof(uint64_t));
+    addInto(p1[i], evalLen, x1, k);
+    subFrom(pm1[i], evalLen, x1, k, false);
+    // p(-2) = 2*(p(-1) + x2) - x0.
+    memcpy(pm2[i], pm1[i], evalLen * sizeof(uint64_t));
+    addInto(pm2[i], evalLen, x2, k);
+    addInto(pm2[i], evalLen, pm2[i], evalLen);
+    subFrom(pm2[i], evalLen, x0, k, false);
+  }
+  uint64_t *r0 = allocLimbs(prodLen);
+  uint64_t *r1 = allocLimbs(prodLen);
+  uint64_t *rm1 = allocLimbs(prodLen);
+  uint64_t *rm2 = allocLimbs(prodLen);
+  uint64_t *rInf = allocLimbs(prodLen);
+  mulLimbs(r0, paddedA, paddedB, k);
+  mulLimbs(r1, p1[0], p1[1], evalLen);
+  mulSigned(rm1, pm1[0], pm1[1], evalLen);
+  mulSigned(rm2, pm2[0], pm2[1], evalLen);
+  mulLimbs(rInf, paddedA + 2 * k, paddedB + 2 * k, k);
+  // Interpolate.  r3 = (r(-2) - r(1))/3.
+  uint64_t *r3 = rm2;
+  subFrom(r3, prodLen, r1, prodLen, false);
+  divideBy3(r3, prodLen);
+  // r1 = (r(1) - r(-1))/2.
+  subFrom(r1, prodLen, rm1, prodLen, false);
+  halve(r1, prodLen);
+  // r2 = r(-1) - r(0).
+  uint64_t *r2 = rm1;
+  subFrom(r2, prodLen, r0, prodLen, false);
+  // r3 = (r2 - r3)/2 + 2*r(inf).
+  uint64_t *t = allocLimbs(prodLen);
+  memcpy(t, r2, prodLen * sizeof(uint64_t));
+  subFrom(t, prodLen, r3, prodLen, false);
+  halve(t, prodLen);
+  addInto(t, prodLen, rInf, prodLen);
+  addInto(t, prodLen, rInf, prodLen);
+  memcpy(r3, t, prodLen * sizeof(uint64_t));
+  // r2 = r2 + r1 - r(inf).
+  addInto(r2, prodLen, r1, prodLen);
+  subFrom(r2, prodLen, rInf, prodLen, false);
+  // r1 = r1 - r3.
+  subFrom(r1, prodLen, r3, prodLen, false);
+  // Recompose.  All coefficients are non-negative, and the product fits in 2n
+  // limbs, so limbs of the sum past 2n are zero.
+  uint32_t sumLen = 4 * k + prodLen;
+  uint64_t *sum = allocLimbs(sumLen);
+  memcpy(sum, r0, 2 * k * sizeof(uint64_t));
+  memcpy(sum + 4 * k, rInf, 2 * k * sizeof(uint64_t));
+  addInto(sum + k, sumLen - k, r1, prodLen);
+  addInto(sum + 2 * k, sumLen - 2 * k, r2, prodLen);
+  addInto(sum + 3 * k, sumLen - 3 * k, r3, prodLen);
+  memcpy(r, sum, 2 * n * sizeof(uint64_t));
+  for (uint32_t i = 0; i < 2; i++) {
+    free(p1[i]);
+    free(pm1[i]);
+    free(pm2[i]);
+  }
+  free(paddedA);
+  free(paddedB);
+  free(r0);
+  free(r1);
+  free(rm1);
+  free(rm2);
+  free(rInf);
+  free(t);
+  free(sum);
+}
+
+// Set r[0..2n) to |a| * |b|, choosing the algorithm for sub-products by size.
+static void mulLimbs(uint64_t *r, const uint64_t *a, const uint64_t *b, uint32_t n) {
+  uint32_t width = 64 * n;
+  if (width >= RN_TOOM3_MIN_WIDTH) {
+    mulToom3(r, a, b, n);
+  } else if (width >= RN_KARATSUBA_MIN_WIDTH) {
+    mulKaratsuba(r, a, b, n);
+  } else {
+    mulBasecase(r, a, b, n);
+  }
+}
+
+// Unpack a CTTK bigint into |numLimbs| limbs of magnitude, without branching
+// on its value.  Return an all ones mask if it is negative.
+static uint64_t loadMagnitude(const runtime_array *bigint, uint64_t *limbs, uint32_t numLimbs) {
+  const uint32_t *data = (const uint32_t*)bigint->data;
+  uint32_t numWords = bigint->numElements;
+  uint64_t mask = -(uint64_t)((data[numWords - 1] >> 30) & 1);
+  memset(limbs, 0, numLimbs * sizeof(uint64_t));
+  uint32_t bitPos = 0;
+  for (uint32_t i = 2; i < numWords; i++) {
+    uint64_t word = data[i] & 0x7fffffff;
+    uint32_t limb = bitPos >> 6;
+    uint32_t shift = bitPos & 63;
+    if (limb < numLimbs) {
+      limbs[limb] |= word << shift;
+      if (shift > 33 && limb + 1 < numLimbs) {
+        limbs[limb + 1] |= word >> (64 - shift);
+      }
+    }
+    bitPos += 31;
+  }
+  // Sign extend, then negate negative values.
+  uint32_t limb = bitPos >> 6;
+  if (limb < numLimbs) {
+    limbs[limb] |= mask & (~(uint64_t)0 << (bitPos & 63));
+    for (limb++; limb < numLimbs; limb++) {
+      limbs[limb] = mask;
+    }
+  }
+  condNegate(limbs, numLimbs, mask);
+  return mask;
+}
+
+// Pack the two's complement product into |dest|, without branching on its
+// value until the final overflow check.  Raise an exception on overflow unless
+// |truncate| is true, in which case we keep the low |width| bits.
+static void storeProduct(runtime_array *dest, const uint64_t *product, uint32_t numLimbs,
+    uint32_t width, bool isSigned, bool secret, bool truncate) {
+  // Bits from |firstCopy| up must all be copies of the sign, or 0 if unsigned.
+  uint32_t firstCopy = isSigned? width - 1 : width;
+  uint64_t fill = isSigned? -((product[firstCopy >> 6] >> (firstCopy & 63)) & 1) : 0;
+  uint64_t expected = isSigned? signMask(product, numLimbs) : 0;
+  uint64_t diff = 0;
+  for (uint32_t i = 0; i < numLimbs; i++) {
+    uint64_t region;
+    if (64 * (i + 1) <= firstCopy) {
+      region = 0;
+    } else if (64 * i >= firstCopy) {
+      region = ~(uint64_t)0;
+    } else {
+      region = ~(uint64_t)0 << (firstCopy & 63);
+    }
+    diff |= (product[i] ^ expected) & region;
+  }
+  if (!truncate && diff != 0) {
+    runtime_raiseExceptionCstr("NotANumber", __FILE__, __LINE__,
+        "Bigint was set to NaN");
+  }
+  runtime_integerToBigint(dest, 0, width, isSigned, secret);
+  uint32_t *data = (uint32_t*)dest->data;
+  uint32_t numWords = dest->numElements;
+  uint32_t bitPos = 0;
+  for (uint32_t i = 2; i < numWords; i++) {
+    uint32_t limb = bitPos >> 6;
+    uint32_t shift = bitPos & 63;
+    uint64_t value = limb < numLimbs? product[limb] >> shift : fill;
+    if (shift > 33) {
+      value |= (limb + 1 < numLimbs? product[limb + 1] : fill) << (64 - shift);
+    }
+    uint32_t word = value & 0x7fffffff;
+    // Bits at and above |width| are copies of the sign bit.
+    uint32_t highMask = 0;
+    if (bitPos >= width) {
+      highMask = 0x7fffffff;
+    } else if (bitPos + 31 > width) {
+      highMask = ~((1u << (width - bitPos)) - 1) & 0x7fffffff;
+    }
+    data[i] = (word & ~highMask) | ((uint32_t)fill & highMask);
+    bitPos += 31;
+  }
+}
+
+// Multiply two bigints, using |mulFunc| for the top level product.
+static void mulWide(runtime_array *dest, runtime_array *a, runtime_array *b, bool truncate,
+    void (*mulFunc)(uint64_t *r, const uint64_t *a, const uint64_t *b, uint32_t n)) {
+  if (a->data == NULL || b->data == NULL) {
+    runtime_panicCstr("Null array passed to wide bigint multiplication");
+  }
+  uint32_t width = runtime_bigintWidth(a);
+  bool isSigned = runtime_bigintSigned(a);
+  if (width != runtime_bigintWidth(b) || isSigned != runtime_bigintSigned(b)) {
+    runtime_raiseExceptionCstr("Internal", __FILE__, __LINE__,
+        "Different bigint types in binary operation");
+  }
+  bool secret = runtime_bigintSecret(a) || runtime_bigintSecret(b);
+  uint32_t numLimbs = widthToLimbs(width);
+  if (numLimbs < 4) {
+    // Too narrow to split.
+    mulFunc = mulBasecase;
+  }
+  uint64_t *aLimbs = allocLimbs(numLimbs);
+  uint64_t *bLimbs = allocLimbs(numLimbs);
+  uint64_t *product = allocLimbs(2 * numLimbs);
+  uint64_t mask = loadMagnitude(a, aLimbs, numLimbs) ^ loadMagnitude(b, bLimbs, numLimbs);
+  mulFunc(product, aLimbs, bLimbs, numLimbs);
+  condNegate(product, 2 * numLimbs, mask);
+  storeProduct(dest, product, 2 * numLimbs, width, isSigned, secret, truncate);
+  free(aLimbs);
+  free(bLimbs);
+  free(product);
+}
+
+// Multiply two bigints with Karatsuba.  Throw an exception on overflow.
+void runtime_bigintMulKaratsuba(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  mulWide(dest, a, b, false, mulKaratsuba);
+}
+
+// Multiply two bigints with Karatsuba.  Truncate the result if it is too big.
+void runtime_bigintMulTruncKaratsuba(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  mulWide(dest, a, b, true, mulKaratsuba);
+}
+
+// Multiply two bigints with Toom-3.  Throw an exception on overflow.
+void runtime_bigintMulToom3(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  mulWide(dest, a, b, false, mulToom3);
+}
+
+// Multiply two bigints with Toom-3.  Truncate the result if it is too big.
+void runtime_bigintMulTruncToom3(runtime_array *dest, runtime_array *a, runtime_array *b) {
+  mulWide(dest, a, b, true, mulToom3);
+}
@@ -18,36 +18,290 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include "llexport.h"
 
 static char *deClangPath = "clang";
+static bool deUseLTO = true;
+// Profile guided optimization options passed through to clang.
+static bool deProfileGenerate = false;
+static char *deProfileUse = NULL;
+// Number of modules to split the program into, compiled by parallel clangs.
+static uint32 deNumJobs = 1;
 
-// Run the Clang compiler on the LLVM code we generated.
+// Return the path to the runtime bitcode if optimized builds should link it
+// into the program for LTO, otherwise NULL.
+static char *findRuntimeBitcode(bool debugMode, bool optimized) {
+  if (!deUseLTO || debugMode || !optimized) {
+    return NULL;
+  }
+  char *path = utSprintf("%s/librune.bc", deLibDir);
+  return utFileExists(path)? path : NULL;
+}
+
+// Return the clang flag for profile guided optimization, if any.
+static char *findProfileFlag(void) {
+  if (deProfileGenerate) {
+    return " -fprofile-generate";
+  } else if (deProfileUse != NULL) {
+    return utSprintf(" -fprofile-use=%s", deProfileUse);
+  }
+  return "";
+}
+
+// Run the Clang compiler on the LLVM code we generated.  Optimized builds link
+// the runtime as bitcode with LTO, so runtime functions can be inlined.
 static int runClangCompiler(char *llvmFileName, bool debugMode, bool optimized) {
     char *outFileName = utReplaceSuffix(llvmFileName, "");
   char *optFlag = optimized? "-O3" : "";
   if (debugMode) {
     optFlag = "-g -O0";
   }
-  char *command = utSprintf("%s %s -fPIC -o %s %s %s/librune.a %s/libcttk.a",
-      deClangPath, optFlag, outFileName, llvmFileName, deLibDir, deLibDir);
+  char *runtimeLib = utSprintf("%s/librune.a", deLibDir);
+  char *runtimeBitcode = findRuntimeBitcode(debugMode, optimized);
+  if (runtimeBitcode != NULL) {
+    optFlag = "-O3 -flto -fuse-ld=lld";
+    runtimeLib = runtimeBitcode;
+  }
+  char *command = utSprintf("%s %s%s -fPIC -o %s %s %s %s/libcttk.a",
+      deClangPath, optFlag, findProfileFlag(), outFileName, llvmFileName, runtimeLib, deLibDir);
   utDebug("Executing: %s\n", command);
   return system(command);
 }
 
+// Run each of the |numCommands| commands, in parallel where we can.  Return 0
+// if they all succeed.
+static int runCommandsInParallel(char **commands, uint32 numCommands) {
+  int rc = 0;
+#ifdef _WIN32
+  for (uint32 i = 0; i < numCommands; i++) {
+    utDebug("Executing: %s\n", commands[i]);
+    if (system(commands[i]) != 0) {
+      rc = 1;
+    }
+  }
+#else
+  fflush(stdout);
+  for (uint32 i = 0; i < numCommands; i++) {
+    utDebug("Executing: %s\n", commands[i]);
+    pid_t pid = fork();
+    if (pid == 0) {
+      execl("/bin/sh", "sh", "-c", commands[i], (char *)NULL);
+      _exit(127);
+    } else if (pid < 0) {
+      printf("Unable to start: %s\n", commands[i]);
+      rc = 1;
+    }
+  }
+  int status;
+  while (wait(&status) > 0) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      rc = 1;
+    }
+  }
+#endif
+  return rc;
+}
+
+// Split the LLVM IR in |text| into deNumJobs modules, compile them with
+// parallel clang processes, and link the object files.  With LTO, the modules
+// are compiled to ThinLTO bitcode, so the link step also optimizes them in
+// parallel.  The partition .ll files are kept only if |keepLLVMFiles|.
+static int runParallelClangCompiler(char *text, size_t length, char *llvmFileName,
+    bool optimized, bool keepLLVMFiles) {
+  char *baseName = utAllocString(utReplaceSuffix(llvmFileName, ""));
+  char **partitionFileNames = utNewA(char *, deNumJobs);
+  char **objFileNames = utNewA(char *, deNumJobs);
+  char **commands = utNewA(char *, deNumJobs);
+  for (uint32 i = 0; i < deNumJobs; i++) {
+    partitionFileNames[i] = utAllocString(utSprintf("%s.%u.ll", baseName, i));
+    objFileNames[i] = utAllocString(utSprintf("%s.%u.o", baseName, i));
+  }
+  char *optFlag = optimized? "-O3" : "";
+  char *linkFlag = optFlag;
+  char *runtimeLib = utSprintf("%s/librune.a", deLibDir);
+  char *runtimeBitcode = findRuntimeBitcode(false, optimized);
+  if (runtimeBitcode != NULL) {
+    optFlag = "-O3 -flto=thin";
+    linkFlag = "-O3 -flto=thin -fuse-ld=lld";
+    runtimeLib = runtimeBitcode;
+  }
+  runtimeLib = utAllocString(runtimeLib);
+  int rc = 1;
+  if (llPartitionLLVMAssembly(text, length, deNumJobs, partitionFileNames)) {
+    for (uint32 i = 0; i < deNumJobs; i++) {
+      commands[i] = utAllocString(utSprintf("%s %s%s -fPIC -c -o %s %s", deClangPath,
+          optFlag, findProfileFlag(), objFileNames[i], partitionFileNames[i]));
+    }
+    rc = runCommandsInParallel(commands, deNumJobs);
+    for (uint32 i = 0; i < deNumJobs; i++) {
+      utFree(commands[i]);
+    }
+    if (rc == 0) {
+      char *objFiles = utAllocString("");
+      for (uint32 i = 0; i < deNumJobs; i++) {
+        char *newObjFiles = utAllocString(utSprintf("%s %s", objFiles, objFileNames[i]));
+        utFree(objFiles);
+        objFiles = newObjFiles;
+      }
+      char *command = utSprintf("%s %s%s -fPIC -o %s%s %s %s/libcttk.a", deClangPath,
+          linkFlag, findProfileFlag(), baseName, objFiles, runtimeLib, deLibDir);
+      utFree(objFiles);
+      utDebug("Executing: %s\n", command);
+      rc = system(command);
+    }
+  }
+  for (uint32 i = 0; i < deNumJobs; i++) {
+    remove(objFileNames[i]);
+    if (!keepLLVMFiles) {
+      remove(partitionFileNames[i]);
+    }
+    utFree(objFileNames[i]);
+    utFree(partitionFileNames[i]);
+  }
+  utFree(runtimeLib);
+  utFree(commands);
+  utFree(objFileNames);
+  utFree(partitionFileNames);
+  utFree(baseName);
+  return rc;
+}
+
+// Compile the LLVM IR in |text| in-process with the LLVM C API, and link the
+// object file with clang.
+static int runLLVMAPICompiler(char *text, size_t length, char *llvmFileName,
+    char *passes, bool debugMode, bool optimized) {
+  char *outFileName = utAllocString(utReplaceSuffix(llvmFileName, ""));
+  char *objFileName = utAllocString(utReplaceSuffix(llvmFileName, ".o"));
+  if (passes == NULL) {
+    passes = optimized && !debugMode? "default<O3>" : "default<O0>";
+  }
+  int rc = 1;
+  // The runtime is linked in-process, so this needs no LTO-capable linker.
+  char *runtimeBitcode = findRuntimeBitcode(debugMode, optimized);
+  if (runtimeBitcode != NULL) {
+    runtimeBitcode = utAllocString(runtimeBitcode);
+  }
+  if (llCompileWithLLVMAPI(text, length, llvmFileName, objFileName, passes,
+      optimized && !debugMode, runtimeBitcode)) {
+    // With the runtime linked in, librune.a has nothing left to resolve.
+    char *command = utSprintf("%s -fPIC -o %s %s %s/librune.a %s/libcttk.a",
+        deClangPath, outFileName, objFileName, deLibDir, deLibDir);
+    utDebug("Executing: %s\n", command);
+    rc = system(command);
+    remove(objFileName);
+  }
+  if (runtimeBitcode != NULL) {
+    utFree(runtimeBitcode);
+  }
+  utFree(objFileName);
+  utFree(outFileName);
+  return rc;
+}
+
+// Convert comma separated fast-math flags, like "contract,reassoc", to the
+// form llFastMathFlags uses, like " contract reassoc".  Return NULL if a flag
+// is not one LLVM supports.
+static char *parseFastMathFlags(char *flags) {
+  static char *validFlags[] = {"fast", "nnan", "ninf", "nsz", "arcp", "contract", "afn", "reassoc"};
+  char *result = utAllocString("");
+  char *p = flags;
+  do {
+    char *end = strchr(p, ',');
+    size_t length = end == NULL? strlen(p) : end - p;
+    bool found = false;
+    for (uint32 i = 0; i < sizeof(validFlags) / sizeof(char *); i++) {
+      if (strlen(validFlags[i]) == length && !strncmp(p, validFlags[i], length)) {
+        found = true;
+      }
+    }
+    if (!found) {
+      utFree(result);
+      return NULL;
+    }
+    char *newResult = utAllocString(utSprintf("%s %.*s", result, (int)length, p));
+    utFree(result);
+    result = newResult;
+    p = end == NULL? NULL : end + 1;
+  } while (p != NULL);
+  return result;
+}
+
+// Write |text| to |fileName|, so -l still dumps the IR with the in-process
+// backend.
+static void writeLLVMFile(char *fileName, char *text, size_t length) {
+  FILE *file = fopen(fileName, "w");
+  if (file == NULL) {
+    utExit("Unable to write to %s", fileName);
+  }
+  fwrite(text, 1, length, file);
+  fclose(file);
+}
+
 // Print usage and exit.
 static void usage(void) {
   printf("Usage: rune [options] file\n"
+         "    -aos      - Store the fields of every class as an array of structures, as\n"
+         "                if declared with aos, rather than one array per field.\n"
          "    -b        - Don't load builtin Rune files.\n"
+         "    -fastmath <flags> - Let the optimizer ignore strict IEEE semantics in all\n"
+         "                floating point code.  <flags> is \"fast\", or a comma separated\n"
+         "                list of LLVM fast-math flags: nnan, ninf, nsz, arcp, contract,\n"
+         "                afn, and reassoc.  Functions declared with fastmath always use\n"
+         "                \"fast\".\n"
          "    -g        - Include debug information for gdb.  Implies -l.\n"
+         "    -groupfields - Store class fields which are usually accessed together in\n"
+         "                tuples, as an array of structures.  Rarely accessed fields keep\n"
+         "                their own arrays.\n"
+         "    -j <n>    - Split the program into <n> modules, and compile them with <n>\n"
+         "                parallel clang processes.  With -l, the modules are also written\n"
+         "                to <llvmfile base>.<i>.ll.  Ignored with -g.\n"
          "    -l <llvmfile> - Write LLVM IR to <llvmfile>.\n"
          "    -L        - Log tokens parsed to rune.log.\n"
+         "    -llvmapi  - Compile in-process with the LLVM C API, rather than running clang\n"
+         "                on a .ll file.  Clang is still used to link.\n"
+         "    -mattr <features> - Set the target-features attribute of every function,\n"
+         "                like \"+avx2,+fma\".\n"
+         "    -mcpu <cpu> - Set the target-cpu attribute of every function, like skylake.\n"
          "    -n        - No clang.  Don't compile the resulting .ll output.\n"
-         "    -O        - Optimized build.  Passes -O3 to clang.\n"
+         "    -nativebigint <width> - Add, subtract, compare and shift bigints up to\n"
+         "                <width> bits as native LLVM integers.  Default 256, 0 disables.\n"
+         "    -nodedupe - Keep every function instantiation, even when its LLVM IR is\n"
+         "                identical to another's.  By default, duplicates call one copy.\n"
+         "    -nolto    - Link the runtime as a static library in optimized builds, rather\n"
+         "                than as bitcode optimized together with the program.\n"
+         "    -norefelide - Reference count every local, even those which only hold\n"
+         "                const parameters, and call ref and unref rather than inlining them.\n"
+         "    -notbaa   - Emit no TBAA metadata, so LLVM must assume field arrays may\n"
+         "                alias each other and array headers.\n"
+         "    -O        - Optimized build.  Passes -O3 to clang.  If lib/librune.bc exists,\n"
+         "                the runtime is linked as bitcode with LTO, which needs lld\n"
+         "                unless using -llvmapi.\n"
          "    -p <dir>  - Use <dir> as the root directory for Rune's builtin packages.\n"
+         "    -profile-generate - Build an instrumented binary which writes an LLVM\n"
+         "                profile to default_*.profraw when run.  Merge profiles with\n"
+         "                llvm-profdata merge -o <file> default_*.profraw.\n"
+         "    -profile-use=<file> - Optimize using the merged profile <file>.  Use\n"
+         "                the same source and flags, other than this one, as with\n"
+         "                -profile-generate.\n"
+         "    -passes <pipeline> - LLVM pass pipeline for -llvmapi, in opt -passes syntax.\n"
+         "                Default \"default<O3>\" with -O, otherwise \"default<O0>\".\n"
          "    -r <dir>  - Use <dir> as the root directory for the project's packages.\n"
+         "    -showboundschecks - Print how many bounds and null checks are left in\n"
+         "                each function, and how many were eliminated in total.\n"
+         "    -showdedupe - Print each function which became a thunk calling an\n"
+         "                identical function.\n"
+         "    -showfieldgroups - Print the field layout chosen for each class, with the\n"
+         "                estimated access counts used by -groupfields.\n"
          "    -t        - Execute unit tests for all modules.\n"
+         "    -timellvmapi - With -llvmapi, print the time spent printing and parsing the\n"
+         "                generated IR, linking the runtime, running passes, and writing\n"
+         "                the object.\n"
          "    -U        - Unsafe mode.  Don't generate bounds checking, overflow\n"
          "                detection, and destroyed object access detection.\n"
          "    -x        - Invert the return code: 0 if we fail, and 1 if we pass.\n");
@@ -62,17 +316,34 @@ int main(int argc, char** argv) {
   deLogTokens = false;
   deInvertReturnCode = false;
   deTestMode = false;
+  deStableSignatureNames = false;
+  deArrayOfStructs = false;
+  deGroupFields = false;
+  deShowFieldGroups = false;
+  deElideRefCounting = true;
   deUnsafeMode = false;
   deRunePackageDir = NULL;
   deProjectPackageDir = NULL;
   bool noClang = false;
   bool optimized = false;
+  bool useLLVMAPI = false;
+  char *passes = NULL;
   deLLVMFileName = NULL;
   bool parseBuiltinFunctions = true;
   uint32 xArg = 1;
   while (xArg < argc && argv[xArg][0] == '-') {
     if (!strcmp(argv[xArg], "-g")) {
       deDebugMode = true;
+    } else if (!strcmp(argv[xArg], "-aos")) {
+      deArrayOfStructs = true;
+    } else if (!strcmp(argv[xArg], "-groupfields")) {
+      deGroupFields = true;
+    } else if (!strcmp(argv[xArg], "-showboundschecks")) {
+      llShowBoundsChecks = true;
+    } else if (!strcmp(argv[xArg], "-showdedupe")) {
+      llShowSharedFunctions = true;
+    } else if (!strcmp(argv[xArg], "-showfieldgroups")) {
+      deShowFieldGroups = true;
     } else if (!strcmp(argv[xArg], "-b")) {
       parseBuiltinFunctions = false;
     } else if (!strcmp(argv[xArg], "-t")) {
@@ -83,32 +354,89 @@ int main(int argc, char** argv) {
       deUnsafeMode = true;
     } else if (!strcmp(argv[xArg], "-l")) {
       if (++xArg == argc) {
-        printf("-l requires the output LLVM IR file name");
+        printf("-l requires the output LLVM IR file name\n");
         return 1;
       }
       deLLVMFileName = argv[xArg];
+    } else if (!strcmp(argv[xArg], "-j")) {
+      if (++xArg == argc || atoi(argv[xArg]) < 1) {
+        printf("-j requires a positive number of parallel jobs\n");
+        return 1;
+      }
+      deNumJobs = atoi(argv[xArg]);
     } else if (!strcmp(argv[xArg], "-L")) {
       deLogTokens = true;
     } else if (!strcmp(argv[xArg], "-n")) {
       noClang = true;
+    } else if (!strcmp(argv[xArg], "-profile-generate")) {
+      deProfileGenerate = true;
+      deStableSignatureNames = true;
+    } else if (!strncmp(argv[xArg], "-profile-use=", sizeof("-profile-use=") - 1)) {
+      deProfileUse = argv[xArg] + sizeof("-profile-use=") - 1;
+      if (*deProfileUse == '\0') {
+        printf("-profile-use= requires a profile file name\n");
+        return 1;
+      }
+      deStableSignatureNames = true;
+    } else if (!strcmp(argv[xArg], "-nodedupe")) {
+      llShareIdenticalFunctions = false;
+    } else if (!strcmp(argv[xArg], "-notbaa")) {
+      llEmitTBAA = false;
+    } else if (!strcmp(argv[xArg], "-norefelide")) {
+      deElideRefCounting = false;
+    } else if (!strcmp(argv[xArg], "-nolto")) {
+      deUseLTO = false;
+    } else if (!strcmp(argv[xArg], "-llvmapi")) {
+      useLLVMAPI = true;
+    } else if (!strcmp(argv[xArg], "-timellvmapi")) {
+      llTimeLLVMAPI = true;
+    } else if (!strcmp(argv[xArg], "-passes")) {
+      if (++xArg == argc) {
+        printf("-passes requires an LLVM pass pipeline\n");
+        return 1;
+      }
+      passes = argv[xArg];
     } else if (!strcmp(argv[xArg], "-p")) {
       if (++xArg == argc) {
-        printf("-p requires a path to the root package directory");
+        printf("-p requires a path to the root package directory\n");
         return 1;
       }
       deRunePackageDir = argv[xArg];
     } else if (!strcmp(argv[xArg], "-r")) {
       if (++xArg == argc) {
-        printf("-p requires a path to the root package directory");
+        printf("-p requires a path to the root package directory\n");
         return 1;
       }
       deProjectPackageDir = argv[xArg];
     } else if (!strcmp(argv[xArg], "-clang")) {
       if (++xArg == argc) {
-        printf("-C requires a path argument to the clang executable");
+        printf("-C requires a path argument to the clang executable\n");
         return 1;
       }
       deClangPath = argv[xArg];
+    } else if (!strcmp(argv[xArg], "-nativebigint")) {
+      if (++xArg == argc) {
+        printf("-nativebigint requires a bigint width argument\n");
+        return 1;
+      }
+      llNativeBigintWidth = atoi(argv[xArg]);
+    } else if (!strcmp(argv[xArg], "-fastmath")) {
+      if (++xArg == argc || (llFastMathFlags = parseFastMathFlags(argv[xArg])) == NULL) {
+        printf("-fastmath requires \"fast\" or a comma separated list of fast-math flags\n");
+        return 1;
+      }
+    } else if (!strcmp(argv[xArg], "-mcpu")) {
+      if (++xArg == argc) {
+        printf("-mcpu requires a target CPU name\n");
+        return 1;
+      }
+      llTargetCpu = argv[xArg];
+    } else if (!strcmp(argv[xArg], "-mattr")) {
+      if (++xArg == argc) {
+        printf("-mattr requires a list of target features\n");
+        return 1;
+      }
+      llTargetFeatures = argv[xArg];
     } else if (!strcmp(argv[xArg], "-x")) {
       deInvertReturnCode = true;
     }  else {
@@ -119,6 +447,14 @@ int main(int argc, char** argv) {
   if (xArg + 1 != argc) {
     usage();
   }
+  if (useLLVMAPI && (deProfileGenerate || deProfileUse != NULL)) {
+    printf("Profile guided optimization is only supported without -llvmapi\n");
+    return 1;
+  }
+  if (useLLVMAPI && deNumJobs > 1) {
+    printf("Parallel code generation with -j is only supported without -llvmapi\n");
+    return 1;
+  }
   char* fileName = argv[xArg];
   deStart(fileName);
   if (!utSetjmp()) {
@@ -132,23 +468,61 @@ int main(int argc, char** argv) {
     deCreateLocalAndGlobalVariables();
     deBind();
     deVerifyRelationshipGraph();
+    deFindFieldGroups();
     deAddMemoryManagement();
     deInlineIterators();
+    deFindLastUses();
+    if (deElideRefCounting) {
+      deFindBorrowedVariables();
+    }
     // We generate new code in memory management and such, so check binding
     // succeeded.
     deReportEvents();
+    // The in-process and parallel backends only write the .ll file if asked.
+    bool writeLLVM = deLLVMFileName != NULL || deDebugMode;
     if (deLLVMFileName == NULL) {
       deLLVMFileName = utAllocString(utReplaceSuffix(fileName, ".ll"));
     } else {
       // Since we call utFree on this below.
       deLLVMFileName = utAllocString(deLLVMFileName);
     }
-    llGenerateLLVMAssemblyCode(deLLVMFileName, deDebugMode);
-    if (!noClang) {
-      int rc = runClangCompiler(deLLVMFileName, deDebugMode, optimized);
+    if (useLLVMAPI && !noClang) {
+      size_t length;
+      // Printing the IR as text is the other half of what an IR builder would
+      // save, so time it along with the parse.
+      clock_t start = clock();
+      char *text = llGenerateLLVMAssemblyText(deLLVMFileName, deDebugMode, &length);
+      if (llTimeLLVMAPI) {
+        printf("LLVM IR text %.3fs, %zu bytes\n",
+            (double)(clock() - start) / CLOCKS_PER_SEC, length);
+      }
+      if (writeLLVM) {
+        writeLLVMFile(deLLVMFileName, text, length);
+      }
+      int rc = runLLVMAPICompiler(text, length, deLLVMFileName, passes, deDebugMode, optimized);
+      free(text);
       if (rc != 0) {
         return rc;
       }
+    } else if (deNumJobs > 1 && !deDebugMode && !noClang) {
+      size_t length;
+      char *text = llGenerateLLVMAssemblyText(deLLVMFileName, deDebugMode, &length);
+      if (writeLLVM) {
+        writeLLVMFile(deLLVMFileName, text, length);
+      }
+      int rc = runParallelClangCompiler(text, length, deLLVMFileName, optimized, writeLLVM);
+      free(text);
+      if (rc != 0) {
+        return rc;
+      }
+    } else {
+      llGenerateLLVMAssemblyCode(deLLVMFileName, deDebugMode);
+      if (!noClang) {
+        int rc = runClangCompiler(deLLVMFileName, deDebugMode, optimized);
+        if (rc != 0) {
+          return rc;
+        }
+      }
     }
     utFree(deLLVMFileName);
     utUnsetjmp();
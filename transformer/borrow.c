@@ -0,0 +1,179 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Find local variables holding reference counted objects which can borrow a
+// reference rather than own one.  Parameters are already borrowed from the
+// caller, and const parameters cannot be reassigned, so their objects outlive
+// the call.  A local is borrowed if every assignment to it is
+//
+//   a = <const parameter>
+//   a = <borrowed local>
+//   a = null(...)
+//
+// and it is never passed to a var parameter, which could assign it.  The code
+// generator stores borrowed locals without calling ref and unref, and does not
+// unref them on return.  Returning a borrowed local still refs it.
+
+#include "de.h"
+
+// Set when a pass over a block finds a local which is not borrowed.
+static bool deFoundOwner;
+
+// Determine if the variable is a candidate for borrowing: a local holding a
+// reference counted object in |block|.
+static bool isCandidate(deVariable variable, deBlock block) {
+  if (deVariableGetType(variable) != DE_VAR_LOCAL || deVariableGenerated(variable) ||
+      deVariableGetBlock(variable) != block) {
+    return false;
+  }
+  deDatatype datatype = deVariableGetDatatype(variable);
+  return datatype != deDatatypeNull && deDatatypeGetType(datatype) == DE_TYPE_CLASS &&
+      deTemplateRefCounted(deClassGetTemplate(deDatatypeGetClass(datatype)));
+}
+
+// Return the variable the expression names, if any.
+static deVariable findVariable(deExpression expression) {
+  if (deExpressionGetType(expression) != DE_EXPR_IDENT) {
+    return deVariableNull;
+  }
+  deIdent ident = deExpressionGetIdent(expression);
+  if (ident == deIdentNull || deIdentGetType(ident) != DE_IDENT_VARIABLE) {
+    return deVariableNull;
+  }
+  return deIdentGetVariable(ident);
+}
+
+// Determine if a borrowed local can be assigned the value of the expression.
+static bool isBorrowedSource(deExpression expression, deBlock block) {
+  if (deExpressionGetType(expression) == DE_EXPR_NULL) {
+    return true;
+  }
+  deVariable variable = findVariable(expression);
+  if (variable == deVariableNull || deVariableGetBlock(variable) != block) {
+    return false;
+  }
+  if (deVariableGetType(variable) == DE_VAR_PARAMETER) {
+    return deVariableConst(variable);
+  }
+  return deVariableBorrowed(variable);
+}
+
+// Return the call the expression is passed to, either as a parameter or as
+// self, or deExpressionNull if it is not passed to a call.
+static deExpression findCall(deExpression expression) {
+  deExpression parent = deExpressionGetExpression(expression);
+  if (parent != deExpressionNull && deExpressionGetType(parent) == DE_EXPR_NAMEDPARAM) {
+    parent = deExpressionGetExpression(parent);
+  }
+  if (parent == deExpressionNull) {
+    return deExpressionNull;
+  }
+  deExpressionType type = deExpressionGetType(parent);
+  if (type != DE_EXPR_LIST && type != DE_EXPR_DOT) {
+    return deExpressionNull;
+  }
+  deExpression call = deExpressionGetExpression(parent);
+  if (call == deExpressionNull || deExpressionGetType(call) != DE_EXPR_CALL) {
+    return deExpressionNull;
+  }
+  return call;
+}
+
+// Determine if the call might assign a variable passed to it.  Builtin calls
+// do not assign objects passed to them.
+static bool callMayAssignParameters(deExpression call) {
+  deSignature signature = deExpressionGetSignature(call);
+  if (signature == deSignatureNull) {
+    deDatatype callType = deExpressionGetDatatype(deExpressionGetFirstExpression(call));
+    return callType == deDatatypeNull || deDatatypeGetType(callType) != DE_TYPE_FUNCTION ||
+        !deFunctionBuiltin(deDatatypeGetFunction(callType));
+  }
+  deVariable variable;
+  deForeachBlockVariable(deSignatureGetBlock(signature), variable) {
+    if (deVariableGetType(variable) == DE_VAR_PARAMETER && !deVariableConst(variable)) {
+      return true;
+    }
+  } deEndBlockVariable;
+  return false;
+}
+
+// Determine if the use of the variable prevents it from borrowing.
+static bool useNeedsOwner(deExpression expression, deBlock block) {
+  deExpression parent = deExpressionGetExpression(expression);
+  if (parent != deExpressionNull && deExpressionGetType(parent) == DE_EXPR_EQUALS &&
+      deExpressionGetFirstExpression(parent) == expression) {
+    return !isBorrowedSource(deExpressionGetLastExpression(parent), block);
+  }
+  deExpression call = findCall(expression);
+  return call != deExpressionNull && callMayAssignParameters(call);
+}
+
+// Clear the borrowed flag on locals in the expression that need an owner.
+static void checkExpression(deExpression expression, deBlock block) {
+  deVariable variable = findVariable(expression);
+  if (variable != deVariableNull && deVariableBorrowed(variable) &&
+      useNeedsOwner(expression, block)) {
+    deVariableSetBorrowed(variable, false);
+    deFoundOwner = true;
+  }
+  deExpression child;
+  deForeachExpressionExpression(expression, child) {
+    checkExpression(child, block);
+  } deEndExpressionExpression;
+}
+
+// Clear the borrowed flag on locals in the block's statements that need an
+// owner.
+static void checkBlock(deBlock block, deBlock functionBlock) {
+  deStatement statement;
+  deForeachBlockStatement(block, statement) {
+    deExpression expression = deStatementGetExpression(statement);
+    if (expression != deExpressionNull) {
+      checkExpression(expression, functionBlock);
+    }
+    deBlock subBlock = deStatementGetSubBlock(statement);
+    if (subBlock != deBlockNull) {
+      checkBlock(subBlock, functionBlock);
+    }
+  } deEndBlockStatement;
+}
+
+// Find the borrowed locals of the function.  Start by assuming all candidates
+// are borrowed, and clear the flag on those that need an owner until nothing
+// changes, since clearing one can make locals assigned from it need owners.
+static void findBlockBorrowedVariables(deBlock block) {
+  deVariable variable;
+  deForeachBlockVariable(block, variable) {
+    deVariableSetBorrowed(variable, isCandidate(variable, block));
+  } deEndBlockVariable;
+  do {
+    deFoundOwner = false;
+    checkBlock(block, block);
+  } while (deFoundOwner);
+}
+
+// Find locals in instantiated functions which can borrow references to
+// objects, rather than reference counting them.
+void deFindBorrowedVariables(void) {
+  deSignature signature;
+  deForeachRootSignature(deTheRoot, signature) {
+    if (deSignatureInstantiated(signature)) {
+      deBlock block = deSignatureGetBlock(signature);
+      deFunctionType type = deFunctionGetType(deBlockGetOwningFunction(block));
+      if (type != DE_FUNC_MODULE && type != DE_FUNC_PACKAGE && type != DE_FUNC_CONSTRUCTOR) {
+        findBlockBorrowedVariables(block);
+      }
+    }
+  } deEndRootSignature;
+}
@@ -0,0 +1,366 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Decide which class fields are stored together in tuples, in an
+// array-of-structures layout, and which keep their own global arrays.  By
+// default, every field has its own array.  Classes declared with aos, or all
+// classes with -aos, store every field that can be grouped in one tuple.
+//
+// With -groupfields, we estimate how often each field is accessed, and how
+// often pairs of fields are accessed in the same loop body or function, from
+// the bound code.  Each loop level multiplies the estimate by DE_LOOP_WEIGHT.
+// Fields which are usually accessed together share a tuple, so reading an
+// object's hot fields touches one cache line.  Rarely accessed fields stay in
+// their own arrays, so they do not dilute the cache lines of hot fields.
+
+#include "de.h"
+
+// Each loop level multiplies the estimated execution count by this.
+#define DE_LOOP_WEIGHT 8
+// Loops nested deeper than this are not weighted more, to avoid overflow.
+#define DE_MAX_LOOP_DEPTH 8
+// Fields accessed less than 1/DE_COLD_FIELD_RATIO as often as their class's
+// hottest field are cold.
+#define DE_COLD_FIELD_RATIO 16
+
+// Fields accessed in the current loop body or function, after those of the
+// enclosing regions.
+static deVariable *deRegionFields;
+static uint32 deRegionFieldsPos;
+static uint32 deRegionFieldsAllocated;
+
+// Determine if the field can be stored in a tuple with other fields.  Fields
+// containing arrays keep their own arrays, since resizing an array of tuples
+// does not update the back-pointers of arrays inside the tuples.
+static bool fieldCanBeGrouped(deVariable variable) {
+  return !deDatatypeContainsArray(deVariableGetDatatype(variable));
+}
+
+// Return the number of fields in the class.
+static uint32 countFields(deClass theClass) {
+  uint32 numFields = 0;
+  deVariable variable;
+  deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
+    numFields++;
+  } deEndBlockVariable;
+  return numFields;
+}
+
+// Return the position of the field in its class.
+static uint32 findFieldIndex(deVariable field) {
+  uint32 index = 0;
+  deVariable variable;
+  deForeachBlockVariable(deVariableGetBlock(field), variable) {
+    if (variable == field) {
+      return index;
+    }
+    index++;
+  } deEndBlockVariable;
+  utExit("Field not found in its class");
+  return 0;  // Dummy return.
+}
+
+// Return the class field read or written by the expression if it is a member
+// access like foo.x, otherwise deVariableNull.
+static deVariable findAccessedField(deExpression expression) {
+  if (deExpressionGetType(expression) != DE_EXPR_DOT) {
+    return deVariableNull;
+  }
+  deExpression left = deExpressionGetFirstExpression(expression);
+  deExpression right = deExpressionGetNextExpression(left);
+  deDatatype leftType = deExpressionGetDatatype(left);
+  if (leftType == deDatatypeNull || deDatatypeGetType(leftType) != DE_TYPE_CLASS ||
+      deExpressionGetType(right) != DE_EXPR_IDENT) {
+    return deVariableNull;
+  }
+  deClass theClass = deDatatypeGetClass(leftType);
+  deBlock block = deClassGetSubBlock(theClass);
+  deIdent ident = deBlockFindIdent(block, deExpressionGetName(right));
+  if (ident == deIdentNull || deIdentGetType(ident) != DE_IDENT_VARIABLE ||
+      deVariableGetBlock(deIdentGetVariable(ident)) != block || !deClassBound(theClass)) {
+    return deVariableNull;
+  }
+  return deIdentGetVariable(ident);
+}
+
+// Add the field to the fields accessed in the region starting at |regionStart|,
+// unless it is already there.
+static void recordFieldAccess(deVariable field, uint32 regionStart) {
+  for (uint32 i = regionStart; i < deRegionFieldsPos; i++) {
+    if (deRegionFields[i] == field) {
+      return;
+    }
+  }
+  if (deRegionFieldsPos == deRegionFieldsAllocated) {
+    deRegionFieldsAllocated <<= 1;
+    utResizeArray(deRegionFields, deRegionFieldsAllocated);
+  }
+  deRegionFields[deRegionFieldsPos++] = field;
+}
+
+// Record the fields accessed in the expression.
+static void findExpressionAccesses(deExpression expression, uint32 regionStart) {
+  deVariable field = findAccessedField(expression);
+  if (field != deVariableNull) {
+    recordFieldAccess(field, regionStart);
+  }
+  deExpression child;
+  deForeachExpressionExpression(expression, child) {
+    findExpressionAccesses(child, regionStart);
+  } deEndExpressionExpression;
+}
+
+// Add the weight of the region starting at |regionStart| to the fields it
+// accesses, and to each pair of fields of the same class it accesses.  Then
+// remove its fields from the region list.
+static void addRegionWeights(uint32 regionStart, uint32 loopDepth) {
+  uint64 weight = 1;
+  for (uint32 i = 0; i < loopDepth && i < DE_MAX_LOOP_DEPTH; i++) {
+    weight *= DE_LOOP_WEIGHT;
+  }
+  for (uint32 i = regionStart; i < deRegionFieldsPos; i++) {
+    deVariable field = deRegionFields[i];
+    deVariableSetAccessWeight(field, deVariableGetAccessWeight(field) + weight);
+    deBlock block = deVariableGetBlock(field);
+    deClass theClass = deBlockGetOwningClass(block);
+    uint32 numFields = countFields(theClass);
+    uint32 index = findFieldIndex(field);
+    for (uint32 j = i + 1; j < deRegionFieldsPos; j++) {
+      deVariable otherField = deRegionFields[j];
+      if (deVariableGetBlock(otherField) == block) {
+        uint32 otherIndex = findFieldIndex(otherField);
+        uint32 pos = index * numFields + otherIndex;
+        deClassSetiCoAccessWeight(theClass, pos, deClassGetiCoAccessWeight(theClass, pos) + weight);
+        pos = otherIndex * numFields + index;
+        deClassSetiCoAccessWeight(theClass, pos, deClassGetiCoAccessWeight(theClass, pos) + weight);
+      }
+    }
+  }
+  deRegionFieldsPos = regionStart;
+}
+
+// Determine if the statement's sub-block is the body of a loop.
+static bool isLoop(deStatement statement) {
+  deStatementType type = deStatementGetType(statement);
+  return type == DE_STATEMENT_DO || type == DE_STATEMENT_WHILE || type == DE_STATEMENT_FOR ||
+      type == DE_STATEMENT_FOREACH;
+}
+
+// Record the fields accessed in the block.  Loop bodies are regions of their
+// own, weighted more heavily than the region enclosing them.
+static void findBlockAccesses(deBlock block, uint32 regionStart, uint32 loopDepth) {
+  deStatement statement;
+  deForeachBlockStatement(block, statement) {
+    deExpression expression = deStatementGetExpression(statement);
+    if (expression != deExpressionNull) {
+      findExpressionAccesses(expression, regionStart);
+    }
+    deBlock subBlock = deStatementGetSubBlock(statement);
+    if (subBlock != deBlockNull) {
+      if (isLoop(statement)) {
+        uint32 loopStart = deRegionFieldsPos;
+        findBlockAccesses(subBlock, loopStart, loopDepth + 1);
+        addRegionWeights(loopStart, loopDepth + 1);
+      } else {
+        findBlockAccesses(subBlock, regionStart, loopDepth);
+      }
+    }
+  } deEndBlockStatement;
+}
+
+// Estimate field access weights from the bodies of instantiated functions.
+static void findFieldAccessWeights(void) {
+  deRegionFieldsAllocated = 32;
+  deRegionFieldsPos = 0;
+  deRegionFields = utNewA(deVariable, deRegionFieldsAllocated);
+  deSignature signature;
+  deForeachRootSignature(deTheRoot, signature) {
+    if (deSignatureInstantiated(signature)) {
+      findBlockAccesses(deSignatureGetBlock(signature), 0, 0);
+      addRegionWeights(0, 0);
+    }
+  } deEndRootSignature;
+  utFree(deRegionFields);
+}
+
+// Put every field that can be grouped in one tuple, as long as there are at
+// least two of them.
+static void groupAllFields(deClass theClass) {
+  uint32 numGroupable = 0;
+  deVariable variable;
+  deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
+    if (fieldCanBeGrouped(variable)) {
+      numGroupable++;
+    }
+  } deEndBlockVariable;
+  if (numGroupable < 2) {
+    return;
+  }
+  uint32 tupleIndex = 0;
+  deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
+    if (fieldCanBeGrouped(variable)) {
+      deVariableSetFieldGroup(variable, 1);
+      deVariableSetTupleIndex(variable, tupleIndex++);
+    }
+  } deEndBlockVariable;
+}
+
+// Find the representative of the field's set of co-accessed fields.
+static uint32 findSet(uint32 *sets, uint32 index) {
+  while (sets[index] != index) {
+    sets[index] = sets[sets[index]];
+    index = sets[index];
+  }
+  return index;
+}
+
+// Put hot fields in the same tuple when at least half the accesses to each of
+// them are in regions that access the other.  Hot fields not accessed with any
+// other, and cold fields, keep their own arrays.
+//
+// The nextFree field, which is also the reference count, is only accessed by
+// the allocate, free, ref and unref functions, which deAddMemoryManagement
+// generates after this pass.  It has no weight here, so it keeps its own array.
+// That is deliberate: ref and unref run when references are copied, usually
+// without touching other fields, and the free list walks freed objects, so
+// neither should pull in the cache lines of the hot fields.
+static void groupCoAccessedFields(deClass theClass) {
+  uint32 numFields = countFields(theClass);
+  deVariable *fields = utNewA(deVariable, numFields);
+  uint32 *sets = utNewA(uint32, numFields);
+  uint32 *setSizes = utNewA(uint32, numFields);
+  uint32 *groups = utNewA(uint32, numFields);
+  uint32 *groupSizes = utNewA(uint32, numFields + 1);
+  uint64 maxWeight = 0;
+  uint32 index = 0;
+  deVariable variable;
+  deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
+    fields[index] = variable;
+    sets[index] = index;
+    setSizes[index] = 0;
+    groups[index] = 0;
+    groupSizes[index] = 0;
+    if (deVariableGetAccessWeight(variable) > maxWeight) {
+      maxWeight = deVariableGetAccessWeight(variable);
+    }
+    index++;
+  } deEndBlockVariable;
+  for (uint32 i = 0; i < numFields; i++) {
+    uint64 weight = deVariableGetAccessWeight(fields[i]);
+    if (!fieldCanBeGrouped(fields[i]) || weight == 0 || weight * DE_COLD_FIELD_RATIO < maxWeight) {
+      continue;
+    }
+    for (uint32 j = i + 1; j < numFields; j++) {
+      uint64 otherWeight = deVariableGetAccessWeight(fields[j]);
+      if (!fieldCanBeGrouped(fields[j]) || otherWeight == 0 ||
+          otherWeight * DE_COLD_FIELD_RATIO < maxWeight) {
+        continue;
+      }
+      uint64 coWeight = deClassGetiCoAccessWeight(theClass, i * numFields + j);
+      if (2 * coWeight >= weight && 2 * coWeight >= otherWeight) {
+        sets[findSet(sets, j)] = findSet(sets, i);
+      }
+    }
+  }
+  for (uint32 i = 0; i < numFields; i++) {
+    setSizes[findSet(sets, i)]++;
+  }
+  // Number the groups in field order, so the layout is deterministic.
+  uint32 numGroups = 0;
+  for (uint32 i = 0; i < numFields; i++) {
+    uint32 set = findSet(sets, i);
+    if (setSizes[set] >= 2) {
+      if (groups[set] == 0) {
+        groups[set] = ++numGroups;
+      }
+      uint32 group = groups[set];
+      deVariableSetFieldGroup(fields[i], group);
+      deVariableSetTupleIndex(fields[i], groupSizes[group]++);
+    }
+  }
+  utFree(fields);
+  utFree(sets);
+  utFree(setSizes);
+  utFree(groups);
+  utFree(groupSizes);
+}
+
+// Print the layout chosen for the class's fields.
+static void reportFieldGroups(deClass theClass) {
+  printf("Field layout for %s:\n", deDatatypeGetTypeString(deClassGetDatatype(theClass)));
+  uint32 maxGroup = 0;
+  deVariable variable;
+  deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
+    if (deVariableGetFieldGroup(variable) > maxGroup) {
+      maxGroup = deVariableGetFieldGroup(variable);
+    }
+  } deEndBlockVariable;
+  for (uint32 group = 0; group <= maxGroup; group++) {
+    bool firstTime = true;
+    deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
+      if (deVariableGetFieldGroup(variable) == group) {
+        if (firstTime) {
+          if (group == 0) {
+            printf("  own arrays:");
+          } else {
+            printf("  tuple %u:", group);
+          }
+        }
+        printf("%s %s", firstTime? "" : ",", deVariableGetName(variable));
+        if (deGroupFields) {
+          printf(" (%llu)", (unsigned long long)deVariableGetAccessWeight(variable));
+        }
+        firstTime = false;
+      }
+    } deEndBlockVariable;
+    if (!firstTime) {
+      printf("\n");
+    }
+  }
+}
+
+// Set the field group and tuple index of each field of bound classes.
+void deFindFieldGroups(void) {
+  deClass theClass;
+  deForeachRootClass(deTheRoot, theClass) {
+    if (deClassBound(theClass)) {
+      uint32 numFields = countFields(theClass);
+      deClassAllocCoAccessWeights(theClass, numFields * numFields);
+      for (uint32 i = 0; i < numFields * numFields; i++) {
+        deClassSetiCoAccessWeight(theClass, i, 0);
+      }
+      deVariable variable;
+      deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
+        deVariableSetFieldGroup(variable, 0);
+        deVariableSetAccessWeight(variable, 0);
+      } deEndBlockVariable;
+    }
+  } deEndRootClass;
+  if (deGroupFields) {
+    findFieldAccessWeights();
+  }
+  deForeachRootClass(deTheRoot, theClass) {
+    if (deClassBound(theClass)) {
+      if (deArrayOfStructs || deTemplateArrayOfStructs(deClassGetTemplate(theClass))) {
+        groupAllFields(theClass);
+      } else if (deGroupFields) {
+        groupCoAccessedFields(theClass);
+      }
+      deClassFreeCoAccessWeights(theClass);
+      if (deShowFieldGroups) {
+        reportFieldGroups(theClass);
+      }
+    }
+  } deEndRootClass;
+}
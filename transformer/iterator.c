@@ -219,6 +219,19 @@ deStatement deInlineIterator(deBlock scopeBlock, deStatement statement) {
   return deStatementGetNextBlockStatement(prevStatement);
 }
 
+// Determine if the foreach statement calls a coroutine iterator, which the
+// code generator compiles as a separate function rather than inlining.
+static bool callsCoroutine(deStatement statement) {
+  deExpression assignment = deStatementGetExpression(statement);
+  deExpression call = deExpressionGetNextExpression(deExpressionGetFirstExpression(assignment));
+  if (deExpressionGetType(call) != DE_EXPR_CALL) {
+    return false;
+  }
+  deSignature signature = deExpressionGetSignature(call);
+  return signature != deSignatureNull &&
+      deFunctionCoroutine(deSignatureGetFunction(signature));
+}
+
 // Inline iterators in the block.  Return true if any iterators were inlined.
 static void inlineBlockIterators(deBlock scopeBlock, deBlock block) {
   bool inlinedIterator;
@@ -227,7 +240,7 @@ static void inlineBlockIterators(deBlock scopeBlock, deBlock block) {
     inlinedIterator = false;
     deSafeForeachBlockStatement(block, statement) {
       if (deStatementGetType(statement) == DE_STATEMENT_FOREACH &&
-          deStatementInstantiated(statement)) {
+          deStatementInstantiated(statement) && !callsCoroutine(statement)) {
         deInlineIterator(scopeBlock, statement);
         inlinedIterator = true;
       }
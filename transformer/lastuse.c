@@ -0,0 +1,267 @@
+//  Copyright 2021 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Find the last uses of local arrays and strings, where the code generator
+// can move the array rather than copy it.  Only two kinds of uses are moved:
+//
+//   dest = a
+//   list.append(a)
+//
+// The use must be the last read of |a| in the function.  If it is in a loop,
+// |a| must also be assigned at the top level of each enclosing loop body,
+// before any other read in that loop, so each iteration moves a fresh value.
+// This is conservative: statements in different branches of an if statement
+// are treated as if they both run.
+
+#include "de.h"
+
+// Determine if the variable is a local array or string, which only its own
+// function can access.
+static bool isLocalArray(deVariable variable) {
+  if (variable == deVariableNull || deVariableGetType(variable) != DE_VAR_LOCAL) {
+    return false;
+  }
+  deFunction function = deBlockGetOwningFunction(deVariableGetBlock(variable));
+  deFunctionType funcType = deFunctionGetType(function);
+  if (funcType == DE_FUNC_MODULE || funcType == DE_FUNC_PACKAGE) {
+    return false;
+  }
+  deDatatypeType type = deDatatypeGetType(deVariableGetDatatype(variable));
+  return type == DE_TYPE_ARRAY || type == DE_TYPE_STRING;
+}
+
+// Return the local array variable the expression names, if any.
+static deVariable findLocalArray(deExpression expression) {
+  if (deExpressionGetType(expression) != DE_EXPR_IDENT) {
+    return deVariableNull;
+  }
+  deIdent ident = deExpressionGetIdent(expression);
+  if (ident == deIdentNull || deIdentGetType(ident) != DE_IDENT_VARIABLE) {
+    return deVariableNull;
+  }
+  deVariable variable = deIdentGetVariable(ident);
+  return isLocalArray(variable)? variable : deVariableNull;
+}
+
+// Determine if the expression is the left side of a plain assignment, which
+// writes the variable without reading it.
+static bool isWrite(deExpression expression) {
+  deExpression parent = deExpressionGetExpression(expression);
+  return parent != deExpressionNull && deExpressionGetType(parent) == DE_EXPR_EQUALS &&
+      deExpressionGetFirstExpression(parent) == expression;
+}
+
+// Return |statement| if it is in |block|, or the statement in |block| that
+// contains it.  Return deStatementNull if |block| does not contain it.
+static deStatement findStatementInBlock(deStatement statement, deBlock block) {
+  while (statement != deStatementNull) {
+    deBlock parent = deStatementGetBlock(statement);
+    if (parent == block) {
+      return statement;
+    }
+    statement = deBlockGetOwningStatement(parent);
+  }
+  return deStatementNull;
+}
+
+// Determine if |first| always finishes before |second| starts, within one run
+// of their innermost common block.  This is false if either contains the
+// other.
+static bool runsBefore(deStatement first, deStatement second) {
+  deStatement statement = first;
+  while (statement != deStatementNull) {
+    deBlock block = deStatementGetBlock(statement);
+    deStatement other = findStatementInBlock(second, block);
+    if (other != deStatementNull) {
+      if (other == statement) {
+        return false;
+      }
+      deStatement next = deStatementGetNextBlockStatement(statement);
+      for (; next != deStatementNull; next = deStatementGetNextBlockStatement(next)) {
+        if (next == other) {
+          return true;
+        }
+      }
+      return false;
+    }
+    statement = deBlockGetOwningStatement(block);
+  }
+  return false;
+}
+
+// Determine if the statement is a loop.
+static bool isLoop(deStatement statement) {
+  deStatementType type = deStatementGetType(statement);
+  return type == DE_STATEMENT_DO || type == DE_STATEMENT_WHILE ||
+      type == DE_STATEMENT_FOR || type == DE_STATEMENT_FOREACH;
+}
+
+// Find the first statement at the top level of the loop body that assigns the
+// variable, as in a = <expression>.
+static deStatement findLoopAssignment(deStatement loop, deVariable variable) {
+  deStatement statement;
+  deForeachBlockStatement(deStatementGetSubBlock(loop), statement) {
+    deExpression expression = deStatementGetExpression(statement);
+    if (deStatementGetType(statement) == DE_STATEMENT_ASSIGN &&
+        deExpressionGetType(expression) == DE_EXPR_EQUALS &&
+        findLocalArray(deExpressionGetFirstExpression(expression)) == variable) {
+      return statement;
+    }
+  } deEndBlockStatement;
+  return deStatementNull;
+}
+
+// Determine if a read of the variable in |statement| allows moving it at
+// |lastUse| in |moveStatement|.  The read must run before the move, and after
+// the assignment at the top of each loop containing both.
+static bool readAllowsMove(deStatement statement, deStatement moveStatement, deVariable variable) {
+  if (!runsBefore(statement, moveStatement)) {
+    return false;
+  }
+  deStatement loop = deBlockGetOwningStatement(deStatementGetBlock(moveStatement));
+  while (loop != deStatementNull) {
+    if (isLoop(loop) &&
+        findStatementInBlock(statement, deStatementGetSubBlock(loop)) != deStatementNull &&
+        !runsBefore(findLoopAssignment(loop, variable), statement)) {
+      return false;
+    }
+    loop = deBlockGetOwningStatement(deStatementGetBlock(loop));
+  }
+  return true;
+}
+
+// Determine if every read of the variable in the expression, other than
+// |lastUse|, allows the move.
+static bool expressionAllowsMove(deExpression expression, deStatement statement,
+    deExpression lastUse, deStatement moveStatement, deVariable variable) {
+  if (expression != lastUse && deExpressionGetType(expression) == DE_EXPR_IDENT &&
+      deExpressionGetName(expression) == deVariableGetSym(variable) && !isWrite(expression) &&
+      !readAllowsMove(statement, moveStatement, variable)) {
+    return false;
+  }
+  deExpression child;
+  deForeachExpressionExpression(expression, child) {
+    if (!expressionAllowsMove(child, statement, lastUse, moveStatement, variable)) {
+      return false;
+    }
+  } deEndExpressionExpression;
+  return true;
+}
+
+// Determine if every read of the variable in the block allows the move.
+// Reads are found by name, so shadowing names only make this conservative.
+static bool blockAllowsMove(deBlock block, deExpression lastUse,
+    deStatement moveStatement, deVariable variable) {
+  deStatement statement;
+  deForeachBlockStatement(block, statement) {
+    deExpression expression = deStatementGetExpression(statement);
+    if (expression != deExpressionNull &&
+        !expressionAllowsMove(expression, statement, lastUse, moveStatement, variable)) {
+      return false;
+    }
+    deBlock subBlock = deStatementGetSubBlock(statement);
+    if (subBlock != deBlockNull &&
+        !blockAllowsMove(subBlock, lastUse, moveStatement, variable)) {
+      return false;
+    }
+  } deEndBlockStatement;
+  return true;
+}
+
+// Determine if every loop containing the statement assigns the variable at
+// the top of its body, before the statement.
+static bool loopsReassign(deStatement statement, deVariable variable) {
+  deStatement loop = deBlockGetOwningStatement(deStatementGetBlock(statement));
+  while (loop != deStatementNull) {
+    if (isLoop(loop)) {
+      deStatement assignment = findLoopAssignment(loop, variable);
+      if (assignment == deStatementNull || !runsBefore(assignment, statement)) {
+        return false;
+      }
+    }
+    loop = deBlockGetOwningStatement(deStatementGetBlock(loop));
+  }
+  return true;
+}
+
+// Determine if the expression is the value of dest = a, or the element of
+// list.append(a), where the code generator can move an array.
+static bool isMovableUse(deExpression expression, deStatement statement) {
+  deExpression parent = deExpressionGetExpression(expression);
+  if (parent == deExpressionNull) {
+    return false;
+  }
+  deExpressionType parentType = deExpressionGetType(parent);
+  if (parentType == DE_EXPR_EQUALS) {
+    deExpression dest = deExpressionGetFirstExpression(parent);
+    return deStatementGetType(statement) == DE_STATEMENT_ASSIGN &&
+        deExpressionGetExpression(parent) == deExpressionNull &&
+        deExpressionGetLastExpression(parent) == expression &&
+        findLocalArray(dest) != findLocalArray(expression);
+  }
+  deExpression call = deExpressionGetExpression(parent);
+  if (parentType != DE_EXPR_LIST || call == deExpressionNull ||
+      deExpressionGetType(call) != DE_EXPR_CALL) {
+    return false;
+  }
+  deDatatype callType = deExpressionGetDatatype(deExpressionGetFirstExpression(call));
+  if (callType == deDatatypeNull || deDatatypeGetType(callType) != DE_TYPE_FUNCTION) {
+    return false;
+  }
+  deFunction function = deDatatypeGetFunction(callType);
+  return deFunctionBuiltin(function) &&
+      deFunctionGetBuiltinType(function) == DE_BUILTINFUNC_ARRAYAPPEND;
+}
+
+// Mark the last uses in the expression.
+static void findExpressionLastUses(deBlock functionBlock, deExpression expression,
+    deStatement statement) {
+  deVariable variable = findLocalArray(expression);
+  if (variable != deVariableNull && isMovableUse(expression, statement) &&
+      loopsReassign(statement, variable) &&
+      blockAllowsMove(functionBlock, expression, statement, variable)) {
+    deExpressionSetLastUse(expression, true);
+  }
+  deExpression child;
+  deForeachExpressionExpression(expression, child) {
+    findExpressionLastUses(functionBlock, child, statement);
+  } deEndExpressionExpression;
+}
+
+// Mark the last uses in the block's statements.
+static void findBlockLastUses(deBlock functionBlock, deBlock block) {
+  deStatement statement;
+  deForeachBlockStatement(block, statement) {
+    deExpression expression = deStatementGetExpression(statement);
+    if (expression != deExpressionNull) {
+      findExpressionLastUses(functionBlock, expression, statement);
+    }
+    deBlock subBlock = deStatementGetSubBlock(statement);
+    if (subBlock != deBlockNull) {
+      findBlockLastUses(functionBlock, subBlock);
+    }
+  } deEndBlockStatement;
+}
+
+// Find the last uses of local arrays in instantiated functions, so they can
+// be moved rather than copied.
+void deFindLastUses(void) {
+  deSignature signature;
+  deForeachRootSignature(deTheRoot, signature) {
+    if (deSignatureInstantiated(signature)) {
+      deBlock block = deSignatureGetBlock(signature);
+      findBlockLastUses(block, block);
+    }
+  } deEndRootSignature;
+}
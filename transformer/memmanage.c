@@ -15,6 +15,22 @@
 #include "de.h"
 #include <stdarg.h>
 
+// Return the Rune expression for the field of |object|, which is an element of
+// the field's global array, or of its group's array of tuples.
+static char *fieldString(char *classPath, deVariable variable, char *object, uint32 refWidth) {
+  uint32 group = deVariableGetFieldGroup(variable);
+  if (group == 0) {
+    return utSprintf("%s_%s[!<u%u>%s]", classPath, deVariableGetName(variable), refWidth, object);
+  }
+  return utSprintf("%s_group%u[!<u%u>%s][%u]", classPath, group, refWidth, object,
+      deVariableGetTupleIndex(variable));
+}
+
+// Return the nextFree field of the class, which is its first data member.
+static deVariable findNextFreeVariable(deClass theClass) {
+  return deBlockGetFirstVariable(deClassGetSubBlock(theClass));
+}
+
 // Allocate the self object for this constructor.  Also change return statements
 // to return self.  Bind all new/modified statements.
 static void generateConstructorString(deClass theClass) {
@@ -22,29 +38,41 @@ static void generateConstructorString(deClass theClass) {
   char *theClassPath = utAllocString(deGetBlockPath(deClassGetSubBlock(theClass), true));
   char* selfType = deDatatypeGetTypeString(deClassGetDatatype(theClass));
   uint32 refWidth = deClassGetRefWidth(theClass);
+  char *nextFree = utAllocString(fieldString(theClassPath,
+      findNextFreeVariable(theClass), "object", refWidth));
   deSprintToString(
       "appendcode {\n"
       "  func %1$s_allocate() {\n"
       "    if %1$s_firstFree != 0u%3$u {\n"
       "      object = !< %2$s >%1$s_firstFree\n"
-      "      %1$s_firstFree = %1$s_nextFree[!<u%3$u>object]\n"
+      "      %1$s_firstFree = %4$s\n"
       "    } else {\n"
       "      if %1$s_used == %1$s_allocated {\n"
       "        %1$s_allocated <<= 1u%3$u\n",
-      theClassPath, selfType, refWidth);
+      theClassPath, selfType, refWidth, nextFree);
+  bool resizedGroup = false;
   deVariable variable;
   deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
-    deSprintToString(
-          "        %1$s_%2$s.resize(%1$s_allocated)\n",
-        theClassPath, deVariableGetName(variable));
+    uint32 group = deVariableGetFieldGroup(variable);
+    if (group == 0) {
+      deSprintToString(
+            "        %1$s_%2$s.resize(%1$s_allocated)\n",
+          theClassPath, deVariableGetName(variable));
+    } else if (!resizedGroup) {
+      deSprintToString(
+            "        %1$s_group%2$u.resize(%1$s_allocated)\n",
+          theClassPath, group);
+      resizedGroup = true;
+    }
   } deEndBlockVariable;
   deSprintToString(
       "      }\n"
       "      object = !<%2$s >%1$s_used\n"
       "      %1$s_used += 1u%3$u\n"
       "    }\n"
-      "    %1$s_nextFree[!<u%3$u>object] = 1u%3$u\n",
-      theClassPath, selfType, refWidth);
+      "    %4$s = 1u%3$u\n",
+      theClassPath, selfType, refWidth, nextFree);
+  utFree(nextFree);
   deSprintToString(
       "    return object\n"
       "  }\n"
@@ -65,17 +93,17 @@ static void generateDestructorString(deClass theClass) {
   deVariable variable;
   deForeachBlockVariable(deClassGetSubBlock(theClass), variable) {
     if (!firstTime) {
-      deVariable globalArrayVar = deVariableGetGlobalArrayVariable(variable);
       char* zero = deDatatypeGetDefaultValueString(deVariableGetDatatype(variable));
-      deSprintToString("    %1$s[!<u%3$u>object] = %2$s\n",
-                     deVariableGetName(globalArrayVar), zero, refWidth);
+      deSprintToString("    %1$s = %2$s\n",
+                     fieldString(theClassPath, variable, self, refWidth), zero);
     }
     firstTime = false;
   } deEndBlockVariable;
   deSprintToString(
-      "    %1$s_nextFree[!<u%3$u>%2$s] = %1$s_firstFree\n"
+      "    %4$s = %1$s_firstFree\n"
       "    %1$s_firstFree = !<u%3$u>%2$s\n",
-      theClassPath, self, refWidth);
+      theClassPath, self, refWidth,
+      fieldString(theClassPath, findNextFreeVariable(theClass), self, refWidth));
   deSprintToString(
       "  }\n"
       "}\n");
@@ -96,10 +124,29 @@ static void generateRootBlockArrays(deClass theClass) {
   deVariable variable;
   deForeachBlockVariable(block, variable) {
     utAssert(!deVariableIsType(variable));
-    char *defaultValue = deDatatypeGetDefaultValueString(deVariableGetDatatype(variable));
-    deSprintToString("  %1$s_%2$s = [%3$s]\n",
-        path, deVariableGetName(variable), defaultValue);
+    if (deVariableGetFieldGroup(variable) == 0) {
+      char *defaultValue = deDatatypeGetDefaultValueString(deVariableGetDatatype(variable));
+      deSprintToString("  %1$s_%2$s = [%3$s]\n",
+          path, deVariableGetName(variable), defaultValue);
+    }
   } deEndBlockVariable;
+  // Grouped fields share an array of tuples, initialized like the fields.
+  bool firstField = true;
+  deForeachBlockVariable(block, variable) {
+    uint32 group = deVariableGetFieldGroup(variable);
+    if (group != 0) {
+      char *defaultValue = deDatatypeGetDefaultValueString(deVariableGetDatatype(variable));
+      if (firstField) {
+        deSprintToString("  %1$s_group%2$u = [(%3$s", path, group, defaultValue);
+      } else {
+        deSprintToString(", %s", defaultValue);
+      }
+      firstField = false;
+    }
+  } deEndBlockVariable;
+  if (!firstField) {
+    deAddString(")]\n");
+  }
   deAddString("}\n");
   utFree(path);
 }
@@ -122,7 +169,10 @@ static void setGlobalArrayVariables(deClass theClass) {
   deVariable variable;
   deForeachBlockVariable(block, variable) {
     char *path = deGetBlockPath(block, true);
-    utSym name = utSymCreateFormatted("%s_%s", path, deVariableGetName(variable));
+    uint32 group = deVariableGetFieldGroup(variable);
+    utSym name = group == 0?
+        utSymCreateFormatted("%s_%s", path, deVariableGetName(variable)) :
+        utSymCreateFormatted("%s_group%u", path, group);
     deIdent ident = deBlockFindIdent(globalBlock, name);
     utAssert(ident != deIdentNull && deIdentGetType(ident) == DE_IDENT_VARIABLE);
     deVariable globalVar = deIdentGetVariable(ident);
@@ -177,25 +227,30 @@ static void freeSelfInDestructor(deClass theClass) {
 // Generate code for referencing and defreferencing the class.
 static void generateRefAndUnrefString(deClass theClass) {
   deStringPos = 0;
-  char* theClassPath = deGetBlockPath(deClassGetSubBlock(theClass), true);
+  char* theClassPath = utAllocString(deGetBlockPath(deClassGetSubBlock(theClass), true));
+  uint32 refWidth = deClassGetRefWidth(theClass);
+  char *refCount = utAllocString(fieldString(theClassPath,
+      findNextFreeVariable(theClass), "object", refWidth));
   deSprintToString(
       "appendcode {\n"
       "  func %1$s_ref(object) {\n"
-      "    if !isnull(object) && %1$s_nextFree[!<u%2$u>object] != 0u%2$u {\n"
-      "      %1$s_nextFree[!<u%2$u>object] += 1u%2$u\n"
+      "    if !isnull(object) && %3$s != 0u%2$u {\n"
+      "      %3$s += 1u%2$u\n"
       "    }\n"
       "  }\n"
       "\n"
       "  func %1$s_unref(object) {\n"
-      "    if !isnull(object) && %1$s_nextFree[!<u%2$u>object] != 0u%2$u {\n"
-      "      %1$s_nextFree[!<u%2$u>object] !-= 1u%2$u\n"
-      "      if %1$s_nextFree[!<u%2$u>object] == 0u%2$u {\n"
+      "    if !isnull(object) && %3$s != 0u%2$u {\n"
+      "      %3$s !-= 1u%2$u\n"
+      "      if %3$s == 0u%2$u {\n"
       "        object.destroy()\n"
       "      }\n"
       "    }\n"
       "  }\n"
       "}\n"
-      , theClassPath, deClassGetRefWidth(theClass));
+      , theClassPath, refWidth, refCount);
+  utFree(refCount);
+  utFree(theClassPath);
 }
 
 // Add ref() and deref() methods to the class.  Return the unref function.
@@ -206,6 +261,7 @@ static void addRefAndUnref(deClass theClass) {
   deParseString(deStringVal, rootBlock);
   deGenerating = false;
   deFunction unrefFunc = deBlockGetLastFunction(rootBlock);
+  deFunctionSetAlwaysInline(unrefFunc, deElideRefCounting);
   deDatatypeArray parameterTypes = deDatatypeArrayAlloc();
   deDatatype selfType = deClassDatatypeCreate(theClass);
   deDatatypeArrayAppendDatatype(parameterTypes, selfType);
@@ -214,6 +270,7 @@ static void addRefAndUnref(deClass theClass) {
   deSignatureSetReturnType(signature, deNoneDatatypeCreate());
   bindNewSignature(signature);
   deFunction refFunc = deFunctionGetPrevBlockFunction(unrefFunc);
+  deFunctionSetAlwaysInline(refFunc, deElideRefCounting);
   signature = deSignatureCreate(refFunc, parameterTypes, 0);
   deSignatureSetInstantiated(signature, true);
   deSignatureSetReturnType(signature, deNoneDatatypeCreate());
@@ -263,7 +320,8 @@ void deCallFinalInDestructors(void) {
 
 // Add code to constructors to allocate a new object, and add variables in the
 // root block needed to manage object memory.  We use structure-of-array memory
-// layout, so there is a global array per data member of the class.
+// layout by default, so there is a global array per data member of the class.
+// Fields grouped by deFindFieldGroups share a global array of tuples instead.
 void deAddMemoryManagement(void) {
   deClass theClass;
   deForeachRootClass(deTheRoot, theClass) {